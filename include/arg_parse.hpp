@@ -1,18 +1,23 @@
 #include <fstream>
 #include <iostream>
+#include <algorithm>
 #include <filesystem>
 #include <vector>
+#include <iterator>
+#include <utility>
+#include <memory>
 #include "kernel_sizes.hpp"
 #include "types.hpp"
 #include "host_data.hpp"
 #include "utils.hpp"
+#include "graph_pack.hpp"
 
 // read the graph from the file
 bool check_args(int &argc, char **&argv)
 {
 	if (argc < 2)
 	{
-		std::cout << "Usage: " << argv[0] << " <graph_path> [out_data]" << std::endl;
+		std::cout << "Usage: " << argv[0] << " <graph_path> [out_data] [-s=<source>] [-local=<local_size>] [-runs=<n>]" << std::endl;
 		return false;
 	}
 	return true;
@@ -26,11 +31,56 @@ std::vector<std::string> get_files_in_directory(const std::string dname) {
 	return fnames;
 }
 
+/**
+ * Reports a malformed argument and exits, as -h does after the usage.
+ */
+[[noreturn]] void arg_error(const char *program, const std::string &message) {
+	std::cout << "[!] " << message << std::endl;
+	std::cout << "Run " << program << " -h for the usage" << std::endl;
+	exit(1);
+}
+
+/**
+ * Parses value as a whole decimal integer, false if it is empty, has trailing characters or overflows.
+ */
+bool parse_integer(const std::string &value, long long &out) {
+	size_t end = 0;
+	try {
+		out = std::stoll(value, &end);
+	} catch (std::exception &e) {
+		return false;
+	}
+	return end > 0 && end == value.size();
+}
+
 typedef struct {
 	bool print_result = false;
+	bool use_cpu = false;
+	bool forest = false;
+	bool plan = false;            // split the batch in buckets with their own operator
+	bool summary = false;         // reached count, max depth and level histogram computed on the device
+	bool labels = false;          // the graph files carry node labels
+	label_mask_t label_mask = ALL_LABELS; // the labels the traversals may go through
+	std::string out_file;         // binary dump of the parents
+	std::vector<std::pair<size_t, nodeid_t>> targets; // paths extracted on the device
 	size_t local_size;
+	std::string op;               // operator registry variant, empty for the default of the representation
+	std::vector<size_t> sg_sizes; // sub-group sizes to run, empty for every one the device supports
+	std::string repr;             // "compressed" or "vectorized", empty for the build default
+	size_t heavy_degree = 0;      // degree from which bottom-up scans a vertex with its whole sub-group, 0 disables it
+	std::string tune_cache;
+	std::string socket_path;
+	size_t deadline_us = 1000;
+	size_t max_batch = 64;
+	size_t sources_per_launch = 32; // BFS sources of each graph per centrality launch
+	size_t cache_mb = 0;          // result cache budget of the server, 0 disables it
+	size_t device_budget_mb = 0;  // device memory a batch may take, larger batches are split; 0 for the whole device
+	bool compress_cache = false;
+	std::vector<std::string> queries;
+	bool map_packs = false;       // set before parsing: a batch made only of dataset packs is loaded into arena, not graphs
 	std::vector<std::string> fnames;
 	std::vector<CSRHostData> graphs;
+	std::unique_ptr<CompressedHostData> arena; // the packed batch with map_packs, see unpack_arena()
 } args_t;
 
 void get_mul_graph_args(int argc, char** argv, args_t &args, bool undirected = false) {
@@ -51,31 +101,188 @@ void get_mul_graph_args(int argc, char** argv, args_t &args, bool undirected = f
 			{
 				args.local_size = std::stoi(std::string(argv[i]).substr(7));
 				continue;
+			} else if (std::string(argv[i]).find("-op=") == 0) {
+				args.op = std::string(argv[i]).substr(4);
+				continue;
+			} else if (std::string(argv[i]).find("-sg=") == 0) {
+				// <size>[,<size>...]
+				std::string list = std::string(argv[i]).substr(4);
+				for (size_t start = 0; start <= list.size();) {
+					size_t comma = std::min(list.find(',', start), list.size());
+					args.sg_sizes.push_back(std::stoul(list.substr(start, comma - start)));
+					start = comma + 1;
+				}
+				continue;
+			} else if (std::string(argv[i]).find("-repr=") == 0) {
+				args.repr = std::string(argv[i]).substr(6);
+				continue;
+			} else if (std::string(argv[i]).find("-heavy=") == 0) {
+				args.heavy_degree = std::stoul(std::string(argv[i]).substr(7));
+				continue;
+			} else if (std::string(argv[i]).find("-tune=") == 0) {
+				args.tune_cache = std::string(argv[i]).substr(6);
+				continue;
+			} else if (std::string(argv[i]).find("-socket=") == 0) {
+				args.socket_path = std::string(argv[i]).substr(8);
+				continue;
+			} else if (std::string(argv[i]).find("-deadline=") == 0) {
+				args.deadline_us = std::stoul(std::string(argv[i]).substr(10));
+				continue;
+			} else if (std::string(argv[i]).find("-batch=") == 0) {
+				args.max_batch = std::stoul(std::string(argv[i]).substr(7));
+				continue;
+			} else if (std::string(argv[i]).find("-sources=") == 0) {
+				args.sources_per_launch = std::stoul(std::string(argv[i]).substr(9));
+				continue;
+			} else if (std::string(argv[i]).find("-cache=") == 0) {
+				args.cache_mb = std::stoul(std::string(argv[i]).substr(7));
+				continue;
+			} else if (std::string(argv[i]).find("-budget=") == 0) {
+				args.device_budget_mb = std::stoul(std::string(argv[i]).substr(8));
+				continue;
+			} else if (std::string(argv[i]) == "-cache_compress") {
+				args.compress_cache = true;
+				continue;
+			} else if (std::string(argv[i]).find("-q=") == 0) {
+				args.queries.push_back(std::string(argv[i]).substr(3));
+				continue;
+			} else if (std::string(argv[i]) == "-plan") {
+				args.plan = true;
+				continue;
+			} else if (std::string(argv[i]).find("-match=") == 0) {
+				// <label>[,<label>...], the graph files are read with their labels
+				std::string list = std::string(argv[i]).substr(7);
+				args.labels = true;
+				args.label_mask = 0;
+				const int max_label = sizeof(label_mask_t) * 8 - 1;
+				for (size_t start = 0; start <= list.size();) {
+					size_t comma = std::min(list.find(',', start), list.size());
+					std::string item = list.substr(start, comma - start);
+					size_t end = 0;
+					int label = -1;
+					try {
+						label = std::stoi(item, &end);
+					} catch (std::exception &e) {
+						end = 0;
+					}
+					if (end == 0 || end != item.size() || label < 0 || label > max_label) {
+						arg_error(argv[0], "-match= takes labels from 0 to " + std::to_string(max_label) + ", got \"" + item + "\"");
+					}
+					args.label_mask |= label_mask_t(1) << label;
+					start = comma + 1;
+				}
+				continue;
+			} else if (std::string(argv[i]) == "-summary") {
+				args.summary = true;
+				continue;
+			} else if (std::string(argv[i]).find("-o=") == 0) {
+				args.out_file = std::string(argv[i]).substr(3);
+				continue;
+			} else if (std::string(argv[i]).find("-t=") == 0) {
+				// <graph>:<target>
+				std::string t = std::string(argv[i]).substr(3);
+				size_t colon = t.find(':');
+				args.targets.push_back({std::stoul(t.substr(0, colon)), std::stoi(t.substr(colon + 1))});
+				continue;
+			} else if (std::string(argv[i]) == "-forest") {
+				args.forest = true;
+				continue;
+			} else if (std::string(argv[i]) == "-cpu") {
+				args.use_cpu = true;
+				continue;
 			} else if (std::string(argv[i]).find("-d=") == 0) {
 				directory = std::string(argv[i]).substr(3);
 				continue;
 			} else if (std::string(argv[i]).find("-h") != std::string::npos || std::string(argv[i]).find("--help") != std::string::npos) {
-				std::cout << "Usage: " << argv[0] << " [-p] [-local=<local_size>] <graph files or directories...>" << std::endl;
+				std::cout << "Usage: " << argv[0] << " [-p] [-o=<binary_out>] [-plan] [-summary] [-t=<graph>:<target>] [-match=<label>,...] [-cpu] [-forest] [-tune=<cache_file>] [-socket=<path>] [-deadline=<us>] [-batch=<max_queries>] [-sources=<per_launch>] [-cache=<MB>] [-cache_compress] [-budget=<MB>] [-q=<graph>:<source>:<target>] [-local=<local_size>] [-op=<operator>] [-sg=<size>,...] [-repr=compressed|vectorized] [-heavy=<degree>] <graph files, directories or dataset packs...>" << std::endl;
 				exit(0);
 			}
 			tmp_fnames.push_back(argv[i]);
 		}
 	}
 
+	// a batch of packs only is copied from the mappings into one arena, without building the per-graph CSRs
+	bool packs_only = !tmp_fnames.empty() && std::all_of(tmp_fnames.begin(), tmp_fnames.end(), [](const std::string &s) {
+		return !std::filesystem::is_directory(s) && isGraphPack(s);
+	});
+	if (args.map_packs && packs_only)
+	{
+		std::vector<std::unique_ptr<MappedGraphPack>> packs;
+		std::vector<size_t> node_counts, edge_counts;
+		for (auto &s : tmp_fnames)
+		{
+			packs.push_back(std::make_unique<MappedGraphPack>(s));
+			for (size_t i = 0; i < packs.back()->num_graphs(); i++) {
+				args.fnames.push_back(s + "[" + std::to_string(i) + "]");
+			}
+			packs.back()->append_counts(node_counts, edge_counts);
+		}
+		args.arena = std::make_unique<CompressedHostData>(node_counts, edge_counts);
+		size_t first = 0;
+		for (auto &pack : packs)
+		{
+			pack->copy_into(*args.arena, first);
+			first += pack->num_graphs();
+		}
+		return;
+	}
+
+	// the text files are parsed in parallel, the packs are mapped in place of them
+	std::vector<std::string> text_fnames;
+	auto flush_text = [&]() {
+		std::vector<CSRHostData> graphs;
+		try {
+			graphs = readGraphsFromFiles(text_fnames, args.labels);
+		} catch (std::runtime_error &e) {
+			// a malformed graph file ends the run, as a malformed argument does
+			std::cout << "[!] " << e.what() << std::endl;
+			exit(1);
+		}
+		std::move(graphs.begin(), graphs.end(), std::back_inserter(args.graphs));
+		text_fnames.clear();
+	};
 	for (auto &s : tmp_fnames)
 	{
 		if (std::filesystem::is_directory(s)) {
 			auto files = get_files_in_directory(s);
 			for (auto &f : files) {
 				args.fnames.push_back(f);
+				text_fnames.push_back(f);
+			}
+		} else if (isGraphPack(s)) {
+			flush_text();
+			MappedGraphPack pack(s);
+			auto graphs = pack.graphs();
+			for (size_t i = 0; i < graphs.size(); i++) {
+				args.fnames.push_back(s + "[" + std::to_string(i) + "]");
 			}
+			std::move(graphs.begin(), graphs.end(), std::back_inserter(args.graphs));
 		} else {
 			args.fnames.push_back(s);
+			text_fnames.push_back(s);
 		}
 	}
+	flush_text();
+}
 
-	for (auto &s : args.fnames)
-	{
-		args.graphs.push_back(readGraphFromFile(s, false));
-	}
-}
\ No newline at end of file
+/**
+ * Unpacks args.arena into args.graphs, for the runs that need the CSR of each graph.
+ */
+void unpack_arena(args_t &args) {
+	if (!args.arena) return;
+	CompressedHostData &arena = *args.arena;
+	args.graphs.resize(arena.num_graphs);
+	host_parallel_for(arena.num_graphs, [&](size_t i) {
+		CSRHostData &g = args.graphs[i];
+		g.num_nodes = arena.nodes_count[i];
+		auto offsets = arena.offsets_slice(i);
+		g.csr.offsets.resize(offsets.size());
+		for (size_t j = 0; j < offsets.size(); j++) {
+			g.csr.offsets[j] = offsets[j] - arena.graphs_offsets[i];
+		}
+		auto edges = arena.edges_slice(i);
+		g.csr.edges.assign(edges.begin(), edges.end());
+		g.parents = std::vector<nodeid_t>(g.num_nodes, 0);
+	});
+	args.arena.reset();
+}
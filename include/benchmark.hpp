@@ -1,10 +1,37 @@
+#include <cstddef>
+
 #ifndef __BENCMARK_HPP__
 #define __BENCMARK_HPP__
 
+typedef struct {
+  size_t bytes = 0;
+  size_t copies = 0;
+  float time = 0;   // us, summed over the profiled copies
+} transfer_stats_t;
+
 typedef struct {
   float kernel_time;
   float total_time;
   float to_microsec;
+  transfer_stats_t upload;   // host to device copies of the batch
+  transfer_stats_t download; // device to host copies of the results
+  size_t device_bytes = 0;   // peak device memory of the batch: its buffers and the scratch memory of its run
 } bench_time_t;
 
-#endif 
\ No newline at end of file
+/**
+ * Adds the transfers and device memory of a sub-batch to the times of a batch.
+ */
+inline void accumulate(bench_time_t &total, const bench_time_t &part) {
+  total.kernel_time += part.kernel_time;
+  total.total_time += part.total_time;
+  total.upload.bytes += part.upload.bytes;
+  total.upload.copies += part.upload.copies;
+  total.upload.time += part.upload.time;
+  total.download.bytes += part.download.bytes;
+  total.download.copies += part.download.copies;
+  total.download.time += part.download.time;
+  // the sub-batches run one after the other, so the peak is the one of the largest
+  if (part.device_bytes > total.device_bytes) total.device_bytes = part.device_bytes;
+}
+
+#endif
@@ -1,6 +1,17 @@
 #include "impl/mul_bfs.hpp"
 #include "impl/simpl_bfs.hpp"
+#include "impl/multi_device_bfs.hpp"
+#include "impl/dynamic_bfs.hpp"
+#include "impl/path_query.hpp"
+#include "impl/centrality.hpp"
 
 #include "impl/bfs_operators/frontier_op.hpp"
 #include "impl/bfs_operators/naive.hpp"
 #include "impl/bfs_operators/bottomup_op.hpp"
+#include "impl/bfs_operators/matrix_op.hpp"
+#include "impl/bfs_operators/spmv_op.hpp"
+#include "impl/operator_registry.hpp"
+#include "impl/autotuner.hpp"
+#include "impl/batch_planner.hpp"
+#include "impl/result_cache.hpp"
+#include "impl/query_server.hpp"
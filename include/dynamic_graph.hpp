@@ -0,0 +1,161 @@
+#ifndef __DYNAMIC_GRAPH_HPP__
+#define __DYNAMIC_GRAPH_HPP__
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "types.hpp"
+#include "host_data.hpp"
+
+typedef std::pair<nodeid_t, nodeid_t> edge_t;
+
+/**
+ * Builds the transpose (in-edges) of a CSR.
+ */
+CSR transposeCSR(const CSR &csr, size_t num_nodes)
+{
+	CSR ret;
+	ret.offsets = std::vector<size_t>(num_nodes + 1, 0);
+	ret.edges = std::vector<nodeid_t>(csr.edges.size());
+	for (nodeid_t dst : csr.edges)
+	{
+		ret.offsets[dst + 1]++;
+	}
+	for (size_t i = 1; i < ret.offsets.size(); i++)
+	{
+		ret.offsets[i] += ret.offsets[i - 1];
+	}
+	std::vector<size_t> fill(ret.offsets.begin(), ret.offsets.end() - 1);
+	for (size_t u = 0; u < num_nodes; u++)
+	{
+		for (size_t i = csr.offsets[u]; i < csr.offsets[u + 1]; i++)
+		{
+			ret.edges[fill[csr.edges[i]]++] = u;
+		}
+	}
+	return ret;
+}
+
+/**
+ * CSR that can be updated in place.
+ *
+ * Every row keeps some slack after its neighbors, so an insertion is an append in the row. A row
+ * that runs out of slack is moved to the end of the edge array with twice its capacity, and the
+ * whole array is repacked once the holes left behind exceed half of it. Deletions swap the removed
+ * neighbor with the last one of the row.
+ */
+class DynamicCSR
+{
+public:
+	DynamicCSR(const CSR &csr, size_t num_nodes, float slack = 0.25f) : num_nodes(num_nodes), slack(slack)
+	{
+		begin.resize(num_nodes);
+		degree.resize(num_nodes);
+		capacity.resize(num_nodes);
+		for (size_t u = 0; u < num_nodes; u++)
+		{
+			degree[u] = csr.offsets[u + 1] - csr.offsets[u];
+		}
+		repack([&](size_t u, nodeid_t *dst) {
+			std::copy(csr.edges.begin() + csr.offsets[u], csr.edges.begin() + csr.offsets[u + 1], dst);
+		});
+	}
+
+	span_t<nodeid_t> neighbors(nodeid_t u) { return {edges.data() + begin[u], degree[u]}; }
+
+	/**
+	 * Adds the edge u -> v. Returns false if it was already there.
+	 */
+	bool insert(nodeid_t u, nodeid_t v)
+	{
+		auto row = neighbors(u);
+		if (std::find(row.begin(), row.end(), v) != row.end()) return false;
+
+		if (degree[u] == capacity[u])
+		{
+			size_t new_capacity = std::max<size_t>(4, 2 * capacity[u]);
+			size_t new_begin = edges.size();
+			edges.resize(new_begin + new_capacity);
+			std::copy(edges.begin() + begin[u], edges.begin() + begin[u] + degree[u], edges.begin() + new_begin);
+			wasted += capacity[u];
+			begin[u] = new_begin;
+			capacity[u] = new_capacity;
+		}
+		edges[begin[u] + degree[u]++] = v;
+		num_edges++;
+
+		if (wasted > edges.size() / 2)
+		{
+			std::vector<nodeid_t> old_edges;
+			old_edges.swap(edges);
+			std::vector<size_t> old_begin = begin;
+			repack([&](size_t w, nodeid_t *dst) {
+				std::copy(old_edges.begin() + old_begin[w], old_edges.begin() + old_begin[w] + degree[w], dst);
+			});
+		}
+		return true;
+	}
+
+	/**
+	 * Removes the edge u -> v. Returns false if it was not there.
+	 */
+	bool remove(nodeid_t u, nodeid_t v)
+	{
+		auto row = neighbors(u);
+		auto it = std::find(row.begin(), row.end(), v);
+		if (it == row.end()) return false;
+		*it = row[row.size() - 1];
+		degree[u]--;
+		num_edges--;
+		return true;
+	}
+
+	/**
+	 * Returns the graph as a plain CSR, without the slack.
+	 */
+	CSR compact() const
+	{
+		CSR ret;
+		ret.offsets = std::vector<size_t>(num_nodes + 1, 0);
+		ret.edges.reserve(num_edges);
+		for (size_t u = 0; u < num_nodes; u++)
+		{
+			ret.edges.insert(ret.edges.end(), edges.begin() + begin[u], edges.begin() + begin[u] + degree[u]);
+			ret.offsets[u + 1] = ret.edges.size();
+		}
+		return ret;
+	}
+
+	size_t num_nodes;
+	size_t num_edges = 0;
+	size_t wasted = 0;
+	float slack;
+	std::vector<size_t> begin, degree, capacity;
+	std::vector<nodeid_t> edges;
+
+private:
+	template <typename F>
+	void repack(F copy_row)
+	{
+		size_t total = 0;
+		for (size_t u = 0; u < num_nodes; u++)
+		{
+			capacity[u] = degree[u] + std::max<size_t>(1, degree[u] * slack);
+			total += capacity[u];
+		}
+		edges.assign(total, 0);
+		num_edges = 0;
+		total = 0;
+		for (size_t u = 0; u < num_nodes; u++)
+		{
+			begin[u] = total;
+			copy_row(u, edges.data() + total);
+			total += capacity[u];
+			num_edges += degree[u];
+		}
+		wasted = 0;
+	}
+};
+
+#endif
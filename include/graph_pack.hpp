@@ -0,0 +1,206 @@
+#ifndef __GRAPH_PACK_HPP__
+#define __GRAPH_PACK_HPP__
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "types.hpp"
+#include "host_data.hpp"
+#include "host_parallel.hpp"
+
+/**
+ * Dataset pack: many graphs in one file, laid out exactly as the CompressedHostData arena.
+ *
+ *   graph_pack_header_t
+ *   nodes_offsets[num_graphs + 1]    (uint64, index: first node of each graph)
+ *   graphs_offsets[num_graphs + 1]   (uint64, index: first edge of each graph)
+ *   compressed_offsets[total_nodes + 1] (uint64, already shifted by the graph edge offset)
+ *   compressed_edges[total_edges]    (nodeid_t, local node ids)
+ *
+ * Every section starts 8-byte aligned, so the file can be mapped and read in place.
+ */
+constexpr char GRAPH_PACK_MAGIC[8] = {'S', 'B', 'F', 'S', 'P', 'A', 'C', 'K'};
+constexpr uint32_t GRAPH_PACK_VERSION = 1;
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t nodeid_size; // sizeof(nodeid_t) of the writer
+	uint64_t num_graphs;
+	uint64_t total_nodes;
+	uint64_t total_edges;
+} graph_pack_header_t;
+
+// write the arena of a batch as a dataset pack
+void writeGraphPack(const std::string &filename, const CompressedHostData &arena) {
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		throw std::runtime_error("writeGraphPack: cannot open " + filename);
+	}
+
+	graph_pack_header_t header;
+	std::memcpy(header.magic, GRAPH_PACK_MAGIC, sizeof(header.magic));
+	header.version = GRAPH_PACK_VERSION;
+	header.nodeid_size = sizeof(nodeid_t);
+	header.num_graphs = arena.num_graphs;
+	header.total_nodes = arena.nodes_offsets[arena.num_graphs];
+	header.total_edges = arena.graphs_offsets[arena.num_graphs];
+
+	auto write_u64 = [&](const std::vector<size_t> &v) {
+		std::vector<uint64_t> tmp(v.begin(), v.end());
+		file.write(reinterpret_cast<const char *>(tmp.data()), tmp.size() * sizeof(uint64_t));
+	};
+	file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	write_u64(arena.nodes_offsets);
+	write_u64(arena.graphs_offsets);
+	write_u64(arena.compressed_offsets);
+	file.write(reinterpret_cast<const char *>(arena.compressed_edges.data()), arena.compressed_edges.size() * sizeof(nodeid_t));
+	if (!file) {
+		throw std::runtime_error("writeGraphPack: write failed on " + filename);
+	}
+}
+
+/**
+ * Read-only mapping of a dataset pack. The sections point straight into the mapped file, so single
+ * graphs can be read without loading the rest, and a whole arena is filled with a few bulk copies.
+ */
+class MappedGraphPack
+{
+public:
+	MappedGraphPack(const std::string &filename) : filename(filename)
+	{
+		int fd = open(filename.c_str(), O_RDONLY);
+		struct stat st;
+		if (fd < 0 || fstat(fd, &st) < 0) {
+			if (fd >= 0) close(fd);
+			throw std::runtime_error("MappedGraphPack: cannot open " + filename);
+		}
+		size = st.st_size;
+		base = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+		close(fd);
+		if (base == MAP_FAILED) {
+			throw std::runtime_error("MappedGraphPack: cannot map " + filename);
+		}
+
+		const char *ptr = static_cast<const char *>(base);
+		header = reinterpret_cast<const graph_pack_header_t *>(ptr);
+		if (size < sizeof(graph_pack_header_t) || std::memcmp(header->magic, GRAPH_PACK_MAGIC, sizeof(header->magic)) != 0 ||
+		    header->version != GRAPH_PACK_VERSION || header->nodeid_size != sizeof(nodeid_t)) {
+			munmap(base, size);
+			throw std::runtime_error("MappedGraphPack: " + filename + " is not a dataset pack of this version");
+		}
+		size_t expected = sizeof(graph_pack_header_t) + sizeof(uint64_t) * (2 * (header->num_graphs + 1) + header->total_nodes + 1) + sizeof(nodeid_t) * header->total_edges;
+		if (size < expected) {
+			munmap(base, size);
+			throw std::runtime_error("MappedGraphPack: " + filename + " is truncated");
+		}
+		nodes_offsets = reinterpret_cast<const uint64_t *>(ptr + sizeof(graph_pack_header_t));
+		graphs_offsets = nodes_offsets + header->num_graphs + 1;
+		offsets = graphs_offsets + header->num_graphs + 1;
+		edges = reinterpret_cast<const nodeid_t *>(offsets + header->total_nodes + 1);
+	}
+
+	MappedGraphPack(const MappedGraphPack &) = delete;
+	MappedGraphPack &operator=(const MappedGraphPack &) = delete;
+
+	~MappedGraphPack() { munmap(base, size); }
+
+	size_t num_graphs() const { return header->num_graphs; }
+	size_t num_nodes(size_t i) const { return nodes_offsets[i + 1] - nodes_offsets[i]; }
+	size_t num_edges(size_t i) const { return graphs_offsets[i + 1] - graphs_offsets[i]; }
+
+	// the mapped offsets of the nodes of graph i (num_nodes(i) + 1 of them), they index edges()
+	const uint64_t *node_offsets(size_t i) const { return offsets + nodes_offsets[i]; }
+	// the mapped edges of every graph, with local node ids
+	const nodeid_t *edges_data() const { return edges; }
+
+	/**
+	 * Copies the mapped sections into a new arena, the index is rebuilt from the counts.
+	 */
+	CompressedHostData to_arena() const
+	{
+		std::vector<size_t> node_counts, edge_counts;
+		append_counts(node_counts, edge_counts);
+		CompressedHostData arena(node_counts, edge_counts);
+		copy_into(arena, 0);
+		return arena;
+	}
+
+	/**
+	 * Appends the node and edge counts of the graphs, to size an arena holding several packs.
+	 */
+	void append_counts(std::vector<size_t> &node_counts, std::vector<size_t> &edge_counts) const
+	{
+		for (size_t i = 0; i < num_graphs(); i++) {
+			node_counts.push_back(num_nodes(i));
+			edge_counts.push_back(num_edges(i));
+		}
+	}
+
+	/**
+	 * Copies the mapped sections into the slices of the arena starting at graph first, the offsets
+	 * are shifted to the edge offset of that graph.
+	 */
+	void copy_into(CompressedHostData &arena, size_t first) const
+	{
+		const size_t shift = arena.graphs_offsets[first];
+		size_t *dst = arena.compressed_offsets.data() + arena.nodes_offsets[first];
+		for (size_t j = 0; j <= header->total_nodes; j++) {
+			dst[j] = shift + offsets[j];
+		}
+		std::memcpy(arena.compressed_edges.data() + shift, edges, header->total_edges * sizeof(nodeid_t));
+	}
+
+	/**
+	 * Unpacks graph i into its own CSR, with local offsets.
+	 */
+	CSRHostData graph(size_t i) const
+	{
+		CSRHostData ret;
+		ret.num_nodes = num_nodes(i);
+		const uint64_t *src = offsets + nodes_offsets[i];
+		ret.csr.offsets.resize(ret.num_nodes + 1);
+		for (size_t j = 0; j <= ret.num_nodes; j++) {
+			ret.csr.offsets[j] = src[j] - graphs_offsets[i];
+		}
+		ret.csr.edges.assign(edges + graphs_offsets[i], edges + graphs_offsets[i + 1]);
+		ret.parents = std::vector<nodeid_t>(ret.num_nodes, 0);
+		return ret;
+	}
+
+	/**
+	 * Unpacks every graph into its own CSR, in parallel.
+	 */
+	std::vector<CSRHostData> graphs() const
+	{
+		std::vector<CSRHostData> ret(num_graphs());
+		host_parallel_for(num_graphs(), [&](size_t i) {
+			ret[i] = graph(i);
+		});
+		return ret;
+	}
+
+private:
+	std::string filename;
+	void *base;
+	size_t size;
+	const graph_pack_header_t *header;
+	const uint64_t *nodes_offsets, *graphs_offsets, *offsets;
+	const nodeid_t *edges;
+};
+
+// whether the file starts with the dataset pack magic
+bool isGraphPack(const std::string &filename) {
+	char magic[sizeof(GRAPH_PACK_MAGIC)];
+	std::ifstream file(filename, std::ios::binary);
+	return file.read(magic, sizeof(magic)) && std::memcmp(magic, GRAPH_PACK_MAGIC, sizeof(magic)) == 0;
+}
+
+#endif
@@ -1,5 +1,7 @@
 #include <vector>
+#include <algorithm>
 #include "types.hpp"
+#include "host_parallel.hpp"
 
 #ifndef __CSR_GRAPH_HPP__
 #define __CSR_GRAPH_HPP__
@@ -15,66 +17,251 @@ typedef struct
 	size_t num_nodes;
 	CSR csr;
 	std::vector<nodeid_t> parents;
+	std::vector<nodeid_t> components; // root of the BFS tree of each node, filled in forest mode only
+	std::vector<label_t> labels;      // label of each node, empty if the graph file carries none
 } CSRHostData;
 
+/**
+ * Bit-packed adjacency matrix. Row v has one bit per node u, set if the edge u -> v exists, so a
+ * bottom-up step finds the parents of v in the frontier with word-wide ANDs over the row.
+ */
 typedef struct
 {
 	size_t num_nodes;
-	std::vector<std::vector<adjidx_t>> adj_matrix;
+	size_t row_tiles; // tiles per row, ceil(num_nodes / TILE_SIZE)
+	std::vector<tile_t> adj_matrix;
 } MatrixHostData;
 
+/**
+ * Fills the bit matrix of a graph into dst, which must hold num_nodes * row_tiles zeroed tiles.
+ * @param offsets The num_nodes + 1 offsets of the graph, indexing edges.
+ */
+void fill_bit_matrix(size_t num_nodes, size_t row_tiles, const size_t *offsets, const nodeid_t *edges, tile_t *dst)
+{
+	for (size_t u = 0; u < num_nodes; u++)
+	{
+		for (size_t i = offsets[u]; i < offsets[u + 1]; i++)
+		{
+			nodeid_t v = edges[i];
+			dst[v * row_tiles + u / TILE_SIZE] |= tile_t(1) << (u % TILE_SIZE);
+		}
+	}
+}
+
+MatrixHostData CSRToBitMatrix(const CSRHostData &graph)
+{
+	MatrixHostData ret;
+	ret.num_nodes = graph.num_nodes;
+	ret.row_tiles = (graph.num_nodes + TILE_SIZE - 1) / TILE_SIZE;
+	ret.adj_matrix.assign(ret.num_nodes * ret.row_tiles, 0);
+	fill_bit_matrix(ret.num_nodes, ret.row_tiles, graph.csr.offsets.data(), graph.csr.edges.data(), ret.adj_matrix.data());
+	return ret;
+}
+
+/**
+ * Non-owning view over a contiguous slice of a packed array.
+ */
+template <typename T>
+struct span_t
+{
+	T *ptr;
+	size_t count;
+
+	T *begin() const { return ptr; }
+	T *end() const { return ptr + count; }
+	size_t size() const { return count; }
+	T &operator[](size_t i) const { return ptr[i]; }
+};
+
+/**
+ * Packed arena holding a batch of graphs in a single set of vectors.
+ *
+ * The offsets of graph i live at compressed_offsets[nodes_offsets[i] ... nodes_offsets[i + 1]]
+ * and already include the edge offset of the graph, so consecutive graphs share their boundary entry.
+ * All the arrays are sized exactly once from the per-graph node and edge counts, then every graph
+ * is filled independently (and in parallel) into its own slice.
+ */
 class CompressedHostData
 {
 public:
-	CompressedHostData(std::vector<CSRHostData> &data) : data(data)
+	CompressedHostData(std::vector<CSRHostData> &data) : data(&data)
 	{
-		num_graphs = data.size();
-		int total_nodes = 0;
-		for (int i = 0; i < data.size(); i++)
+		std::vector<size_t> node_counts(data.size()), edge_counts(data.size());
+		for (size_t i = 0; i < data.size(); i++)
 		{
-			std::vector<size_t> new_offsets { data[i].csr.offsets };
-			if (i != 0)
-			{
-				new_offsets.erase(new_offsets.begin());
-			}
+			node_counts[i] = data[i].num_nodes;
+			edge_counts[i] = data[i].csr.edges.size();
+		}
+		allocate(node_counts, edge_counts);
 
-			for (int j = 0; j < new_offsets.size(); j++)
+		// the labels are packed only when every graph has them
+		bool labeled = std::all_of(data.begin(), data.end(), [](const CSRHostData &g) { return g.labels.size() == g.num_nodes; });
+		if (labeled && num_graphs > 0)
+		{
+			compressed_labels.resize(compressed_parents.size());
+		}
+
+		host_parallel_for(num_graphs, [&](size_t i) {
+			fill_graph(i, data[i].csr.offsets.data(), data[i].csr.edges.data());
+			if (!compressed_labels.empty())
 			{
-				compressed_offsets.push_back(total_offset_size + new_offsets[j]);
+				std::copy(data[i].labels.begin(), data[i].labels.end(), labels_slice(i).begin());
 			}
-			compressed_edges.insert(compressed_edges.end(), data[i].csr.edges.begin(), data[i].csr.edges.end());
+		});
+	}
 
-			nodes_count.push_back(data[i].num_nodes);
-			nodes_offsets.push_back(total_nodes);
-			graphs_offsets.push_back(total_offset_size);
+	/**
+	 * Builds an empty arena sized for the given graphs, to be filled through the slice accessors
+	 * (e.g. by loading the graph files directly into it).
+	 */
+	CompressedHostData(const std::vector<size_t> &node_counts, const std::vector<size_t> &edge_counts) : data(nullptr)
+	{
+		allocate(node_counts, edge_counts);
+	}
 
-			total_offset_size += data[i].csr.offsets.back();
-			total_nodes += data[i].num_nodes;
+	/**
+	 * Describes some graphs of an arena without copying them: graph i keeps the node and edge offsets
+	 * of graphs[i] in the arena, so a device batch built on it reads the buffers of the arena. Only
+	 * the metadata is filled, the graphs must be distinct since they share their parents slices.
+	 */
+	CompressedHostData(const CompressedHostData &arena, const std::vector<size_t> &graphs) : num_graphs(graphs.size()), data(nullptr), total_offset_size(arena.total_offset_size)
+	{
+		for (size_t g : graphs)
+		{
+			nodes_count.push_back(arena.nodes_count[g]);
+			nodes_offsets.push_back(arena.nodes_offsets[g]);
+			graphs_offsets.push_back(arena.graphs_offsets[g]);
 		}
-		graphs_offsets.push_back(total_offset_size);
-		nodes_offsets.push_back(total_nodes);
+		nodes_offsets.push_back(arena.nodes_offsets[arena.num_graphs]);
+		graphs_offsets.push_back(arena.graphs_offsets[arena.num_graphs]);
+	}
 
-		compressed_parents = std::vector<nodeid_t>(total_nodes, -1);
+	/**
+	 * Copies the local CSR of graph i into its slice of the arena, shifting the offsets by the graph edge offset.
+	 */
+	void fill_graph(size_t i, const size_t *offsets, const nodeid_t *edges)
+	{
+		size_t *dst = compressed_offsets.data() + nodes_offsets[i];
+		// entry 0 is shared with the previous graph, so only the first graph writes it
+		for (size_t j = (i == 0) ? 0 : 1; j <= nodes_count[i]; j++)
+		{
+			dst[j] = graphs_offsets[i] + offsets[j];
+		}
+		std::copy(edges, edges + num_edges(i), compressed_edges.data() + graphs_offsets[i]);
 	}
 
-	void write_back()
+	size_t num_edges(size_t i) const { return graphs_offsets[i + 1] - graphs_offsets[i]; }
+
+	span_t<size_t> offsets_slice(size_t i) { return {compressed_offsets.data() + nodes_offsets[i], nodes_count[i] + 1}; }
+	span_t<nodeid_t> edges_slice(size_t i) { return {compressed_edges.data() + graphs_offsets[i], num_edges(i)}; }
+	span_t<nodeid_t> parents_slice(size_t i) { return {compressed_parents.data() + nodes_offsets[i], nodes_count[i]}; }
+	span_t<label_t> labels_slice(size_t i) { return {compressed_labels.data() + nodes_offsets[i], nodes_count[i]}; }
+
+	/**
+	 * Builds the transposed graphs (CSC) in an arena of the same layout: the in-neighbors of node v of
+	 * graph i are the edges of v in the slice of graph i.
+	 */
+	CompressedHostData transposed() const
 	{
-		size_t k = 0;
-		for (auto &d : data)
+		std::vector<size_t> edge_counts(num_graphs);
+		for (size_t i = 0; i < num_graphs; i++) edge_counts[i] = num_edges(i);
+		CompressedHostData csc(nodes_count, edge_counts);
+		host_parallel_for(num_graphs, [&](size_t i) {
+			const size_t *offsets = compressed_offsets.data() + nodes_offsets[i];
+			size_t n = nodes_count[i];
+			std::vector<size_t> t_offsets(n + 1, 0);
+			std::vector<nodeid_t> t_edges(num_edges(i));
+			for (size_t k = offsets[0]; k < offsets[n]; k++) t_offsets[compressed_edges[k] + 1]++;
+			for (size_t v = 0; v < n; v++) t_offsets[v + 1] += t_offsets[v];
+			std::vector<size_t> fill(t_offsets.begin(), t_offsets.end() - 1);
+			for (size_t u = 0; u < n; u++)
+			{
+				for (size_t k = offsets[u]; k < offsets[u + 1]; k++)
+				{
+					t_edges[fill[compressed_edges[k]]++] = u;
+				}
+			}
+			csc.fill_graph(i, t_offsets.data(), t_edges.data());
+		});
+		return csc;
+	}
+
+	/**
+	 * Scatters the packed parents back to the per-graph vectors.
+	 * @param src The packed parents to scatter, defaults to compressed_parents.
+	 */
+	void write_back(const nodeid_t *src = nullptr)
+	{
+		if (src == nullptr)
+		{
+			src = compressed_parents.data();
+		}
+
+		if (data == nullptr)
 		{
-			for (size_t i = 0; i < d.num_nodes; i++)
+			if (src != compressed_parents.data())
 			{
-				d.parents[i] = compressed_parents[k];
-				k++;
+				std::copy(src, src + compressed_parents.size(), compressed_parents.data());
 			}
+			return;
 		}
+
+		host_parallel_for(num_graphs, [&](size_t i) {
+			auto &parents = (*data)[i].parents;
+			parents.resize(nodes_count[i]);
+			std::copy(src + nodes_offsets[i], src + nodes_offsets[i + 1], parents.data());
+		});
+	}
+
+	/**
+	 * Scatters the packed component ids back to the per-graph vectors.
+	 */
+	void write_back_components(const nodeid_t *src)
+	{
+		if (data == nullptr)
+		{
+			compressed_components.assign(src, src + compressed_parents.size());
+			return;
+		}
+
+		host_parallel_for(num_graphs, [&](size_t i) {
+			auto &components = (*data)[i].components;
+			components.resize(nodes_count[i]);
+			std::copy(src + nodes_offsets[i], src + nodes_offsets[i + 1], components.data());
+		});
 	}
 
 	size_t num_graphs;
-	std::vector<CSRHostData> &data;
+	std::vector<CSRHostData> *data;
 	size_t total_offset_size = 0;
 	std::vector<size_t> compressed_offsets, nodes_count, graphs_offsets, nodes_offsets;
-	std::vector<nodeid_t> compressed_edges, compressed_parents;
+	std::vector<nodeid_t> compressed_edges, compressed_parents, compressed_components;
+	std::vector<label_t> compressed_labels; // empty unless every graph carries labels
+
+private:
+	void allocate(const std::vector<size_t> &node_counts, const std::vector<size_t> &edge_counts)
+	{
+		num_graphs = node_counts.size();
+		nodes_count = node_counts;
+		nodes_offsets.resize(num_graphs + 1);
+		graphs_offsets.resize(num_graphs + 1);
+
+		size_t total_nodes = 0;
+		for (size_t i = 0; i < num_graphs; i++)
+		{
+			nodes_offsets[i] = total_nodes;
+			graphs_offsets[i] = total_offset_size;
+			total_nodes += node_counts[i];
+			total_offset_size += edge_counts[i];
+		}
+		nodes_offsets[num_graphs] = total_nodes;
+		graphs_offsets[num_graphs] = total_offset_size;
+
+		compressed_offsets.resize(total_nodes + 1);
+		compressed_offsets[0] = 0;
+		compressed_edges.resize(total_offset_size);
+		compressed_parents.assign(total_nodes, -1);
+	}
 };
 
 #endif
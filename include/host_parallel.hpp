@@ -0,0 +1,74 @@
+#ifndef __HOST_PARALLEL_HPP__
+#define __HOST_PARALLEL_HPP__
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Runs fn(i) for every i in [0, n) on a set of host threads.
+ *
+ * Indices are handed out dynamically, so a few large items (e.g. one big graph in a batch
+ * of small ones) do not leave the other threads idle. The first exception thrown by fn stops
+ * handing out indices and is rethrown on the calling thread once the workers are joined.
+ *
+ * @param n The number of items to process.
+ * @param fn The callable invoked with each index.
+ * @param num_threads The number of threads to use, 0 means hardware concurrency.
+ */
+template <typename F>
+void host_parallel_for(size_t n, F fn, size_t num_threads = 0)
+{
+	if (num_threads == 0)
+	{
+		num_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+	}
+	num_threads = std::min(num_threads, n);
+
+	if (num_threads <= 1)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			fn(i);
+		}
+		return;
+	}
+
+	std::atomic<size_t> next{0};
+	std::exception_ptr error;
+	std::mutex error_mutex;
+	std::vector<std::thread> workers;
+	workers.reserve(num_threads);
+	for (size_t t = 0; t < num_threads; t++)
+	{
+		workers.emplace_back([&]() {
+			for (size_t i = next.fetch_add(1); i < n; i = next.fetch_add(1))
+			{
+				try
+				{
+					fn(i);
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lock(error_mutex);
+					if (!error) error = std::current_exception();
+					next = n;
+				}
+			}
+		});
+	}
+	for (auto &w : workers)
+	{
+		w.join();
+	}
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+}
+
+#endif
@@ -0,0 +1,211 @@
+/**
+ * @file autotuner.hpp
+ * @brief Measures the BFS variants on a class of graphs and persists the fastest one.
+ */
+#ifndef __AUTOTUNER_HPP__
+#define __AUTOTUNER_HPP__
+
+#include <sycl/sycl.hpp>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "host_data.hpp"
+#include "kernel_sizes.hpp"
+#include "impl/mul_bfs.hpp"
+#include "impl/operator_registry.hpp"
+
+namespace s = sycl;
+
+typedef struct {
+	std::string op;  // a variant name of the operator registry, see operator_variant_t
+	size_t sg_size;
+	size_t wg_size;
+	bool compressed;
+	float time;      // us, best kernel time measured while tuning
+} tuning_config_t;
+
+/**
+ * @brief Picks the operator, sub-group size, work-group size and representation for a batch.
+ *
+ * Batches are grouped in classes by device and by the log2 of their node count, edge count and
+ * degree skew (max degree over average degree), so a configuration measured on one batch is
+ * reused for the batches that look alike. tune() sweeps the candidates and saves the winners to
+ * the cache file; lookup() only reads the cache, so later runs pay nothing for the sweep.
+ */
+class AutoTuner : public BFSTuner {
+public:
+	AutoTuner(const std::string &cache_file) : cache_file(cache_file) { load(); }
+
+	/**
+	 * @brief The class key of a batch on a device.
+	 */
+	static std::string graph_class(const std::vector<CSRHostData> &data, const s::device &device) {
+		size_t nodes = 0, edges = 0, max_degree = 0;
+		for (auto &g : data) {
+			nodes += g.num_nodes;
+			edges += g.csr.edges.size();
+			for (size_t u = 0; u < g.num_nodes; u++) {
+				max_degree = std::max(max_degree, g.csr.offsets[u + 1] - g.csr.offsets[u]);
+			}
+		}
+		double avg_degree = nodes > 0 ? static_cast<double>(edges) / nodes : 0;
+		double skew = avg_degree > 0 ? max_degree / avg_degree : 0;
+
+		std::ostringstream key;
+		key << device.get_info<s::info::device::name>() << "|n" << log2_bucket(nodes) << "|e" << log2_bucket(edges) << "|s" << log2_bucket(skew);
+		return key.str();
+	}
+
+	/**
+	 * @brief Finds the cached configuration of a batch.
+	 * @return false if the class of the batch was never tuned with this representation.
+	 */
+	bool find(const std::vector<CSRHostData> &data, const s::device &device, bool compressed, bool forest, tuning_config_t &config) const {
+		auto it = cache.find(entry_key(graph_class(data, device), compressed, forest));
+		if (it == cache.end()) return false;
+		config = it->second;
+		return true;
+	}
+
+	bool lookup(
+		const std::vector<CSRHostData> &data,
+		const s::device &device,
+		bool compressed,
+		bool forest,
+		std::shared_ptr<MultiBFSOperator> &op,
+		size_t &wg_size) override
+	{
+		tuning_config_t config;
+		if (!find(data, device, compressed, forest, config)) return false;
+		op = make_mbfs_operator(config.op, config.sg_size, forest);
+		wg_size = config.wg_size;
+		return true;
+	}
+
+	bool describe(
+		const std::vector<CSRHostData> &data,
+		const s::device &device,
+		bool compressed,
+		bool forest,
+		std::string &op,
+		size_t &sg_size) override
+	{
+		tuning_config_t config;
+		if (!find(data, device, compressed, forest, config)) return false;
+		op = config.op;
+		sg_size = config.sg_size;
+		return true;
+	}
+
+	/**
+	 * @brief Measures every candidate configuration on the batch and caches the fastest per representation.
+	 * @param data The batch to tune on, its parents are left untouched.
+	 * @param sources The source of each graph.
+	 * @param device The device to tune for.
+	 * @param forest Whether the operators run in forest mode.
+	 * @param repetitions The timed runs per candidate after the warm-up one, the best is kept.
+	 * @return The fastest configuration over both representations.
+	 */
+	tuning_config_t tune(
+		std::vector<CSRHostData> &data,
+		const std::vector<nodeid_t> &sources,
+		const s::device &device,
+		bool forest = false,
+		int repetitions = 3)
+	{
+		std::string cls = graph_class(data, device);
+		tuning_config_t best{"", 0, 0, true, -1};
+
+		tuning_config_t config;
+		if (sweep<true>(data, sources, device, forest, repetitions, config)) {
+			cache[entry_key(cls, true, forest)] = config;
+			best = config;
+		}
+		// the vectorized representation holds a bounded batch and has no forest mode
+		if (data.size() <= MAX_PARALLEL_GRAPHS && !forest && sweep<false>(data, sources, device, forest, repetitions, config)) {
+			cache[entry_key(cls, false, forest)] = config;
+			if (best.time < 0 || config.time < best.time) best = config;
+		}
+		if (best.time < 0) {
+			throw s::exception(s::make_error_code(s::errc::runtime), "AutoTuner: no configuration could run on " + cls);
+		}
+		save();
+		return best;
+	}
+
+private:
+	std::string cache_file;
+	std::map<std::string, tuning_config_t> cache;
+
+	static int log2_bucket(double x) { return x < 1 ? 0 : static_cast<int>(std::floor(std::log2(x))); }
+
+	static std::string entry_key(const std::string &cls, bool compressed, bool forest) {
+		return cls + (compressed ? "|compressed" : "|vectorized") + (forest ? "|forest" : "");
+	}
+
+	template<bool compressed>
+	bool sweep(
+		std::vector<CSRHostData> &data,
+		const std::vector<nodeid_t> &sources,
+		const s::device &device,
+		bool forest,
+		int repetitions,
+		tuning_config_t &best)
+	{
+		size_t max_wg_size = device.get_info<s::info::device::max_work_group_size>();
+		best.time = -1;
+
+		for (const operator_variant_t *v : device_variants(device, compressed, forest)) {
+			MultipleGraphBFS<compressed> bfs(data, v->make(forest, 0), device);
+			for (size_t wg_size = 64; wg_size <= std::min<size_t>(1024, max_wg_size); wg_size *= 2) {
+				if (wg_size % v->sg_size != 0) continue;
+				try {
+					bfs.run(sources, wg_size, false); // warm-up, includes the JIT compilation
+					float time = -1;
+					for (int r = 0; r < repetitions; r++) {
+						float t = bfs.run(sources, wg_size, false).kernel_time;
+						if (time < 0 || t < time) time = t;
+					}
+					if (best.time < 0 || time < best.time) {
+						best = tuning_config_t{v->name, v->sg_size, wg_size, compressed, time};
+					}
+				} catch (s::exception &e) {
+					// the configuration does not fit the device (e.g. local memory), skip it
+				}
+			}
+		}
+		return best.time >= 0;
+	}
+
+	void load() {
+		std::ifstream in(cache_file);
+		std::string line;
+		while (std::getline(in, line)) {
+			// <key>\t<op>\t<sg_size>\t<wg_size>\t<compressed>\t<time>
+			std::istringstream fields(line);
+			std::string key, op, sg, wg, compressed, time;
+			if (!std::getline(fields, key, '\t') || !std::getline(fields, op, '\t') || !std::getline(fields, sg, '\t') ||
+			    !std::getline(fields, wg, '\t') || !std::getline(fields, compressed, '\t') || !std::getline(fields, time, '\t')) {
+				continue;
+			}
+			cache[key] = tuning_config_t{op, std::stoul(sg), std::stoul(wg), compressed == "1", std::stof(time)};
+		}
+	}
+
+	void save() const {
+		std::ofstream out(cache_file, std::ios::trunc);
+		if (!out) {
+			throw s::exception(s::make_error_code(s::errc::runtime), "AutoTuner: cannot write " + cache_file);
+		}
+		for (auto &[key, c] : cache) {
+			out << key << '\t' << c.op << '\t' << c.sg_size << '\t' << c.wg_size << '\t' << c.compressed << '\t' << c.time << '\n';
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,261 @@
+/**
+ * @file batch_planner.hpp
+ * @brief Splits a heterogeneous batch in buckets of similar graphs, each run with its own operator.
+ */
+#ifndef __BATCH_PLANNER_HPP__
+#define __BATCH_PLANNER_HPP__
+
+#include <sycl/sycl.hpp>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "host_data.hpp"
+#include "host_parallel.hpp"
+#include "kernel_sizes.hpp"
+#include "benchmark.hpp"
+#include "impl/mul_bfs.hpp"
+#include "impl/autotuner.hpp"
+
+namespace s = sycl;
+
+typedef struct {
+	size_t num_nodes;
+	size_t num_edges;
+	float avg_degree;
+	size_t est_diameter; // extrapolated from a truncated BFS, see BatchPlanner::features
+} graph_features_t;
+
+typedef struct {
+	std::string name;           // the class of the bucket, e.g. "tiny", "chain", "dense", "sparse"
+	std::string op;             // operator registry variant, see make_mbfs_operator
+	size_t sg_size;
+	size_t wg_size;
+	bool tuned;                 // whether op, sg_size and wg_size come from the tuner
+	std::vector<size_t> graphs; // indices in the batch
+	size_t num_nodes;
+	size_t num_edges;
+	bench_time_t time;          // of the last run
+} bucket_plan_t;
+
+/**
+ * @brief Runs a batch as buckets of similar graphs, each with the operator and launch geometry that suits it.
+ *
+ * Graphs are classified by size, average degree and an estimate of their diameter:
+ * - tiny graphs run on bit matrices (bottom-up when they are too sparse) with small work-groups;
+ * - long, thin graphs (chains, paths, meshes) run top-down, where each level only touches the frontier;
+ * - dense graphs run bottom-up, which finishes in a few levels;
+ * - the remaining sparse graphs run the direction-optimizing sparse-product operator.
+ * A bucket whose class was tuned by the tuner uses the tuned configuration instead. Every bucket has
+ * its own MultipleGraphBFS on a shared queue and all of them are submitted before any is waited
+ * for, so the buckets run concurrently. The graphs are moved into their bucket for a run and back
+ * after it, so they are never copied.
+ */
+class BatchPlanner {
+public:
+	static constexpr size_t TINY_NODES = 64;
+	static constexpr float DENSE_DEGREE = 16;
+	static constexpr size_t CHAIN_DIAMETER = 64;
+	static constexpr size_t PROBE_EDGES = 4096;
+
+	/**
+	 * @param data The batch, its parents (and components in forest mode) are written by run().
+	 * @param forest Whether the operators run in forest mode.
+	 * @param tuner Tuned configurations to prefer over the heuristics, may be null.
+	 */
+	BatchPlanner(std::vector<CSRHostData> &data, bool forest = false, BFSTuner *tuner = nullptr) :
+		data(data), forest(forest),
+		queue(s::gpu_selector_v, s::property_list{s::property::queue::enable_profiling{}})
+	{
+		std::vector<graph_features_t> feats(data.size());
+		host_parallel_for(data.size(), [&](size_t i) { feats[i] = features(data[i]); });
+
+		std::map<std::string, size_t> by_name;
+		for (size_t i = 0; i < data.size(); i++) {
+			std::string name = classify(feats[i]);
+			auto it = by_name.find(name);
+			if (it == by_name.end()) {
+				it = by_name.emplace(name, plans.size()).first;
+				plans.push_back(heuristic_plan(name));
+			}
+			auto &plan = plans[it->second];
+			plan.graphs.push_back(i);
+			plan.num_nodes += feats[i].num_nodes;
+			plan.num_edges += feats[i].num_edges;
+		}
+
+		for (auto &plan : plans) buckets.push_back(std::make_unique<bucket_t>());
+		gather();
+		for (size_t b = 0; b < plans.size(); b++) {
+			auto &plan = plans[b];
+			auto &bucket = *buckets[b];
+			std::shared_ptr<MultiBFSOperator> op = make_mbfs_operator(plan.op, plan.sg_size, forest);
+			try {
+				if (tuner != nullptr && tuner->lookup(bucket.graphs, queue.get_device(), true, forest, op, plan.wg_size)) {
+					plan.tuned = true;
+					if (!tuner->describe(bucket.graphs, queue.get_device(), true, forest, plan.op, plan.sg_size)) plan.op = "tuned";
+				}
+			} catch (...) {
+				scatter();
+				throw;
+			}
+			bucket.bfs = std::make_unique<MultipleGraphBFS<true>>(bucket.graphs, op, queue);
+		}
+		scatter();
+	}
+
+	const std::vector<bucket_plan_t> &plan() const { return plans; }
+
+	/**
+	 * @brief Prints one line per bucket: class, operator, launch geometry, size and last run time.
+	 */
+	void print_plan(std::ostream &out) const {
+		for (auto &p : plans) {
+			out << "- Bucket " << p.name << " | Graphs: " << p.graphs.size() << " | Nodes: " << p.num_nodes << " | Edges: " << p.num_edges
+			    << " | Operator: " << p.op << "<" << p.sg_size << ">" << (p.tuned ? " (tuned)" : "") << " | Work-group size: " << p.wg_size
+			    << " | Kernel time: " << p.time.kernel_time << " us\n";
+		}
+		out.flush();
+	}
+
+	/**
+	 * @brief Builds the kernels of every bucket, see MultipleGraphBFS::warmup.
+	 * @return The startup time in us
+	 */
+	float warmup() {
+		float time = 0;
+		for (size_t b = 0; b < buckets.size(); b++) time += buckets[b]->bfs->warmup(plans[b].wg_size);
+		return time;
+	}
+
+	/**
+	 * @brief Runs the BFS of every graph of the batch, the buckets concurrently.
+	 * @param sources The source of each graph of the batch
+	 * @param write_back Whether to copy the parents back to the graphs of the batch
+	 * @return The summed kernel time, transfers and device memory of the buckets and the wall time of the whole batch
+	 */
+	bench_time_t run(const std::vector<nodeid_t> &sources, bool write_back = true) {
+		auto start = std::chrono::high_resolution_clock::now();
+		bench_time_t time{0, 0, 1.0f};
+		size_t device_bytes = 0;
+		// the results are written in the bucket graphs, which go back to the batch with them
+		gather();
+		try {
+			std::vector<MultipleGraphBFS<true>::Submission> subs;
+			for (size_t b = 0; b < buckets.size(); b++) {
+				std::vector<nodeid_t> bucket_sources;
+				for (auto i : plans[b].graphs) bucket_sources.push_back(sources[i]);
+				subs.push_back(buckets[b]->bfs->submit(bucket_sources, plans[b].wg_size, write_back));
+			}
+			for (size_t b = 0; b < buckets.size(); b++) {
+				plans[b].time = subs[b].get();
+				accumulate(time, plans[b].time);
+				// the buckets are resident at the same time
+				device_bytes += plans[b].time.device_bytes;
+			}
+		} catch (...) {
+			scatter();
+			throw;
+		}
+		scatter();
+		auto end = std::chrono::high_resolution_clock::now();
+		time.total_time = static_cast<float>(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+		time.device_bytes = device_bytes;
+		return time;
+	}
+
+	/**
+	 * @brief Size, average degree and estimated diameter of a graph.
+	 *
+	 * A BFS from node 0 stops after PROBE_EDGES edges; the average width of the levels it completed
+	 * extrapolates the diameter as num_nodes / width, which is about num_nodes for a chain and a few
+	 * levels for a random graph.
+	 */
+	static graph_features_t features(const CSRHostData &g) {
+		graph_features_t f{g.num_nodes, g.csr.edges.size(), g.num_nodes > 0 ? static_cast<float>(g.csr.edges.size()) / g.num_nodes : 0, 0};
+		if (g.num_nodes == 0) return f;
+
+		std::vector<nodeid_t> frontier{0}, next;
+		std::vector<char> visited(g.num_nodes, 0);
+		visited[0] = 1;
+		size_t levels = 0, reached = 1, edges = 0;
+		while (!frontier.empty() && edges < PROBE_EDGES) {
+			next.clear();
+			// the budget is checked at every edge, so a hub in the frontier does not scan a whole level
+			for (size_t j = 0; j < frontier.size() && edges < PROBE_EDGES; j++) {
+				nodeid_t u = frontier[j];
+				for (size_t k = g.csr.offsets[u]; k < g.csr.offsets[u + 1] && edges < PROBE_EDGES; k++, edges++) {
+					nodeid_t v = g.csr.edges[k];
+					if (!visited[v]) {
+						visited[v] = 1;
+						next.push_back(v);
+					}
+				}
+			}
+			// a level cut by the budget still counts, its width is a lower bound
+			reached += next.size();
+			levels++;
+			std::swap(frontier, next);
+		}
+		float width = std::max(1.0f, static_cast<float>(reached) / std::max<size_t>(1, levels));
+		// the probe covered the whole component: its depth is the estimate
+		f.est_diameter = frontier.empty() ? levels : static_cast<size_t>(g.num_nodes / width);
+		return f;
+	}
+
+	static std::string classify(const graph_features_t &f) {
+		if (f.num_nodes <= TINY_NODES) return "tiny";
+		if (f.est_diameter >= CHAIN_DIAMETER) return "chain";
+		if (f.avg_degree >= DENSE_DEGREE) return "dense";
+		return "sparse";
+	}
+
+private:
+	struct bucket_t {
+		std::vector<CSRHostData> graphs; // moved in from the batch while the bucket is looked up or run, empty otherwise
+		std::unique_ptr<MultipleGraphBFS<true>> bfs;
+	};
+
+	std::vector<CSRHostData> &data;
+	bool forest;
+	s::queue queue;
+	std::vector<bucket_plan_t> plans;
+	std::vector<std::unique_ptr<bucket_t>> buckets;
+
+	// moves the graphs of the batch into their buckets
+	void gather() {
+		for (size_t b = 0; b < plans.size(); b++) {
+			for (auto i : plans[b].graphs) buckets[b]->graphs.push_back(std::move(data[i]));
+		}
+	}
+
+	// moves the graphs back to the batch
+	void scatter() {
+		for (size_t b = 0; b < plans.size(); b++) {
+			auto &graphs = buckets[b]->graphs;
+			for (size_t k = 0; k < graphs.size(); k++) data[plans[b].graphs[k]] = std::move(graphs[k]);
+			graphs.clear();
+		}
+	}
+
+	bucket_plan_t heuristic_plan(const std::string &name) const {
+		bucket_plan_t p{name, "", 16, DEFAULT_WORK_GROUP_SIZE, false, {}, 0, 0, bench_time_t{0, 0, 1.0f}};
+		if (name == "tiny") {
+			p.op = "matrix";
+			p.wg_size = TINY_NODES;
+		} else if (name == "chain") {
+			p.op = "frontier";
+		} else if (name == "dense") {
+			p.op = "bottomup";
+		} else {
+			// the sparse-product operator has no forest mode
+			p.op = forest ? "bottomup" : "spmv";
+		}
+		return p;
+	}
+};
+
+#endif
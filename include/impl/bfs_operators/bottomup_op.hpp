@@ -6,12 +6,55 @@
 #ifndef __BOTTOM_UP_OP_HPP__
 #define __BOTTOM_UP_OP_HPP__
 
+#include <climits>
+#include <type_traits>
 #include "impl/mul_bfs.hpp"
+#include "impl/bfs_operators/forest.hpp"
 
 namespace s = sycl;
 
-typedef uint32_t mask_t;
-constexpr size_t MASK_SIZE = 32; // the size of the mask according to the type of mask_t
+/**
+ * @brief Looks for a frontier neighbor of the heavy vertices of a sub-group, using all its lanes for each vertex.
+ *
+ * Every lane passes its own vertex, the lanes with heavy set are served one after the other. The lanes
+ * stride over the adjacency of the served vertex and stop at the first stride where any of them hits
+ * the frontier; the smallest neighbor hit in that stride becomes the parent. Must be called by the
+ * whole sub-group.
+ *
+ * @param begin, end The range of the adjacency of the vertex of the lane in edges.
+ * @return The parent found for the vertex of the calling lane, -1 if it has none or is not heavy.
+ */
+template <typename EdgesAcc, typename FrontierAcc>
+inline nodeid_t cooperative_scan(const s::sub_group &sg, bool heavy, size_t begin, size_t end, const EdgesAcc &edges, const FrontierAcc &frontier) {
+  typedef std::remove_cv_t<std::remove_reference_t<decltype(frontier[0])>> word_t;
+  constexpr size_t WORD_BITS = sizeof(word_t) * 8;
+  const size_t lane = sg.get_local_linear_id();
+  const size_t width = sg.get_local_linear_range();
+
+  nodeid_t parent = -1;
+  while (s::any_of_group(sg, heavy)) {
+    size_t leader = s::reduce_over_group(sg, heavy ? lane : width, s::minimum<size_t>());
+    size_t first = s::group_broadcast(sg, begin, leader);
+    size_t last = s::group_broadcast(sg, end, leader);
+    nodeid_t found = -1;
+    for (size_t i = first; i < last; i += width) {
+      nodeid_t candidate = INT_MAX;
+      if (i + lane < last) {
+        nodeid_t neighbor = edges[i + lane];
+        if (frontier[neighbor / WORD_BITS] & (static_cast<word_t>(1) << (neighbor % WORD_BITS))) candidate = neighbor;
+      }
+      if (s::any_of_group(sg, candidate != INT_MAX)) {
+        found = s::reduce_over_group(sg, candidate, s::minimum<nodeid_t>());
+        break;
+      }
+    }
+    if (lane == leader) {
+      parent = found;
+      heavy = false;
+    }
+  }
+  return parent;
+}
 
 /**
  * @brief Implements the bottom-up BFS traversal algorithm.
@@ -19,123 +62,199 @@ constexpr size_t MASK_SIZE = 32; // the size of the mask according to the type o
  * This class provides two operator() overloads, one for SYCL_CompressedGraphData and one for SYCL_VectorizedGraphData.
  * Both overloads take a SYCL queue, a graph data structure, a vector of source nodes, a vector of events, and an optional work group size.
  * The operator() overloads launch a SYCL kernel that performs the bottom-up BFS traversal algorithm on the input graph(s).
+ *
+ * Each work-item scans the adjacency of its unvisited vertices serially until it finds a frontier
+ * neighbor. With a heavy degree set, the vertices with at least that many neighbors are instead
+ * scanned by their whole sub-group (see cooperative_scan), so a few hubs no longer set the time of
+ * every level on graphs with skewed degrees.
  * 
  * @tparam sg_size The sub-group size to use in the kernel.
+ * @tparam mask_bits The width of the words of the frontier bitsets, 32 or 64.
  */
-template <size_t sg_size = 16>
+template <size_t sg_size = 16, size_t mask_bits = 32>
 class BottomUpMBFSOperator : public MultiBFSOperator
 {
+  static_assert(mask_bits == 32 || mask_bits == 64, "BottomUpMBFSOperator: the frontier words are 32 or 64 bits wide");
+  typedef std::conditional_t<mask_bits == 64, uint64_t, uint32_t> mask_t;
+  static constexpr size_t MASK_SIZE = mask_bits; // the size of the mask according to the type of mask_t
+
+public:
+  static constexpr size_t DEFAULT_HEAVY_DEGREE = 4 * sg_size;
+
+  /**
+   * @param forest If true, every node of the graphs is labeled with a parent and a component id, see MultiBFSOperator.
+   * @param heavy_degree The degree from which a vertex is scanned by its whole sub-group, 0 scans every vertex serially.
+   */
+  BottomUpMBFSOperator(bool forest = false, size_t heavy_degree = 0) : heavy_degree(heavy_degree) { this->forest = forest; }
+
   /**
    * @brief This method performs the BFS on multiple graphs using a bottom-up approach.
    * 
    * @param queue The SYCL queue to submit the kernel to.
+   * @param pool The memory pool to draw the scratch buffers from.
    * @param data The compressed graph data.
    * @param sources The vector of source nodes.
    * @param events The vector of events to be updated with the new event.
    * @param wg_size The size of the work-group to be used in the kernel.
    */
-  void operator()(s::queue &queue, SYCL_CompressedGraphData &data, const std::vector<nodeid_t> &sources, std::vector<s::event> &events, const size_t wg_size = DEFAULT_WORK_GROUP_SIZE)
+  void operator()(s::queue &queue, MemoryPool &pool, SYCL_CompressedGraphData &data, const std::vector<nodeid_t> &sources, std::vector<s::event> &events, const size_t wg_size = DEFAULT_WORK_GROUP_SIZE)
   {
+    check_label_mask(data, "BottomUpMBFSOperator");
     s::range<1> global{wg_size * (data.host_data.num_graphs)}; // each workgroup will process a graph
     s::range<1> local{wg_size};
 
-    s::buffer<nodeid_t, 1> sources_buf{sources.data(), s::range<1>{sources.size()}};
+    ScratchBuffer<nodeid_t> sources_dev{pool, sources.size()};
+    auto copy_e = queue.copy(sources.data(), sources_dev.get(), sources.size());
+    const nodeid_t *sources_ptr = sources_dev.get();
 
     auto e = queue.submit([&](s::handler &cgh) {
+      cgh.depends_on(copy_e);
       s::accessor offsets_acc{data.edges_offsets, cgh, s::read_only};
       s::accessor edges_acc{data.edges, cgh, s::read_only};
       s::accessor parents_acc{data.parents, cgh, s::read_write};
       s::accessor graphs_offsets_acc{data.graphs_offests, cgh, s::read_only};
       s::accessor nodes_offsets_acc{data.nodes_offsets, cgh, s::read_only};
       s::accessor nodes_count_acc{data.nodes_count, cgh, s::read_only};
-      s::accessor sources_acc{sources_buf, cgh, s::read_only};
+      s::accessor components_acc{data.components, cgh, s::write_only, s::no_init};
+      s::accessor labels_acc{data.labels, cgh, s::read_only};
+      const bool forest = this->forest;
+      const bool constrained = this->constrained();
+      const label_mask_t label_mask = this->label_mask;
+      const size_t heavy_degree = this->heavy_degree;
 
       const size_t MAX_NODES = *std::max_element(data.host_data.nodes_count.begin(), data.host_data.nodes_count.end()); // get the max number of nodes in graph
       const size_t NUM_MASKS = MAX_NODES / MASK_SIZE + 1; // the number of masks needed to represent all nodes
       s::local_accessor<mask_t, 1> frontier{s::range<1>{NUM_MASKS}, cgh};
       s::local_accessor<mask_t, 1> next{s::range<1>{NUM_MASKS}, cgh};
-      s::local_accessor<mask_t, 1> running{s::range<1>{1}, cgh};
 
       cgh.parallel_for(s::nd_range<1>{global, local}, [=](s::nd_item<1> item) [[intel::reqd_sub_group_size(sg_size)]] {
-        s::atomic_ref<mask_t, s::memory_order::relaxed, s::memory_scope::work_group, s::access::address_space::local_space> running_ar{running[0]};
         auto grp_id = item.get_group_linear_id();
         auto loc_id = item.get_local_id(0);
         auto node_offset = nodes_offsets_acc[grp_id];
         auto node_count = nodes_count_acc[grp_id];
         auto local_size = item.get_local_range(0);
+        auto sg = item.get_sub_group();
+
+        nodeid_t root = sources_ptr[grp_id];
+        size_t cursor = 0;
 
         // init the frontier
+        for (size_t i = loc_id; i < NUM_MASKS; i += local_size) {
+          next[i] = 0;
+        }
+        item.barrier(s::access::fence_space::local_space);
         if (loc_id == 0) {
-          running_ar.store(1);
-          auto source = sources_acc[grp_id];
-          int source_offset = source / MASK_SIZE;
-          mask_t source_bit = 1 << (source % MASK_SIZE);
+          int source_offset = root / MASK_SIZE;
+          mask_t source_bit = static_cast<mask_t>(1) << (root % MASK_SIZE);
           frontier[source_offset] = next[source_offset] = source_bit;
+          if (forest) components_acc[node_offset + root] = root;
         }
 
         item.barrier(s::access::fence_space::local_space);
-        while (running_ar.load()) {
-          if (loc_id < NUM_MASKS) {
-            frontier[loc_id] = next[loc_id];
-            next[loc_id] = 0;
-          }
-          item.barrier(s::access::fence_space::local_space);
+        bool running = true;
+        while (true) {
+          while (running) {
+            for (size_t i = loc_id; i < NUM_MASKS; i += local_size) {
+              frontier[i] = next[i];
+              next[i] = 0;
+            }
+            item.barrier(s::access::fence_space::local_space);
 
-          for (nodeid_t node_id = loc_id; node_id < node_count; node_id += local_size) {
-            int node_mask_offet = node_id / MASK_SIZE; // to access the right mask
-            mask_t node_bit = 1 << (node_id % MASK_SIZE); // to access the right bit in the mask 
-            s::atomic_ref<mask_t, s::memory_order::relaxed, s::memory_scope::work_group, s::access::address_space::local_space> next_ar{next[node_mask_offet]};
+            // the bound is the same for the whole work-group, so the sub-groups stay converged for cooperative_scan
+            for (size_t base = 0; base < node_count; base += local_size) {
+              nodeid_t node_id = base + loc_id;
+              nodeid_t parent = -1;
+              bool heavy = false;
+              size_t begin = 0, end = 0;
 
-            if (parents_acc[node_offset + node_id] == -1) {
-              for (int i = offsets_acc[node_offset + node_id]; i < offsets_acc[node_offset + node_id + 1]; i++) {
-                nodeid_t neighbor = edges_acc[i];
-                int neighbor_mask_offset = neighbor / MASK_SIZE;
-                mask_t neighbor_bit = 1 << (neighbor % MASK_SIZE);
-                if (frontier[neighbor_mask_offset] & neighbor_bit) {
-                  parents_acc[node_offset + node_id] = neighbor;
-                  next_ar |= node_bit;
-                  break;
+              // the nodes out of the mask are never reached, so they never enter the frontier either
+              if (node_id < node_count && parents_acc[node_offset + node_id] == -1 && (!constrained || label_matches(label_mask, labels_acc[node_offset + node_id]))) {
+                begin = offsets_acc[node_offset + node_id];
+                end = offsets_acc[node_offset + node_id + 1];
+                heavy = heavy_degree > 0 && end - begin >= heavy_degree;
+                for (size_t i = begin; !heavy && i < end; i++) {
+                  nodeid_t neighbor = edges_acc[i];
+                  int neighbor_mask_offset = neighbor / MASK_SIZE;
+                  mask_t neighbor_bit = static_cast<mask_t>(1) << (neighbor % MASK_SIZE);
+                  if (frontier[neighbor_mask_offset] & neighbor_bit) {
+                    parent = neighbor;
+                    break;
+                  }
                 }
               }
+              if (heavy_degree > 0) {
+                nodeid_t found = cooperative_scan(sg, heavy, begin, end, edges_acc, frontier);
+                if (heavy) parent = found;
+              }
+
+              if (parent != -1) {
+                int node_mask_offet = node_id / MASK_SIZE; // to access the right mask
+                mask_t node_bit = static_cast<mask_t>(1) << (node_id % MASK_SIZE); // to access the right bit in the mask 
+                s::atomic_ref<mask_t, s::memory_order::relaxed, s::memory_scope::work_group, s::access::address_space::local_space> next_ar{next[node_mask_offet]};
+                parents_acc[node_offset + node_id] = parent;
+                if (forest) components_acc[node_offset + node_id] = root;
+                next_ar |= node_bit;
+              }
+            }
+
+            item.barrier(s::access::fence_space::local_space);
+            mask_t pending = 0;
+            for (size_t i = loc_id; i < NUM_MASKS; i += local_size) {
+              pending |= next[i];
             }
+            running = s::any_of_group(item.get_group(), pending != 0);
           }
-          
-          if (loc_id == 0) running_ar.store(0);
-          item.barrier(s::access::fence_space::local_space);
-          if (loc_id < NUM_MASKS) {
-            running_ar += next[loc_id];
+          if (!forest) break;
+
+          // seed the next component, next is empty at this point
+          item.barrier(s::access::fence_space::global_and_local);
+          root = next_unvisited(item, parents_acc, node_offset, node_count, cursor);
+          if (root == -1) break;
+          running = true;
+          if (loc_id == 0) {
+            parents_acc[node_offset + root] = root;
+            components_acc[node_offset + root] = root;
+            next[root / MASK_SIZE] = static_cast<mask_t>(1) << (root % MASK_SIZE);
           }
-          item.barrier(s::access::fence_space::local_space);
+          item.barrier(s::access::fence_space::global_and_local);
         }
       }); 
     });
     events.push_back(e);
-    e.wait_and_throw();
+    sources_dev.release_after(e);
   }
 
   /**
    * @brief This method performs the BFS on multiple graphs using a bottom-up approach.
    * 
    * @param queue The SYCL queue to submit the kernel to.
+   * @param pool The memory pool to draw the scratch buffers from.
    * @param data The vectorized graph data.
    * @param sources The vector of source nodes.
    * @param events The vector of events to be updated with the new event.
    * @param wg_size The size of the work-group to be used in the kernel.
    */
-  void operator()(s::queue &queue, SYCL_VectorizedGraphData &data, const std::vector<nodeid_t> &sources, std::vector<s::event> &events, const size_t wg_size = DEFAULT_WORK_GROUP_SIZE)
+  void operator()(s::queue &queue, MemoryPool &pool, SYCL_VectorizedGraphData &data, const std::vector<nodeid_t> &sources, std::vector<s::event> &events, const size_t wg_size = DEFAULT_WORK_GROUP_SIZE)
   {
+    if (forest) {
+      throw s::exception(s::make_error_code(s::errc::feature_not_supported), "BottomUpMBFSOperator: forest mode requires the compressed representation");
+    }
+    check_unconstrained("BottomUpMBFSOperator");
+
     s::range<1> global{wg_size * (data.data.size())}; // each workgroup will process a graph
     s::range<1> local{wg_size};
 
-    s::buffer<nodeid_t, 1> sources_buf{sources.data(), s::range<1>{sources.size()}};
+    ScratchBuffer<nodeid_t> sources_dev{pool, sources.size()};
+    auto copy_e = queue.copy(sources.data(), sources_dev.get(), sources.size());
+    const nodeid_t *sources_ptr = sources_dev.get();
 
     auto e = queue.submit([&](s::handler &cgh) {
+      cgh.depends_on(copy_e);
       size_t n_nodes [MAX_PARALLEL_GRAPHS];
 
       s::accessor<size_t, 1, s::access::mode::read> offsets_acc[MAX_PARALLEL_GRAPHS];
       s::accessor<nodeid_t, 1, s::access::mode::read> edges_acc[MAX_PARALLEL_GRAPHS];
       s::accessor<nodeid_t, 1, s::access::mode::read_write> parents_acc[MAX_PARALLEL_GRAPHS];
-      s::accessor<nodeid_t, 1, s::access::mode::read> sources_acc{sources_buf, cgh, s::read_only};
 
       for (int i = 0; i < data.data.size(); i++) {
         offsets_acc[i] = data.offsets[i].get_access<s::access::mode::read>(cgh);
@@ -144,70 +263,91 @@ class BottomUpMBFSOperator : public MultiBFSOperator
         n_nodes[i] = data.data[i].num_nodes;
       }
 
-      typedef uint64_t mask_t;
-      const unsigned MASK_SIZE = 64; // the size of the mask according to the type of mask_t
-      const size_t MAX_NODES = *std::max_element(&n_nodes[0], &n_nodes[data.data.size() - 1]); // get the max number of nodes in graph
+      const size_t MAX_NODES = *std::max_element(n_nodes, n_nodes + data.data.size()); // get the max number of nodes in graph
       const unsigned NUM_MASKS = MAX_NODES / MASK_SIZE + 1; // the number of masks needed to represent all nodes
+      const size_t heavy_degree = this->heavy_degree;
       s::local_accessor<mask_t, 1> frontier{s::range<1>{NUM_MASKS}, cgh};
       s::local_accessor<mask_t, 1> next{s::range<1>{NUM_MASKS}, cgh};
-      s::local_accessor<mask_t, 1> running{s::range<1>{1}, cgh};
 
       cgh.parallel_for(s::nd_range<1>{global, local}, [=](s::nd_item<1> item) [[intel::reqd_sub_group_size(sg_size)]] {
-        s::atomic_ref<mask_t, s::memory_order::relaxed, s::memory_scope::work_group> running_ar{running[0]};
         auto grp_id = item.get_group_linear_id();
         auto loc_id = item.get_local_id(0);
         auto local_size = item.get_local_range(0);
+        auto sg = item.get_sub_group();
 
         auto offsets = offsets_acc[grp_id];
         auto edges = edges_acc[grp_id];
         auto parents = parents_acc[grp_id];
         auto node_count = n_nodes[grp_id];
 
+        for (size_t i = loc_id; i < NUM_MASKS; i += local_size) {
+          next[i] = 0;
+        }
+        item.barrier(s::access::fence_space::local_space);
         if (loc_id == 0) {
-          running_ar.store(1);
-          auto source = sources_acc[grp_id];
+          auto source = sources_ptr[grp_id];
           int source_offset = source / MASK_SIZE;
-          mask_t source_bit = 1 << (source % MASK_SIZE);
+          mask_t source_bit = static_cast<mask_t>(1) << (source % MASK_SIZE);
           frontier[source_offset] = next[source_offset] = source_bit;
         }
 
         item.barrier(s::access::fence_space::local_space);
-        while (running_ar.load()) {
-          if (loc_id < NUM_MASKS) {
-            frontier[loc_id] = next[loc_id];
-            next[loc_id] = 0;
+        bool running = true;
+        while (running) {
+          for (size_t i = loc_id; i < NUM_MASKS; i += local_size) {
+            frontier[i] = next[i];
+            next[i] = 0;
           }
           item.barrier(s::access::fence_space::local_space);
 
-          for (nodeid_t node_id = loc_id; node_id < node_count; node_id += local_size) {
-            int node_mask_offet = node_id / MASK_SIZE; // to access the right mask
-            mask_t node_bit = 1 << (node_id % MASK_SIZE); // to access the right bit in the mask 
-            s::atomic_ref<mask_t, s::memory_order::relaxed, s::memory_scope::work_group> next_ar{next[node_mask_offet]};
-            if (parents[node_id] == -1) {
-              for (int i = offsets[node_id]; i < offsets[node_id + 1]; i++) {
+          for (size_t base = 0; base < node_count; base += local_size) {
+            nodeid_t node_id = base + loc_id;
+            nodeid_t parent = -1;
+            bool heavy = false;
+            size_t begin = 0, end = 0;
+
+            if (node_id < node_count && parents[node_id] == -1) {
+              begin = offsets[node_id];
+              end = offsets[node_id + 1];
+              heavy = heavy_degree > 0 && end - begin >= heavy_degree;
+              for (size_t i = begin; !heavy && i < end; i++) {
                 nodeid_t neighbor = edges[i];
                 int neighbor_mask_offset = neighbor / MASK_SIZE;
-                mask_t neighbor_bit = 1 << (neighbor % MASK_SIZE);
+                mask_t neighbor_bit = static_cast<mask_t>(1) << (neighbor % MASK_SIZE);
                 if (frontier[neighbor_mask_offset] & neighbor_bit) {
-                  parents[node_id] = neighbor;
-                  next_ar |= node_bit;
+                  parent = neighbor;
                   break;
                 }
               }
             }
+            if (heavy_degree > 0) {
+              nodeid_t found = cooperative_scan(sg, heavy, begin, end, edges, frontier);
+              if (heavy) parent = found;
+            }
+
+            if (parent != -1) {
+              int node_mask_offet = node_id / MASK_SIZE; // to access the right mask
+              mask_t node_bit = static_cast<mask_t>(1) << (node_id % MASK_SIZE); // to access the right bit in the mask 
+              s::atomic_ref<mask_t, s::memory_order::relaxed, s::memory_scope::work_group> next_ar{next[node_mask_offet]};
+              parents[node_id] = parent;
+              next_ar |= node_bit;
+            }
           }
-          
-          running[0] = 0;
+
           item.barrier(s::access::fence_space::local_space);
-          if (loc_id < NUM_MASKS) {
-            running_ar += next[loc_id];
+          mask_t pending = 0;
+          for (size_t i = loc_id; i < NUM_MASKS; i += local_size) {
+            pending |= next[i];
           }
-          item.barrier(s::access::fence_space::local_space);
+          running = s::any_of_group(item.get_group(), pending != 0);
         }
       }); });
     events.push_back(e);
-    e.wait_and_throw();
+    sources_dev.release_after(e);
   }
+
+private:
+  size_t heavy_degree;
 };
 
 #endif
\ No newline at end of file
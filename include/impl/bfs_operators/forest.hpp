@@ -0,0 +1,39 @@
+/**
+ * @file forest.hpp
+ * @brief Device helpers shared by the operators running in forest (all components) mode.
+ */
+#ifndef __FOREST_HPP__
+#define __FOREST_HPP__
+
+#include <sycl/sycl.hpp>
+#include <climits>
+#include "types.hpp"
+
+namespace s = sycl;
+
+/**
+ * @brief Finds the next vertex of the graph that has not been reached yet.
+ *
+ * Must be called by the whole work-group after a barrier that makes the parents written in the
+ * previous traversal visible. The search resumes from cursor, which is updated, so every vertex
+ * is scanned once over all the components of a graph.
+ *
+ * @return The local id of the vertex, or -1 if all the vertices have been reached.
+ */
+template <typename ParentsAcc>
+inline nodeid_t next_unvisited(const s::nd_item<1> &item, const ParentsAcc &parents, size_t node_offset, size_t node_count, size_t &cursor) {
+  auto loc_id = item.get_local_id(0);
+  auto local_size = item.get_local_range(0);
+  for (; cursor < node_count; cursor += local_size) {
+    size_t node_id = cursor + loc_id;
+    nodeid_t candidate = (node_id < node_count && parents[node_offset + node_id] == -1) ? static_cast<nodeid_t>(node_id) : INT_MAX;
+    nodeid_t found = s::reduce_over_group(item.get_group(), candidate, s::minimum<nodeid_t>());
+    if (found != INT_MAX) {
+      cursor = found;
+      return found;
+    }
+  }
+  return -1;
+}
+
+#endif
@@ -8,6 +8,7 @@
 #include "impl/mul_bfs.hpp"
 #include "impl/simpl_bfs.hpp"
 #include "kernel_sizes.hpp"
+#include "impl/bfs_operators/forest.hpp"
 
 /**
  * @brief This class implements the BFS operator that uses a frontier-based approach for multiple graphs.
@@ -17,34 +18,52 @@
 template<size_t sg_size = 16>
 class FrontierMBFSOperator : public MultiBFSOperator {
 public:
-  FrontierMBFSOperator() = default;
+  /**
+   * @param forest If true, every node of the graphs is labeled with a parent and a component id, see MultiBFSOperator.
+   */
+  FrontierMBFSOperator(bool forest = false) { this->forest = forest; }
+
+  size_t scratch_bytes(const CSRHostData &g) const override {
+    // the two frontiers and the source
+    return 2 * g.num_nodes * sizeof(nodeid_t) + sizeof(nodeid_t);
+  }
 
   /**
    * @brief This method performs the BFS on multiple graphs using a frontier-based approach.
    * 
    * @param queue The SYCL queue to submit the kernel to.
+   * @param pool The memory pool to draw the scratch buffers from.
    * @param data The compressed graph data.
    * @param sources The vector of source nodes.
    * @param events The vector of events to be updated with the new event.
    * @param wg_size The size of the work-group to be used in the kernel.
    */
-  void operator() (s::queue& queue, SYCL_CompressedGraphData& data, const std::vector<nodeid_t> &sources, std::vector<s::event>& events, const size_t wg_size = DEFAULT_WORK_GROUP_SIZE) {
-    s::range<1> global{wg_size * (data.host_data.graphs_offsets.size() - 1)}; // each workgroup will process a graph
+  void operator() (s::queue& queue, MemoryPool& pool, SYCL_CompressedGraphData& data, const std::vector<nodeid_t> &sources, std::vector<s::event>& events, const size_t wg_size = DEFAULT_WORK_GROUP_SIZE) {
+    check_label_mask(data, "FrontierMBFSOperator");
+    auto &host = data.host_data;
+    const size_t total_nodes = host.nodes_offsets[host.num_graphs];
+    s::range<1> global{wg_size * host.num_graphs}; // each workgroup will process a graph
     s::range<1> local{wg_size};
 
-    s::buffer<nodeid_t, 1> sources_buf{sources.data(), s::range<1>{sources.size()}};
+    ScratchBuffer<nodeid_t> sources_dev{pool, sources.size()};
+    ScratchBuffer<nodeid_t> lists_dev{pool, 2 * total_nodes}; // current and next frontier of every graph
+    auto copy_e = queue.copy(sources.data(), sources_dev.get(), sources.size());
+    const nodeid_t *sources_ptr = sources_dev.get();
+    nodeid_t *lists_ptr = lists_dev.get();
 
     auto e = queue.submit([&](s::handler& cgh) {
+      cgh.depends_on(copy_e);
       s::accessor offsets_acc{data.edges_offsets, cgh, s::read_only};
       s::accessor edges_acc{data.edges, cgh, s::read_only};
       s::accessor parents_acc{data.parents, cgh, s::read_write, s::no_init};
-      s::accessor graphs_offsets_acc{data.graphs_offests, cgh, s::read_only};
       s::accessor nodes_offsets_acc{data.nodes_offsets, cgh, s::read_only};
       s::accessor nodes_count_acc{data.nodes_count, cgh, s::read_only};
-      s::accessor sources_acc{sources_buf, cgh, s::read_only};
+      s::accessor components_acc{data.components, cgh, s::write_only, s::no_init};
+      s::accessor labels_acc{data.labels, cgh, s::read_only};
+      const bool forest = this->forest;
+      const bool constrained = this->constrained();
+      const label_mask_t label_mask = this->label_mask;
 
-      typedef int fsize_t;
-      s::local_accessor<fsize_t, 1> frontier{s::range<1>{wg_size}, cgh};
       s::local_accessor<size_t, 1> fsize_curr{s::range<1>{1}, cgh};
       s::local_accessor<size_t, 1> fsize_prev{s::range<1>{1}, cgh};
 
@@ -52,66 +71,104 @@ public:
           s::atomic_ref<size_t, s::memory_order::acq_rel, s::memory_scope::work_group> fsize_curr_ar{fsize_curr[0]};
           auto grp_id = item.get_group_linear_id();
           auto loc_id = item.get_local_id(0);
-          auto edge_offset = graphs_offsets_acc[grp_id];
           auto node_offset = nodes_offsets_acc[grp_id];
           auto node_count = nodes_count_acc[grp_id];
           auto local_size = item.get_local_range(0);
 
+          // every node enters a frontier once, so each of the two lists of the graph holds node_count entries
+          nodeid_t *curr = lists_ptr + 2 * node_offset;
+          nodeid_t *next = curr + node_count;
+          nodeid_t root = sources_ptr[grp_id];
+          size_t cursor = 0;
+
           // init frontier
           if (loc_id == 0) {
-            frontier[0] = sources_acc[grp_id];
+            curr[0] = root;
             fsize_prev[0] = 1;
+            fsize_curr[0] = 0;
+            if (forest) components_acc[node_offset + root] = root;
           }
           
-          item.barrier(s::access::fence_space::local_space);
-          while (fsize_prev[0] > 0) {
-              if (loc_id < fsize_prev[0]) {
-                  nodeid_t node = frontier[loc_id];
-                  for (int i = offsets_acc[node_offset + node]; i < offsets_acc[node_offset + node + 1]; i++) {
-                      nodeid_t neighbor = edges_acc[i];
-                      if (parents_acc[node_offset + neighbor] == -1) {
-                          parents_acc[node_offset + neighbor] = node;
-                          auto pos = fsize_curr_ar.fetch_add(1);
-                          frontier[pos] = neighbor;
-                      }
-                  }
-              }
-              item.barrier(s::access::fence_space::local_space);
-              if (loc_id == 0) {
-                  fsize_prev[0] = fsize_curr[0];
-                  fsize_curr[0] = 0;
-              }
-              item.barrier(s::access::fence_space::local_space);
+          item.barrier(s::access::fence_space::global_and_local);
+          while (true) {
+            while (fsize_prev[0] > 0) {
+                for (size_t j = loc_id; j < fsize_prev[0]; j += local_size) {
+                    nodeid_t node = curr[j];
+                    for (size_t i = offsets_acc[node_offset + node]; i < offsets_acc[node_offset + node + 1]; i++) {
+                        nodeid_t neighbor = edges_acc[i];
+                        if (constrained && !label_matches(label_mask, labels_acc[node_offset + neighbor])) continue;
+                        if (parents_acc[node_offset + neighbor] != -1) continue;
+                        // the work-items expanding two parents of the same node race for it, one of them wins
+                        s::atomic_ref<nodeid_t, s::memory_order::relaxed, s::memory_scope::work_group, s::access::address_space::global_space> parent_ref(parents_acc[node_offset + neighbor]);
+                        nodeid_t expected = -1;
+                        if (parent_ref.compare_exchange_strong(expected, node)) {
+                            if (forest) components_acc[node_offset + neighbor] = root;
+                            next[fsize_curr_ar.fetch_add(1)] = neighbor;
+                        }
+                    }
+                }
+                item.barrier(s::access::fence_space::global_and_local);
+                if (loc_id == 0) {
+                    fsize_prev[0] = fsize_curr[0];
+                    fsize_curr[0] = 0;
+                }
+                item.barrier(s::access::fence_space::local_space);
+                nodeid_t *swap = curr;
+                curr = next;
+                next = swap;
+            }
+            if (!forest) break;
+
+            // seed the next component
+            item.barrier(s::access::fence_space::global_and_local);
+            root = next_unvisited(item, parents_acc, node_offset, node_count, cursor);
+            if (root == -1) break;
+            if (loc_id == 0) {
+              parents_acc[node_offset + root] = root;
+              components_acc[node_offset + root] = root;
+              curr[0] = root;
+              fsize_prev[0] = 1;
+            }
+            item.barrier(s::access::fence_space::global_and_local);
           }
       });
     });
     events.push_back(e);
-    e.wait_and_throw();
+    sources_dev.release_after(e);
+    lists_dev.release_after(e);
   }
 
   /**
    * @brief This method performs the BFS on multiple graphs using a frontier-based approach.
    * 
    * @param queue The SYCL queue to submit the kernel to.
+   * @param pool The memory pool to draw the scratch buffers from.
    * @param data The vectorized graph data.
    * @param sources The vector of source nodes.
    * @param events The vector of events to be updated with the new event.
    * @param wg_size The size of the work-group to be used in the kernel.
    */
-  void operator() (s::queue& queue, SYCL_VectorizedGraphData& data, const std::vector<nodeid_t> &sources, std::vector<s::event>& events, const size_t wg_size = DEFAULT_WORK_GROUP_SIZE) {
+  void operator() (s::queue& queue, MemoryPool& pool, SYCL_VectorizedGraphData& data, const std::vector<nodeid_t> &sources, std::vector<s::event>& events, const size_t wg_size = DEFAULT_WORK_GROUP_SIZE) {
+    if (forest) {
+      throw s::exception(s::make_error_code(s::errc::feature_not_supported), "FrontierMBFSOperator: forest mode requires the compressed representation");
+    }
+    check_unconstrained("FrontierMBFSOperator");
+
     s::range<1> global{DEFAULT_WORK_GROUP_SIZE * (data.data.size())}; // each workgroup will process a graph
     s::range<1> local{DEFAULT_WORK_GROUP_SIZE};
 
-    s::buffer<nodeid_t, 1> sources_buf{sources.data(), s::range<1>{sources.size()}};
+    ScratchBuffer<nodeid_t> sources_dev{pool, sources.size()};
+    auto copy_e = queue.copy(sources.data(), sources_dev.get(), sources.size());
+    const nodeid_t *sources_ptr = sources_dev.get();
 
     auto e = queue.submit([&](s::handler& cgh) {
+      cgh.depends_on(copy_e);
       constexpr size_t ACC_SIZE = 8;
 
       size_t n_nodes [ACC_SIZE];
       s::accessor<size_t, 1, s::access::mode::read> offsets_acc[ACC_SIZE];
       s::accessor<nodeid_t, 1, s::access::mode::read> edges_acc[ACC_SIZE];
       s::accessor<nodeid_t, 1, s::access::mode::read_write> parents_acc[ACC_SIZE];
-      s::accessor<nodeid_t, 1, s::access::mode::read> sources_acc{sources_buf, cgh, s::read_only};
 
       for (int i = 0; i < data.data.size(); i++) {
         offsets_acc[i] = data.offsets[i].get_access<s::access::mode::read>(cgh);
@@ -137,7 +194,7 @@ public:
         auto local_size = item.get_local_range(0);
 
         for (int i = loc_id; i < nodes_count; i += local_size) {
-          if (parents[i] == sources_acc[grp_id]) {
+          if (parents[i] == sources_ptr[grp_id]) {
             frontier[0] = i;
             break;
           }
@@ -170,66 +227,131 @@ public:
       });
     });
     events.push_back(e);
-    e.wait_and_throw();
+    sources_dev.release_after(e);
   } 
 };
 
 /**
  * @brief This class implements the BFS operator that uses a frontier-based approach for a single graph.
  * 
+ * Every level reads the current frontier and appends the newly discovered nodes to the next one.
+ * Appends are aggregated hierarchically: a prefix sum over the sub-group gives each discovered
+ * node its slot, one local atomic per sub-group reserves the slots in a work-group queue in local
+ * memory, and the work-group reserves space in the global frontier with a single atomic when the
+ * local queue is flushed (once per level unless it fills up).
+ * 
  * @tparam sg_size The size of the sub-group to be used in the kernel.
  */
 template <size_t sg_size = 16>
 class FrontierBFSOperator : public SingleBFSOperator {
 public:
+  FrontierBFSOperator(size_t wg_size = DEFAULT_WORK_GROUP_SIZE) : wg_size(wg_size) {}
+
   /**
    * @brief This method performs the BFS on a single graph using a frontier-based approach.
    * 
    * @param queue The SYCL queue to submit the kernel to.
+   * @param pool The memory pool to draw the scratch buffers from.
    * @param data The simple graph data.
    * @param events The vector of events to be updated with the new event.
    */
-  void operator() (sycl::queue& queue, SYCL_SimpleGraphData& data, std::vector<sycl::event>& events) {
-    int* frontier = s::malloc_device<int>(data.num_nodes, queue);
-    int* frontier_size = s::malloc_shared<int>(1, queue);
-    int* old_frontier_size = s::malloc_shared<int>(1, queue);
-    queue.fill(frontier, 0, data.num_nodes).wait(); // init the frontier with the the node 0
-    queue.fill(frontier_size, 0, 1).wait();
-    queue.fill(old_frontier_size, 1, 1).wait();
-
-    int level = 0;
-    while (*old_frontier_size) {
+  void operator() (sycl::queue& queue, MemoryPool& pool, SYCL_SimpleGraphData& data, std::vector<sycl::event>& events) {
+    // the current and the next frontier; every node is discovered once, so each fits num_nodes
+    ScratchBuffer<nodeid_t> frontier_buf{pool, 2 * data.num_nodes};
+    ScratchBuffer<int> size_buf{pool, 1, s::usm::alloc::shared};
+    nodeid_t* frontiers = frontier_buf.get();
+    int* next_size = size_buf.get();
+    nodeid_t source = data.source;
+    queue.copy(&source, frontiers, 1).wait();
+    *next_size = 0;
+
+    const size_t wg_size = this->wg_size;
+    const size_t local_capacity = LOCAL_QUEUE_FACTOR * wg_size;
+    size_t curr_size = 1;
+    int parity = 0;
+    while (curr_size > 0) {
+      nodeid_t* curr = frontiers + parity * data.num_nodes;
+      nodeid_t* next = frontiers + (1 - parity) * data.num_nodes;
+      size_t global_size = ((curr_size + wg_size - 1) / wg_size) * wg_size;
+
       auto e = queue.submit([&](s::handler& h) {
         s::accessor offsets_acc(data.edges_offsets, h, s::read_only);
         s::accessor edges_acc(data.edges, h, s::read_only);
         s::accessor parents_acc(data.parents, h, s::read_write);
+        s::local_accessor<nodeid_t, 1> local_queue{s::range<1>{local_capacity}, h};
+        s::local_accessor<int, 1> local_state{s::range<1>{2}, h}; // [0]: local queue size, [1]: base of the flush in the next frontier
 
-        size_t size = *old_frontier_size;
-        h.parallel_for(s::range<1>{size}, [=](s::id<1> idx) [[intel::reqd_sub_group_size(sg_size)]] {
-          s::atomic_ref<int, s::memory_order::relaxed, s::memory_scope::device> frontier_size_ref(*frontier_size);
-          int node = frontier[idx[0]];
-          
-          for (int i = offsets_acc[node]; i < offsets_acc[node + 1]; i++) {
-            int neighbor = edges_acc[i];
-            if (parents_acc[neighbor] == -1) {
-              int pos = frontier_size_ref.fetch_add(1);
-              parents_acc[neighbor] = node;
-              frontier[pos] = neighbor;
+        size_t size = curr_size;
+        h.parallel_for(s::nd_range<1>{s::range<1>{global_size}, s::range<1>{wg_size}}, [=](s::nd_item<1> item) [[intel::reqd_sub_group_size(sg_size)]] {
+          auto gid = item.get_global_id(0);
+          auto lid = item.get_local_id(0);
+          auto local_range = item.get_local_range(0);
+          auto group = item.get_group();
+          auto sg = item.get_sub_group();
+          s::atomic_ref<int, s::memory_order::relaxed, s::memory_scope::work_group, s::access::address_space::local_space> local_size_ref(local_state[0]);
+          s::atomic_ref<int, s::memory_order::relaxed, s::memory_scope::device> next_size_ref(*next_size);
+
+          // copies the local queue to the next frontier with one global atomic for the whole work-group
+          auto flush = [&](int queued) {
+            item.barrier(s::access::fence_space::local_space);
+            if (lid == 0) local_state[1] = next_size_ref.fetch_add(queued);
+            item.barrier(s::access::fence_space::local_space);
+            int base = local_state[1];
+            for (int i = lid; i < queued; i += local_range) {
+              next[base + i] = local_queue[i];
             }
-          }
+            item.barrier(s::access::fence_space::local_space);
+            if (lid == 0) local_state[0] = 0;
+            item.barrier(s::access::fence_space::local_space);
+          };
+
+          if (lid == 0) local_state[0] = 0;
+          item.barrier(s::access::fence_space::local_space);
 
+          nodeid_t node = gid < size ? curr[gid] : 0;
+          size_t begin = gid < size ? offsets_acc[node] : 0;
+          size_t degree = gid < size ? offsets_acc[node + 1] - begin : 0;
+          size_t rounds = s::reduce_over_group(group, degree, s::maximum<size_t>());
+
+          // each round every work-item checks its next neighbor, so at most local_range nodes are queued per round
+          int queued = 0;
+          for (size_t k = 0; k < rounds; k++) {
+            int found = 0;
+            nodeid_t neighbor = -1;
+            if (k < degree) {
+              neighbor = edges_acc[begin + k];
+              s::atomic_ref<nodeid_t, s::memory_order::relaxed, s::memory_scope::device, s::access::address_space::global_space> parent_ref(parents_acc[neighbor]);
+              nodeid_t expected = -1;
+              found = parents_acc[neighbor] == -1 && parent_ref.compare_exchange_strong(expected, node);
+            }
+
+            int offset = s::exclusive_scan_over_group(sg, found, s::plus<int>());
+            int sg_found = s::reduce_over_group(sg, found, s::plus<int>());
+            int base = 0;
+            if (sg.leader() && sg_found > 0) base = local_size_ref.fetch_add(sg_found);
+            base = s::group_broadcast(sg, base);
+            if (found) local_queue[base + offset] = neighbor;
+
+            queued += s::reduce_over_group(group, found, s::plus<int>());
+            if (queued + local_range > local_capacity) {
+              flush(queued);
+              queued = 0;
+            }
+          }
+          if (queued > 0) flush(queued);
         });
       });
       events.push_back(e);
-      e.wait();
-      *old_frontier_size = *frontier_size;
-      *frontier_size = 0;
+      e.wait_and_throw();
+      curr_size = *next_size;
+      *next_size = 0;
+      parity = 1 - parity;
     }
-
-    s::free(frontier, queue);
-    s::free(frontier_size, queue);
-    s::free(old_frontier_size, queue);
   }
+
+private:
+  static constexpr size_t LOCAL_QUEUE_FACTOR = 4; // local queue capacity, in work-group sizes
+  size_t wg_size;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,210 @@
+/**
+ * @file matrix_op.hpp
+ * @brief Defines the MatrixMBFSOperator class, which runs the BFS of small dense graphs on bit-packed adjacency matrices.
+ */
+
+#ifndef __MATRIX_OP_HPP__
+#define __MATRIX_OP_HPP__
+
+#include <memory>
+#include "impl/mul_bfs.hpp"
+
+namespace s = sycl;
+
+/**
+ * @brief Bottom-up BFS where every level is a product of the frontier bitset with bit matrix tiles.
+ *
+ * Each work-group processes a graph. An unvisited node takes as parent the first node of its row
+ * that is also in the frontier, found with a word-wide AND per tile; the next frontier is OR-ed
+ * into a bitset in local memory. For small dense graphs this reads a few words per node instead
+ * of chasing the CSR neighbors one by one.
+ *
+ * Batches where any graph is too large or too sparse for a bit matrix, the vectorized representation
+ * forest mode and label masks are delegated to the fallback operator, so the engine is picked automatically.
+ *
+ * @tparam sg_size The sub-group size to use in the kernel.
+ */
+template <size_t sg_size = 16>
+class MatrixMBFSOperator : public MultiBFSOperator
+{
+public:
+  // the bit matrix of a graph is no larger than its edge array when edges >= nodes^2 / 32
+  static constexpr size_t DEFAULT_MAX_NODES = 1024;
+  static constexpr float DEFAULT_MIN_DENSITY = 1.0f / 32;
+
+  /**
+   * @param fallback The operator running the batches that do not fit the bit matrices.
+   * @param max_nodes The largest graph run on a bit matrix.
+   * @param min_density The smallest density (edges over nodes^2) run on a bit matrix.
+   */
+  MatrixMBFSOperator(std::shared_ptr<MultiBFSOperator> fallback, size_t max_nodes = DEFAULT_MAX_NODES, float min_density = DEFAULT_MIN_DENSITY) :
+    fallback(fallback), max_nodes(max_nodes), min_density(min_density)
+  {
+    this->forest = fallback->forest_mode();
+  }
+
+  /**
+   * @brief Whether a graph is small and dense enough for the bit matrix engine.
+   */
+  bool fits(size_t num_nodes, size_t num_edges) const {
+    return num_nodes > 0 && num_nodes <= max_nodes && num_edges >= min_density * num_nodes * num_nodes;
+  }
+
+  /**
+   * @brief Whether the last batch ran on the bit matrices.
+   */
+  bool used_matrix() const { return last_used_matrix; }
+
+  void set_label_mask(label_mask_t mask) override {
+    label_mask = mask;
+    fallback->set_label_mask(mask);
+  }
+
+  size_t scratch_bytes(const CSRHostData &g) const override {
+    // whether a batch runs on the bit matrices depends on its other graphs, so the larger engine is counted
+    size_t row_tiles = (g.num_nodes + TILE_SIZE - 1) / TILE_SIZE;
+    size_t matrix = fits(g.num_nodes, g.csr.edges.size()) ? g.num_nodes * row_tiles * sizeof(tile_t) + sizeof(size_t) + sizeof(nodeid_t) : 0;
+    return std::max(matrix, fallback->scratch_bytes(g));
+  }
+
+  /**
+   * @brief This method performs the BFS on multiple graphs with the bit matrix engine, or with the fallback operator.
+   *
+   * @param queue The SYCL queue to submit the kernel to.
+   * @param pool The memory pool to draw the scratch buffers from.
+   * @param data The compressed graph data.
+   * @param sources The vector of source nodes.
+   * @param events The vector of events to be updated with the new event.
+   * @param wg_size The size of the work-group to be used in the kernel.
+   */
+  void operator()(s::queue &queue, MemoryPool &pool, SYCL_CompressedGraphData &data, const std::vector<nodeid_t> &sources, std::vector<s::event> &events, const size_t wg_size = DEFAULT_WORK_GROUP_SIZE)
+  {
+    auto &host = data.host_data;
+    last_used_matrix = !forest && !constrained();
+    for (size_t i = 0; i < host.num_graphs && last_used_matrix; i++) {
+      last_used_matrix = fits(host.nodes_count[i], host.num_edges(i));
+    }
+    if (!last_used_matrix) {
+      (*fallback)(queue, pool, data, sources, events, wg_size);
+      return;
+    }
+
+    // all the matrices packed one after the other
+    std::vector<size_t> tiles_offsets(host.num_graphs + 1, 0);
+    size_t max_row_tiles = 0;
+    for (size_t i = 0; i < host.num_graphs; i++) {
+      size_t row_tiles = (host.nodes_count[i] + TILE_SIZE - 1) / TILE_SIZE;
+      tiles_offsets[i + 1] = tiles_offsets[i] + host.nodes_count[i] * row_tiles;
+      max_row_tiles = std::max(max_row_tiles, row_tiles);
+    }
+    std::vector<tile_t> matrices(tiles_offsets[host.num_graphs], 0);
+    host_parallel_for(host.num_graphs, [&](size_t i) {
+      size_t row_tiles = (host.nodes_count[i] + TILE_SIZE - 1) / TILE_SIZE;
+      fill_bit_matrix(host.nodes_count[i], row_tiles, host.offsets_slice(i).ptr, host.compressed_edges.data(), matrices.data() + tiles_offsets[i]);
+    });
+
+    ScratchBuffer<tile_t> matrices_dev{pool, matrices.size()};
+    ScratchBuffer<size_t> tiles_offsets_dev{pool, tiles_offsets.size()};
+    ScratchBuffer<nodeid_t> sources_dev{pool, sources.size()};
+    // the host copies are local, so the uploads are waited for before returning
+    std::vector<s::event> copies{
+      queue.copy(matrices.data(), matrices_dev.get(), matrices.size()),
+      queue.copy(tiles_offsets.data(), tiles_offsets_dev.get(), tiles_offsets.size()),
+      queue.copy(sources.data(), sources_dev.get(), sources.size())
+    };
+    const tile_t *matrices_ptr = matrices_dev.get();
+    const size_t *tiles_offsets_ptr = tiles_offsets_dev.get();
+    const nodeid_t *sources_ptr = sources_dev.get();
+
+    s::range<1> global{wg_size * host.num_graphs}; // each workgroup will process a graph
+    s::range<1> local{wg_size};
+
+    auto e = queue.submit([&](s::handler &cgh) {
+      cgh.depends_on(copies);
+      s::accessor parents_acc{data.parents, cgh, s::read_write};
+      s::accessor nodes_offsets_acc{data.nodes_offsets, cgh, s::read_only};
+      s::accessor nodes_count_acc{data.nodes_count, cgh, s::read_only};
+
+      s::local_accessor<tile_t, 1> frontier{s::range<1>{max_row_tiles}, cgh};
+      s::local_accessor<tile_t, 1> next{s::range<1>{max_row_tiles}, cgh};
+      s::local_accessor<tile_t, 1> visited{s::range<1>{max_row_tiles}, cgh};
+      s::local_accessor<tile_t, 1> running{s::range<1>{1}, cgh};
+
+      cgh.parallel_for(s::nd_range<1>{global, local}, [=](s::nd_item<1> item) [[intel::reqd_sub_group_size(sg_size)]] {
+        s::atomic_ref<tile_t, s::memory_order::relaxed, s::memory_scope::work_group, s::access::address_space::local_space> running_ar{running[0]};
+        auto grp_id = item.get_group_linear_id();
+        auto loc_id = item.get_local_id(0);
+        auto local_size = item.get_local_range(0);
+        auto node_offset = nodes_offsets_acc[grp_id];
+        auto node_count = nodes_count_acc[grp_id];
+        size_t row_tiles = (node_count + TILE_SIZE - 1) / TILE_SIZE;
+        const tile_t *matrix = matrices_ptr + tiles_offsets_ptr[grp_id];
+        nodeid_t root = sources_ptr[grp_id];
+
+        for (size_t t = loc_id; t < row_tiles; t += local_size) {
+          next[t] = 0;
+          visited[t] = 0;
+        }
+        item.barrier(s::access::fence_space::local_space);
+        if (loc_id == 0) {
+          running_ar.store(1);
+          next[root / TILE_SIZE] = visited[root / TILE_SIZE] = tile_t(1) << (root % TILE_SIZE);
+        }
+        item.barrier(s::access::fence_space::local_space);
+
+        while (running_ar.load()) {
+          for (size_t t = loc_id; t < row_tiles; t += local_size) {
+            frontier[t] = next[t];
+            next[t] = 0;
+          }
+          item.barrier(s::access::fence_space::local_space);
+
+          for (size_t v = loc_id; v < node_count; v += local_size) {
+            tile_t v_bit = tile_t(1) << (v % TILE_SIZE);
+            if (visited[v / TILE_SIZE] & v_bit) continue;
+            const tile_t *row = matrix + v * row_tiles;
+            for (size_t t = 0; t < row_tiles; t++) {
+              tile_t hits = row[t] & frontier[t];
+              if (hits) {
+                parents_acc[node_offset + v] = t * TILE_SIZE + s::ctz(hits);
+                s::atomic_ref<tile_t, s::memory_order::relaxed, s::memory_scope::work_group, s::access::address_space::local_space> next_ar{next[v / TILE_SIZE]};
+                next_ar |= v_bit;
+                break;
+              }
+            }
+          }
+
+          if (loc_id == 0) running_ar.store(0);
+          item.barrier(s::access::fence_space::local_space);
+          for (size_t t = loc_id; t < row_tiles; t += local_size) {
+            visited[t] |= next[t];
+            if (next[t]) running_ar.store(1);
+          }
+          item.barrier(s::access::fence_space::local_space);
+        }
+      });
+    });
+    events.push_back(e);
+    s::event::wait_and_throw(copies);
+    matrices_dev.release_after(e);
+    tiles_offsets_dev.release_after(e);
+    sources_dev.release_after(e);
+  }
+
+  /**
+   * @brief The bit matrix engine works on the compressed representation only, vectorized batches go to the fallback operator.
+   */
+  void operator()(s::queue &queue, MemoryPool &pool, SYCL_VectorizedGraphData &data, const std::vector<nodeid_t> &sources, std::vector<s::event> &events, const size_t wg_size = DEFAULT_WORK_GROUP_SIZE)
+  {
+    last_used_matrix = false;
+    (*fallback)(queue, pool, data, sources, events, wg_size);
+  }
+
+private:
+  std::shared_ptr<MultiBFSOperator> fallback;
+  size_t max_nodes;
+  float min_density;
+  bool last_used_matrix = false;
+};
+
+#endif
@@ -11,15 +11,18 @@
 #include "host_data.hpp"
 #include "kernel_sizes.hpp"
 #include "sycl_data.hpp"
+#include "memory_pool.hpp"
 #include "impl/simpl_bfs.hpp"
 
 namespace s = sycl;
 
 class NaiveBFSOperator : public SingleBFSOperator {
 public:
-  void operator() (sycl::queue& queue, SYCL_SimpleGraphData& data, std::vector<sycl::event>& events) {
-    bool *changed = s::malloc_shared<bool>(1, queue);
-    int *distances = s::malloc_shared<int>(data.num_nodes, queue);
+  void operator() (sycl::queue& queue, MemoryPool& pool, SYCL_SimpleGraphData& data, std::vector<sycl::event>& events) {
+    ScratchBuffer<bool> changed_buf{pool, 1, s::usm::alloc::shared};
+    ScratchBuffer<int> distances_buf{pool, data.num_nodes, s::usm::alloc::shared};
+    bool *changed = changed_buf.get();
+    int *distances = distances_buf.get();
     queue.fill(changed, false, 1).wait();
     queue.fill(distances, -1, data.num_nodes).wait();
     distances[0] = 0;
@@ -50,9 +53,6 @@ public:
       level++;
     } while (*changed);
 
-    s::free(distances, queue);
-    s::free(changed, queue);
-
     std::cout << "[*] Max depth reached: " << level << std::endl;
   }
 };
@@ -0,0 +1,194 @@
+/**
+ * @file spmv_op.hpp
+ * @brief Defines the SpMVMBFSOperator class, which expresses each BFS level as a masked sparse matrix-vector product.
+ */
+
+#ifndef __SPMV_OP_HPP__
+#define __SPMV_OP_HPP__
+
+#include <limits>
+#include "impl/mul_bfs.hpp"
+
+namespace s = sycl;
+
+/**
+ * @brief BFS as sparse matrix-vector products over the Boolean semiring, masked by the complement of the visited set.
+ *
+ * Each work-group processes a graph and every level computes next = A^T f masked by ¬visited, where a
+ * node is visited once it has a parent and the product keeps the first parent found (any-pair semiring).
+ * - push (SpMSpV): the frontier is a sparse list; every frontier node scatters along its CSR row and
+ *   claims its unvisited neighbors with a compare-and-swap;
+ * - pull (masked SpMV): the frontier is dense (the nodes whose level is the current one); every
+ *   unvisited node gathers along its CSC row and stops at the first neighbor in the frontier.
+ * The product switches to pull when the edges leaving the frontier exceed the unvisited edges / ALPHA
+ * and back to push when the frontier falls below the nodes / BETA. The CSC of the batch is built once
+ * from the CSR arena and kept with the device data, see SYCL_CompressedGraphData::ensure_transposed.
+ *
+ * @tparam sg_size The sub-group size to use in the kernel.
+ */
+template <size_t sg_size = 16>
+class SpMVMBFSOperator : public MultiBFSOperator
+{
+public:
+  static constexpr size_t ALPHA = 14;
+  static constexpr size_t BETA = 24;
+
+  /**
+   * @param max_levels The number of levels to expand, the nodes farther from the source keep parent -1.
+   */
+  SpMVMBFSOperator(int max_levels = std::numeric_limits<int>::max()) : max_levels(max_levels) {}
+
+  size_t scratch_bytes(const CSRHostData &g) const override {
+    // the transposed graph kept with the device data, the levels, the two sparse frontiers and the source
+    return (g.num_nodes + 1) * sizeof(size_t) + g.csr.edges.size() * sizeof(nodeid_t) + g.num_nodes * (sizeof(int) + 2 * sizeof(nodeid_t)) + sizeof(nodeid_t);
+  }
+
+  /**
+   * @brief This method performs the BFS on multiple graphs with masked sparse products.
+   *
+   * @param queue The SYCL queue to submit the kernel to.
+   * @param pool The memory pool to draw the scratch buffers from.
+   * @param data The compressed graph data.
+   * @param sources The vector of source nodes.
+   * @param events The vector of events to be updated with the new event.
+   * @param wg_size The size of the work-group to be used in the kernel.
+   */
+  void operator()(s::queue &queue, MemoryPool &pool, SYCL_CompressedGraphData &data, const std::vector<nodeid_t> &sources, std::vector<s::event> &events, const size_t wg_size = DEFAULT_WORK_GROUP_SIZE)
+  {
+    check_unconstrained("SpMVMBFSOperator");
+    auto &host = data.host_data;
+    const size_t total_nodes = host.nodes_offsets[host.num_graphs];
+
+    data.ensure_transposed(queue);
+
+    ScratchBuffer<nodeid_t> sources_dev{pool, sources.size()};
+    ScratchBuffer<int> levels_dev{pool, total_nodes};
+    ScratchBuffer<nodeid_t> lists_dev{pool, 2 * total_nodes}; // current and next sparse frontier of every graph
+    std::vector<s::event> copies{
+      queue.copy(sources.data(), sources_dev.get(), sources.size()),
+      queue.fill(levels_dev.get(), -1, total_nodes)
+    };
+    const nodeid_t *sources_ptr = sources_dev.get();
+    int *levels_ptr = levels_dev.get();
+    nodeid_t *lists_ptr = lists_dev.get();
+    const int max_levels = this->max_levels;
+
+    s::range<1> global{wg_size * host.num_graphs}; // each workgroup will process a graph
+    s::range<1> local{wg_size};
+
+    auto e = queue.submit([&](s::handler &cgh) {
+      cgh.depends_on(copies);
+      s::accessor offsets_acc{data.edges_offsets, cgh, s::read_only};
+      s::accessor edges_acc{data.edges, cgh, s::read_only};
+      s::accessor parents_acc{data.parents, cgh, s::read_write};
+      s::accessor nodes_offsets_acc{data.nodes_offsets, cgh, s::read_only};
+      s::accessor nodes_count_acc{data.nodes_count, cgh, s::read_only};
+      s::accessor csc_offsets_acc{*data.csc_offsets, cgh, s::read_only};
+      s::accessor csc_edges_acc{*data.csc_edges, cgh, s::read_only};
+
+      // [0]: frontier size, [1]: next frontier size, [2]: 1 if push, [3]: level
+      s::local_accessor<int, 1> state{s::range<1>{4}, cgh};
+      // [0]: edges leaving the frontier, [1]: edges leaving the next frontier, [2]: edges leaving the unvisited nodes
+      s::local_accessor<size_t, 1> work{s::range<1>{3}, cgh};
+
+      cgh.parallel_for(s::nd_range<1>{global, local}, [=](s::nd_item<1> item) [[intel::reqd_sub_group_size(sg_size)]] {
+        auto grp_id = item.get_group_linear_id();
+        auto loc_id = item.get_local_id(0);
+        auto local_size = item.get_local_range(0);
+        size_t node_offset = nodes_offsets_acc[grp_id];
+        size_t node_count = nodes_count_acc[grp_id];
+        int *levels = levels_ptr + node_offset;
+        nodeid_t *lists = lists_ptr + 2 * node_offset;
+        s::atomic_ref<int, s::memory_order::relaxed, s::memory_scope::work_group, s::access::address_space::local_space> next_size_ar{state[1]};
+        s::atomic_ref<size_t, s::memory_order::relaxed, s::memory_scope::work_group, s::access::address_space::local_space> next_work_ar{work[1]};
+        auto degree = [&](size_t v) { return offsets_acc[node_offset + v + 1] - offsets_acc[node_offset + v]; };
+
+        if (loc_id == 0) {
+          nodeid_t root = sources_ptr[grp_id];
+          levels[root] = 0;
+          lists[0] = root;
+          state[0] = 1;
+          state[2] = 1;
+          state[3] = 0;
+          work[0] = degree(root);
+          work[2] = offsets_acc[node_offset + node_count] - offsets_acc[node_offset] - work[0];
+        }
+        item.barrier(s::access::fence_space::global_and_local);
+
+        int parity = 0;
+        while (state[0] > 0 && state[3] < max_levels) {
+          int size = state[0], level = state[3];
+          bool push = state[2];
+          nodeid_t *curr = lists + parity * node_count;
+          nodeid_t *next = lists + (1 - parity) * node_count;
+          item.barrier(s::access::fence_space::local_space);
+          if (loc_id == 0) {
+            state[1] = 0;
+            work[1] = 0;
+          }
+          item.barrier(s::access::fence_space::local_space);
+
+          if (push) {
+            // SpMSpV: scatter the sparse frontier along the CSR rows
+            for (int i = loc_id; i < size; i += local_size) {
+              nodeid_t u = curr[i];
+              for (size_t k = offsets_acc[node_offset + u]; k < offsets_acc[node_offset + u + 1]; k++) {
+                nodeid_t v = edges_acc[k];
+                if (levels[v] != -1) continue;
+                s::atomic_ref<nodeid_t, s::memory_order::relaxed, s::memory_scope::work_group, s::access::address_space::global_space> parent_ar{parents_acc[node_offset + v]};
+                nodeid_t expected = -1;
+                if (parent_ar.compare_exchange_strong(expected, u)) {
+                  levels[v] = level + 1;
+                  next[next_size_ar.fetch_add(1)] = v;
+                  next_work_ar += degree(v);
+                }
+              }
+            }
+          } else {
+            // masked SpMV: every unvisited node gathers along its CSC row
+            for (size_t v = loc_id; v < node_count; v += local_size) {
+              if (parents_acc[node_offset + v] != -1) continue;
+              for (size_t k = csc_offsets_acc[node_offset + v]; k < csc_offsets_acc[node_offset + v + 1]; k++) {
+                nodeid_t u = csc_edges_acc[k];
+                if (levels[u] == level) {
+                  parents_acc[node_offset + v] = u;
+                  levels[v] = level + 1;
+                  next[next_size_ar.fetch_add(1)] = v;
+                  next_work_ar += degree(v);
+                  break;
+                }
+              }
+            }
+          }
+          item.barrier(s::access::fence_space::global_and_local);
+
+          if (loc_id == 0) {
+            state[0] = state[1];
+            state[3] = level + 1;
+            work[0] = work[1];
+            work[2] -= work[1];
+            if (push && work[0] > work[2] / ALPHA) state[2] = 0;
+            else if (!push && state[0] < node_count / BETA) state[2] = 1;
+          }
+          parity = 1 - parity;
+          item.barrier(s::access::fence_space::local_space);
+        }
+      });
+    });
+    events.push_back(e);
+    s::event::wait_and_throw(copies);
+    sources_dev.release_after(e);
+    levels_dev.release_after(e);
+    lists_dev.release_after(e);
+  }
+
+  void operator()(s::queue &queue, MemoryPool &pool, SYCL_VectorizedGraphData &data, const std::vector<nodeid_t> &sources, std::vector<s::event> &events, const size_t wg_size = DEFAULT_WORK_GROUP_SIZE)
+  {
+    throw s::exception(s::make_error_code(s::errc::feature_not_supported), "SpMVMBFSOperator: the vectorized representation is not supported");
+  }
+
+private:
+  int max_levels;
+};
+
+#endif
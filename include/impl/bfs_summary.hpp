@@ -0,0 +1,308 @@
+/**
+ * @file bfs_summary.hpp
+ * @brief Summaries of BFS results (reached nodes, depth, level histogram, paths) computed on the device.
+ */
+#ifndef __BFS_SUMMARY_HPP__
+#define __BFS_SUMMARY_HPP__
+
+#include <sycl/sycl.hpp>
+#include <algorithm>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "host_data.hpp"
+#include "sycl_data.hpp"
+#include "memory_pool.hpp"
+#include "kernel_sizes.hpp"
+#include "impl/path_query.hpp"
+
+namespace s = sycl;
+
+typedef struct {
+	bool level_histogram = false;
+	std::vector<std::pair<size_t, nodeid_t>> targets; // (graph, target) pairs whose path from the root is extracted
+	bool download_parents = false;                      // whether the full parents are copied back as well
+} bfs_query_options_t;
+
+typedef struct {
+	size_t reached;                       // nodes with a parent, the root included
+	int max_depth;                        // -1 if no node was reached
+	std::vector<size_t> level_histogram;  // [d]: nodes at depth d, filled if asked for
+} bfs_summary_t;
+
+typedef struct {
+	std::vector<bfs_summary_t> graphs;
+	std::vector<path_result_t> paths;     // one per target, in the order of the options
+} bfs_query_result_t;
+
+/**
+ * @brief Summarizes the parents of a batch on the device and downloads only the summaries.
+ *
+ * One work-group per graph computes the depth of every node by pointer jumping over the parents:
+ * each round every node jumps to the ancestor of its ancestor and adds up the hops, so the depths
+ * take log2(max depth) rounds of O(n) work even on chains. The work-group then reduces the reached
+ * count and the maximum depth. The histogram and the paths are sized from those, so the only
+ * transfers are a few words per graph plus the histograms and paths.
+ *
+ * @param parents The packed parents of the batch, in device memory.
+ * @param nodes_offsets The first node of each graph in parents, num_graphs + 1 entries.
+ * @param deps The events the parents depend on.
+ */
+void summarize_parents(
+	s::queue &queue,
+	MemoryPool &pool,
+	const nodeid_t *parents,
+	const std::vector<size_t> &nodes_offsets,
+	const std::vector<s::event> &deps,
+	const bfs_query_options_t &options,
+	bfs_query_result_t &result,
+	const size_t wg_size = DEFAULT_WORK_GROUP_SIZE)
+{
+	const size_t num_graphs = nodes_offsets.size() - 1;
+	const size_t total_nodes = nodes_offsets[num_graphs];
+	const size_t num_targets = options.targets.size();
+
+	// [2i]: first node of the graph of target i, [2i + 1]: target i
+	std::vector<size_t> targets(2 * num_targets);
+	for (size_t i = 0; i < num_targets; i++) {
+		auto [g, t] = options.targets[i];
+		if (g >= num_graphs || t < 0 || t >= nodes_offsets[g + 1] - nodes_offsets[g]) {
+			throw s::exception(s::make_error_code(s::errc::invalid), "summarize_parents: target out of range");
+		}
+		targets[2 * i] = nodes_offsets[g];
+		targets[2 * i + 1] = t;
+	}
+
+	ScratchBuffer<size_t> offsets_dev{pool, nodes_offsets.size()};
+	ScratchBuffer<int> depths_dev{pool, std::max<size_t>(1, total_nodes)};
+	// the other half of the double-buffered hop counts and ancestors of the pointer jumping
+	ScratchBuffer<int> hops_dev{pool, std::max<size_t>(1, total_nodes)};
+	ScratchBuffer<nodeid_t> ancestors_dev{pool, std::max<size_t>(1, total_nodes)}, next_ancestors_dev{pool, std::max<size_t>(1, total_nodes)};
+	ScratchBuffer<size_t> reached_dev{pool, num_graphs};
+	ScratchBuffer<int> max_depth_dev{pool, num_graphs};
+	ScratchBuffer<size_t> targets_dev{pool, std::max<size_t>(1, targets.size())};
+	ScratchBuffer<int> target_depths_dev{pool, std::max<size_t>(1, num_targets)};
+	std::vector<s::event> copies{
+		queue.copy(nodes_offsets.data(), offsets_dev.get(), nodes_offsets.size()),
+		queue.copy(targets.data(), targets_dev.get(), targets.size())
+	};
+	const size_t *offsets_ptr = offsets_dev.get();
+	int *depths_ptr = depths_dev.get();
+	int *hops_ptr = hops_dev.get();
+	nodeid_t *ancestors_ptr = ancestors_dev.get();
+	nodeid_t *next_ancestors_ptr = next_ancestors_dev.get();
+	size_t *reached_ptr = reached_dev.get();
+	int *max_depth_ptr = max_depth_dev.get();
+	const size_t *targets_ptr = targets_dev.get();
+	int *target_depths_ptr = target_depths_dev.get();
+
+	auto depths_e = queue.submit([&](s::handler &cgh) {
+		cgh.depends_on(deps);
+		cgh.depends_on(copies);
+		cgh.parallel_for(s::nd_range<1>{s::range<1>{num_graphs * wg_size}, s::range<1>{wg_size}}, [=](s::nd_item<1> item) {
+			auto grp_id = item.get_group_linear_id();
+			auto loc_id = item.get_local_id(0);
+			auto local_size = item.get_local_range(0);
+			size_t base = offsets_ptr[grp_id];
+			size_t node_count = offsets_ptr[grp_id + 1] - base;
+			const nodeid_t *parent = parents + base;
+
+			// hops[v] is the distance from v to ancestor[v], which starts as its parent
+			int *hops = depths_ptr + base, *next_hops = hops_ptr + base;
+			nodeid_t *ancestor = ancestors_ptr + base, *next_ancestor = next_ancestors_ptr + base;
+			for (size_t v = loc_id; v < node_count; v += local_size) {
+				nodeid_t p = parent[v];
+				ancestor[v] = p;
+				hops[v] = p == -1 ? -1 : p == static_cast<nodeid_t>(v) ? 0 : 1;
+			}
+			item.barrier(s::access::fence_space::global_space);
+
+			// a chain of n nodes takes log2(n) rounds, the bound only stops parent cycles
+			bool jumping = true;
+			for (int round = 0; jumping && round < 64; round++) {
+				bool moved = false;
+				for (size_t v = loc_id; v < node_count; v += local_size) {
+					nodeid_t a = ancestor[v];
+					if (a != -1 && parent[a] != a) {
+						next_hops[v] = hops[v] + hops[a];
+						next_ancestor[v] = ancestor[a];
+						moved = true;
+					} else {
+						next_hops[v] = hops[v];
+						next_ancestor[v] = a;
+					}
+				}
+				item.barrier(s::access::fence_space::global_space);
+				std::swap(hops, next_hops);
+				std::swap(ancestor, next_ancestor);
+				jumping = s::any_of_group(item.get_group(), moved);
+			}
+
+			size_t reached = 0;
+			int max_depth = -1;
+			for (size_t v = loc_id; v < node_count; v += local_size) {
+				int depth = hops[v];
+				// every work-item reads back only the nodes it wrote
+				if (hops != depths_ptr + base) depths_ptr[base + v] = depth;
+				if (depth >= 0) reached++;
+				max_depth = s::max(max_depth, depth);
+			}
+			reached = s::reduce_over_group(item.get_group(), reached, s::plus<size_t>());
+			max_depth = s::reduce_over_group(item.get_group(), max_depth, s::maximum<int>());
+			if (loc_id == 0) {
+				reached_ptr[grp_id] = reached;
+				max_depth_ptr[grp_id] = max_depth;
+			}
+		});
+	});
+	auto gather_e = queue.submit([&](s::handler &cgh) {
+		cgh.depends_on(depths_e);
+		cgh.parallel_for(s::range<1>{num_targets}, [=](s::id<1> i) {
+			target_depths_ptr[i] = depths_ptr[targets_ptr[2 * i] + targets_ptr[2 * i + 1]];
+		});
+	});
+
+	std::vector<size_t> reached(num_graphs);
+	std::vector<int> max_depth(num_graphs), target_depths(num_targets);
+	s::event::wait_and_throw({
+		queue.copy(reached_ptr, reached.data(), num_graphs, depths_e),
+		queue.copy(max_depth_ptr, max_depth.data(), num_graphs, depths_e),
+		queue.copy(target_depths_ptr, target_depths.data(), num_targets, gather_e)
+	});
+
+	// the histograms and the paths are packed one after the other, sized by the depths
+	std::vector<size_t> hist_offsets(num_graphs + 1, 0), path_offsets(num_targets + 1, 0);
+	for (size_t g = 0; g < num_graphs; g++) {
+		hist_offsets[g + 1] = hist_offsets[g] + (options.level_histogram ? max_depth[g] + 1 : 0);
+	}
+	for (size_t i = 0; i < num_targets; i++) {
+		path_offsets[i + 1] = path_offsets[i] + target_depths[i] + 1;
+	}
+
+	ScratchBuffer<size_t> hist_offsets_dev{pool, hist_offsets.size()};
+	ScratchBuffer<size_t> hist_dev{pool, std::max<size_t>(1, hist_offsets[num_graphs])};
+	ScratchBuffer<size_t> path_offsets_dev{pool, path_offsets.size()};
+	ScratchBuffer<nodeid_t> paths_dev{pool, std::max<size_t>(1, path_offsets[num_targets])};
+	std::vector<s::event> uploads{
+		queue.copy(hist_offsets.data(), hist_offsets_dev.get(), hist_offsets.size()),
+		queue.fill(hist_dev.get(), size_t(0), hist_dev.size()),
+		queue.copy(path_offsets.data(), path_offsets_dev.get(), path_offsets.size())
+	};
+	const size_t *hist_offsets_ptr = hist_offsets_dev.get();
+	size_t *hist_ptr = hist_dev.get();
+	const size_t *path_offsets_ptr = path_offsets_dev.get();
+	nodeid_t *paths_ptr = paths_dev.get();
+
+	std::vector<s::event> downloads;
+	std::vector<size_t> hist(hist_offsets[num_graphs]);
+	std::vector<nodeid_t> paths(path_offsets[num_targets]);
+	if (options.level_histogram && total_nodes > 0) {
+		auto hist_e = queue.submit([&](s::handler &cgh) {
+			cgh.depends_on(uploads);
+			cgh.parallel_for(s::nd_range<1>{s::range<1>{num_graphs * wg_size}, s::range<1>{wg_size}}, [=](s::nd_item<1> item) {
+				auto grp_id = item.get_group_linear_id();
+				size_t base = offsets_ptr[grp_id];
+				size_t node_count = offsets_ptr[grp_id + 1] - base;
+				for (size_t v = item.get_local_id(0); v < node_count; v += item.get_local_range(0)) {
+					int depth = depths_ptr[base + v];
+					if (depth < 0) continue;
+					s::atomic_ref<size_t, s::memory_order::relaxed, s::memory_scope::device, s::access::address_space::global_space> bin{hist_ptr[hist_offsets_ptr[grp_id] + depth]};
+					bin++;
+				}
+			});
+		});
+		downloads.push_back(queue.copy(hist_ptr, hist.data(), hist.size(), hist_e));
+	}
+	if (!paths.empty()) {
+		auto paths_e = queue.submit([&](s::handler &cgh) {
+			cgh.depends_on(uploads);
+			cgh.depends_on(gather_e);
+			cgh.parallel_for(s::range<1>{num_targets}, [=](s::id<1> i) {
+				size_t first = path_offsets_ptr[i], last = path_offsets_ptr[i + 1];
+				size_t base = targets_ptr[2 * i];
+				nodeid_t u = targets_ptr[2 * i + 1];
+				// walk up from the target, filling the path backwards; an unreached target has an empty slot
+				for (size_t k = last; k > first; k--) {
+					paths_ptr[k - 1] = u;
+					u = parents[base + u];
+				}
+			});
+		});
+		downloads.push_back(queue.copy(paths_ptr, paths.data(), paths.size(), paths_e));
+	}
+	s::event::wait_and_throw(downloads);
+
+	result.graphs.resize(num_graphs);
+	for (size_t g = 0; g < num_graphs; g++) {
+		result.graphs[g].reached = reached[g];
+		result.graphs[g].max_depth = max_depth[g];
+		result.graphs[g].level_histogram.assign(hist.begin() + hist_offsets[g], hist.begin() + hist_offsets[g + 1]);
+	}
+	result.paths.resize(num_targets);
+	for (size_t i = 0; i < num_targets; i++) {
+		result.paths[i].distance = target_depths[i];
+		result.paths[i].path.assign(paths.begin() + path_offsets[i], paths.begin() + path_offsets[i + 1]);
+	}
+}
+
+/**
+ * @brief Summarizes the parents of a compressed batch, after the events of its traversal.
+ */
+void summarize_parents(s::queue &queue, MemoryPool &pool, SYCL_CompressedGraphData &data, const std::vector<s::event> &deps, const bfs_query_options_t &options, bfs_query_result_t &result, const size_t wg_size = DEFAULT_WORK_GROUP_SIZE)
+{
+	size_t total_nodes = data.host_data.compressed_parents.size();
+	ScratchBuffer<nodeid_t> parents_dev{pool, std::max<size_t>(1, total_nodes)};
+	nodeid_t *parents_ptr = parents_dev.get();
+	auto e = queue.submit([&](s::handler &cgh) {
+		cgh.depends_on(deps);
+		s::accessor parents_acc{data.parents, cgh, s::read_only};
+		cgh.copy(parents_acc, parents_ptr);
+	});
+	summarize_parents(queue, pool, parents_ptr, data.host_data.nodes_offsets, {e}, options, result, wg_size);
+}
+
+/**
+ * @brief Summarizes the parents of a vectorized batch, packed on the device first.
+ */
+void summarize_parents(s::queue &queue, MemoryPool &pool, SYCL_VectorizedGraphData &data, const std::vector<s::event> &deps, const bfs_query_options_t &options, bfs_query_result_t &result, const size_t wg_size = DEFAULT_WORK_GROUP_SIZE)
+{
+	std::vector<size_t> nodes_offsets(data.data.size() + 1, 0);
+	for (size_t i = 0; i < data.data.size(); i++) nodes_offsets[i + 1] = nodes_offsets[i] + data.data[i].num_nodes;
+	ScratchBuffer<nodeid_t> parents_dev{pool, std::max<size_t>(1, nodes_offsets.back())};
+	std::vector<s::event> packed;
+	for (size_t i = 0; i < data.data.size(); i++) {
+		nodeid_t *dst = parents_dev.get() + nodes_offsets[i];
+		packed.push_back(queue.submit([&](s::handler &cgh) {
+			cgh.depends_on(deps);
+			s::accessor parents_acc{data.parents[i], cgh, s::read_only};
+			cgh.copy(parents_acc, dst);
+		}));
+	}
+	summarize_parents(queue, pool, parents_dev.get(), nodes_offsets, packed, options, result, wg_size);
+}
+
+/**
+ * @brief Prints the summaries of a query run, one line per graph and per target.
+ */
+void write_summaries(std::ostream &out, const bfs_query_options_t &options, const bfs_query_result_t &result) {
+	std::string buffer;
+	for (size_t g = 0; g < result.graphs.size(); g++) {
+		auto &sum = result.graphs[g];
+		buffer += "- Graph " + std::to_string(g) + " | Reached: " + std::to_string(sum.reached) + " | Max depth: " + std::to_string(sum.max_depth);
+		if (options.level_histogram) {
+			buffer += " | Levels:";
+			for (auto c : sum.level_histogram) buffer += " " + std::to_string(c);
+		}
+		buffer += '\n';
+	}
+	for (size_t i = 0; i < result.paths.size(); i++) {
+		buffer += "- Path " + std::to_string(options.targets[i].first) + ":" + std::to_string(options.targets[i].second) + " | Distance: " + std::to_string(result.paths[i].distance) + " |";
+		for (auto v : result.paths[i].path) buffer += " " + std::to_string(v);
+		buffer += '\n';
+	}
+	out.write(buffer.data(), buffer.size());
+	out.flush();
+}
+
+#endif
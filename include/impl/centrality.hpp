@@ -0,0 +1,214 @@
+/**
+ * @file centrality.hpp
+ * @brief Betweenness and closeness centrality of every node of a batch of graphs, with many BFS sources per launch.
+ */
+#ifndef __CENTRALITY_HPP__
+#define __CENTRALITY_HPP__
+
+#include <sycl/sycl.hpp>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include "types.hpp"
+#include "kernel_sizes.hpp"
+#include "host_data.hpp"
+#include "sycl_data.hpp"
+#include "memory_pool.hpp"
+#include "benchmark.hpp"
+
+namespace s = sycl;
+
+typedef struct {
+	std::vector<float> betweenness; // per node, summed over ordered pairs: halve it on undirected graphs
+	std::vector<float> closeness;   // per node, reached nodes over the sum of their distances, 0 if none is reached
+} centrality_t;
+
+/**
+ * @brief Computes the centralities of every graph of a batch with Brandes' algorithm on the device.
+ *
+ * A launch runs sources_per_launch sources of every graph at once, one work-group per (graph,
+ * source) pair, so a batch takes ceil(max nodes / sources_per_launch) launches instead of one BFS
+ * per node. Each work-group records the level and the number of shortest paths (sigma) of every
+ * node while it traverses its graph level by level, then accumulates the dependencies backwards
+ * from the deepest level and adds them to the betweenness of the graph. The levels also give the
+ * closeness of the source. Edges are followed as stored, so directed graphs are supported.
+ */
+class CentralityEngine
+{
+public:
+	static constexpr size_t DEFAULT_SOURCES_PER_LAUNCH = 32;
+
+	CentralityEngine(std::vector<CSRHostData> &data) :
+		data(data),
+		queue(s::gpu_selector_v, s::property_list{s::property::queue::enable_profiling{}}),
+		pool(queue) {}
+
+	CentralityEngine(std::vector<CSRHostData> &data, const s::device &device) :
+		data(data),
+		queue(device, s::property_list{s::property::queue::enable_profiling{}}),
+		pool(queue) {}
+
+	/**
+	 * @brief Computes the centralities of every graph of the batch
+	 * @param results Filled with the centralities of each graph
+	 * @param sources_per_launch The sources of each graph traversed by a launch, the scratch memory grows with it
+	 * @param wg_size The size of the work-groups
+	 * @return The summed time of the launches and the wall time, uploads and downloads included
+	 */
+	bench_time_t run(std::vector<centrality_t> &results, size_t sources_per_launch = DEFAULT_SOURCES_PER_LAUNCH, size_t wg_size = DEFAULT_WORK_GROUP_SIZE)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		CompressedHostData host_data(data);
+		SYCL_CompressedGraphData device_data(host_data);
+		const size_t num_graphs = host_data.num_graphs;
+		const size_t total_nodes = host_data.nodes_offsets[num_graphs];
+		const size_t max_nodes = num_graphs > 0 ? *std::max_element(host_data.nodes_count.begin(), host_data.nodes_count.end()) : 0;
+		const size_t K = std::max<size_t>(1, std::min(sources_per_launch, max_nodes));
+
+		ScratchBuffer<int> levels{pool, std::max<size_t>(1, total_nodes * K)};
+		ScratchBuffer<float> sigmas{pool, std::max<size_t>(1, total_nodes * K)};
+		ScratchBuffer<float> deltas{pool, std::max<size_t>(1, total_nodes * K)};
+		ScratchBuffer<float> betweenness{pool, std::max<size_t>(1, total_nodes)};
+		ScratchBuffer<float> closeness{pool, std::max<size_t>(1, total_nodes)};
+
+		std::vector<s::event> events;
+		s::event last = queue.fill(betweenness.get(), 0.0f, total_nodes);
+		for (size_t first = 0; first < max_nodes; first += K) {
+			// the scratch arrays are reused by every launch, so the launches run one after the other
+			last = launch(device_data, first, K, levels.get(), sigmas.get(), deltas.get(), betweenness.get(), closeness.get(), last, wg_size);
+			events.push_back(last);
+		}
+
+		std::vector<float> bc(total_nodes), cl(total_nodes);
+		s::event::wait_and_throw({
+			queue.copy(betweenness.get(), bc.data(), total_nodes, last),
+			queue.copy(closeness.get(), cl.data(), total_nodes, last)
+		});
+		results.resize(num_graphs);
+		for (size_t i = 0; i < num_graphs; i++) {
+			results[i].betweenness.assign(bc.begin() + host_data.nodes_offsets[i], bc.begin() + host_data.nodes_offsets[i + 1]);
+			results[i].closeness.assign(cl.begin() + host_data.nodes_offsets[i], cl.begin() + host_data.nodes_offsets[i + 1]);
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+
+		long duration = 0;
+		for (s::event &e : events) {
+			duration += e.get_profiling_info<s::info::event_profiling::command_end>() - e.get_profiling_info<s::info::event_profiling::command_start>();
+		}
+		return bench_time_t{
+			.kernel_time = static_cast<float>(duration) / 1000,
+			.total_time = static_cast<float>(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()),
+			.to_microsec = 1.0f
+		};
+	}
+
+private:
+	std::vector<CSRHostData> &data;
+	s::queue queue;
+	MemoryPool pool;
+
+	/**
+	 * @brief Traverses sources first ... first + K - 1 of every graph, one work-group each.
+	 *
+	 * The scratch arrays hold K slices of total_nodes entries laid out as the arena: the slice of
+	 * source first + k of graph i starts at K * nodes_offsets[i] + k * nodes_count[i].
+	 */
+	s::event launch(SYCL_CompressedGraphData &data, size_t first, size_t K, int *levels, float *sigmas, float *deltas, float *betweenness, float *closeness, s::event dep, size_t wg_size)
+	{
+		s::range<1> global{wg_size * data.host_data.num_graphs * K};
+		s::range<1> local{wg_size};
+
+		return queue.submit([&](s::handler &cgh) {
+			cgh.depends_on(dep);
+			s::accessor offsets_acc{data.edges_offsets, cgh, s::read_only};
+			s::accessor edges_acc{data.edges, cgh, s::read_only};
+			s::accessor nodes_offsets_acc{data.nodes_offsets, cgh, s::read_only};
+			s::accessor nodes_count_acc{data.nodes_count, cgh, s::read_only};
+
+			cgh.parallel_for(s::nd_range<1>{global, local}, [=](s::nd_item<1> item) {
+				auto group = item.get_group();
+				auto grp_id = item.get_group_linear_id();
+				auto loc_id = item.get_local_id(0);
+				auto local_size = item.get_local_range(0);
+				size_t graph = grp_id / K;
+				size_t slot = grp_id % K;
+				size_t node_offset = nodes_offsets_acc[graph];
+				size_t node_count = nodes_count_acc[graph];
+				size_t source = first + slot;
+				if (source >= node_count) return; // the whole work-group leaves
+
+				size_t base = K * node_offset + slot * node_count;
+				int *level = levels + base;
+				float *sigma = sigmas + base;
+				float *delta = deltas + base;
+
+				for (size_t v = loc_id; v < node_count; v += local_size) {
+					level[v] = v == source ? 0 : -1;
+					sigma[v] = v == source ? 1.0f : 0.0f;
+					delta[v] = 0.0f;
+				}
+				item.barrier(s::access::fence_space::global_and_local);
+
+				// forward: the levels of depth + 1 are set first, so the path counts are pushed only along shortest paths
+				int depth = 0;
+				while (true) {
+					bool grew = false;
+					for (size_t v = loc_id; v < node_count; v += local_size) {
+						if (level[v] != depth) continue;
+						for (size_t i = offsets_acc[node_offset + v]; i < offsets_acc[node_offset + v + 1]; i++) {
+							nodeid_t w = edges_acc[i];
+							if (level[w] == -1) {
+								level[w] = depth + 1;
+								grew = true;
+							}
+						}
+					}
+					item.barrier(s::access::fence_space::global_and_local);
+					for (size_t v = loc_id; v < node_count; v += local_size) {
+						if (level[v] != depth) continue;
+						for (size_t i = offsets_acc[node_offset + v]; i < offsets_acc[node_offset + v + 1]; i++) {
+							nodeid_t w = edges_acc[i];
+							if (level[w] == depth + 1) {
+								s::atomic_ref<float, s::memory_order::relaxed, s::memory_scope::work_group, s::access::address_space::global_space> sigma_ref(sigma[w]);
+								sigma_ref += sigma[v];
+							}
+						}
+					}
+					item.barrier(s::access::fence_space::global_and_local);
+					if (!s::any_of_group(group, grew)) break;
+					depth++;
+				}
+
+				// backward: the nodes of the deepest level have no dependency
+				for (int d = depth - 1; d >= 0; d--) {
+					for (size_t v = loc_id; v < node_count; v += local_size) {
+						if (level[v] != d) continue;
+						float dv = 0.0f;
+						for (size_t i = offsets_acc[node_offset + v]; i < offsets_acc[node_offset + v + 1]; i++) {
+							nodeid_t w = edges_acc[i];
+							if (level[w] == d + 1) dv += sigma[v] / sigma[w] * (1.0f + delta[w]);
+						}
+						delta[v] = dv;
+					}
+					item.barrier(s::access::fence_space::global_and_local);
+				}
+
+				float distance = 0.0f;
+				float reached = 0.0f;
+				for (size_t v = loc_id; v < node_count; v += local_size) {
+					if (v == source || level[v] < 0) continue;
+					s::atomic_ref<float, s::memory_order::relaxed, s::memory_scope::device, s::access::address_space::global_space> bc_ref(betweenness[node_offset + v]);
+					bc_ref += delta[v];
+					distance += level[v];
+					reached += 1.0f;
+				}
+				distance = s::reduce_over_group(group, distance, s::plus<float>());
+				reached = s::reduce_over_group(group, reached, s::plus<float>());
+				if (loc_id == 0) closeness[node_offset + source] = distance > 0.0f ? reached / distance : 0.0f;
+			});
+		});
+	}
+};
+
+#endif
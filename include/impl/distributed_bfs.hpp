@@ -0,0 +1,389 @@
+/**
+ * @file distributed_bfs.hpp
+ * @brief Distributed-memory, level-synchronous BFS with a 1D vertex partitioning over MPI ranks.
+ */
+#ifndef __DISTRIBUTED_BFS_HPP__
+#define __DISTRIBUTED_BFS_HPP__
+
+#include <mpi.h>
+#include <sycl/sycl.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "host_data.hpp"
+#include "memory_pool.hpp"
+#include "types.hpp"
+
+namespace s = sycl;
+
+typedef uint32_t dmask_t;
+constexpr size_t DMASK_SIZE = 32;
+
+/**
+ * @brief The rows of a graph owned by one rank.
+ *
+ * The rank owns the vertices [first_node, first_node + num_nodes). The CSR holds only their
+ * rows, the edges keep the global vertex ids.
+ */
+typedef struct
+{
+	size_t global_nodes;
+	nodeid_t first_node;
+	size_t num_nodes;
+	CSR csr;
+	std::vector<nodeid_t> parents;
+} DistributedCSRHostData;
+
+/**
+ * @brief Block partitioning of the vertices over the ranks.
+ */
+typedef struct
+{
+	size_t global_nodes;
+	int num_ranks;
+
+	size_t chunk() const { return std::max<size_t>(1, (global_nodes + num_ranks - 1) / num_ranks); }
+	int owner(nodeid_t v) const { return v / chunk(); }
+	nodeid_t first(int rank) const { return std::min(global_nodes, rank * chunk()); }
+	size_t count(int rank) const { return first(rank + 1) - first(rank); }
+} vertex_partition_t;
+
+/**
+ * @brief Reads the rows owned by the calling rank from a graph file.
+ *
+ * Each rank parses only its share of the edge lines (the file is cut in byte ranges at line
+ * boundaries), then the edges are sent to the rank owning their source with an all-to-all.
+ * @throws std::runtime_error if the file cannot be read or does not hold the edges of its header
+ */
+DistributedCSRHostData readGraphRangeFromFile(std::string filename, MPI_Comm comm = MPI_COMM_WORLD) {
+	int rank, num_ranks;
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &num_ranks);
+
+	size_t num_nodes, num_edges;
+	std::ifstream file(filename);
+	if (!(file >> num_nodes >> num_edges)) {
+		throw std::runtime_error("readGraphRangeFromFile: cannot read the header of " + filename);
+	}
+	std::string line;
+	std::getline(file, line);
+	const size_t body = file.tellg();
+	file.seekg(0, std::ios::end);
+	const size_t size = file.tellg();
+
+	// a line belongs to the rank whose byte range holds its first character
+	const size_t chunk = (size - body + num_ranks - 1) / num_ranks;
+	const size_t begin = std::min(size, body + rank * chunk), end = std::min(size, begin + chunk);
+	file.seekg(begin == body ? begin : begin - 1);
+	if (begin != body) std::getline(file, line); // the tail of the line of the previous rank
+
+	vertex_partition_t part{num_nodes, num_ranks};
+	std::vector<std::vector<nodeid_t>> buckets(num_ranks);
+	unsigned long long parsed = 0, total_parsed;
+	while (begin < end && file && static_cast<size_t>(file.tellg()) < end && std::getline(file, line)) {
+		std::istringstream fields(line);
+		long long src, dst;
+		if (!(fields >> src >> dst)) continue;
+		if (src < 0 || dst < 0 || src >= (long long)num_nodes || dst >= (long long)num_nodes) {
+			throw std::runtime_error("readGraphRangeFromFile: edge " + std::to_string(src) + " " + std::to_string(dst) + " out of the header bounds");
+		}
+		buckets[part.owner(src)].push_back(src);
+		buckets[part.owner(src)].push_back(dst);
+		parsed++;
+	}
+	file.close();
+	MPI_Allreduce(&parsed, &total_parsed, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+	if (total_parsed != num_edges) {
+		throw std::runtime_error("readGraphRangeFromFile: expected " + std::to_string(num_edges) + " edges, read " + std::to_string(total_parsed));
+	}
+
+	std::vector<nodeid_t> send, owned;
+	std::vector<int> send_counts(num_ranks), send_displs(num_ranks), recv_counts(num_ranks), recv_displs(num_ranks);
+	for (int r = 0; r < num_ranks; r++) {
+		send_displs[r] = send.size();
+		send_counts[r] = buckets[r].size();
+		send.insert(send.end(), buckets[r].begin(), buckets[r].end());
+	}
+	MPI_Alltoall(send_counts.data(), 1, MPI_INT, recv_counts.data(), 1, MPI_INT, comm);
+	int total = 0;
+	for (int r = 0; r < num_ranks; r++) {
+		recv_displs[r] = total;
+		total += recv_counts[r];
+	}
+	owned.resize(total);
+	MPI_Alltoallv(send.data(), send_counts.data(), send_displs.data(), MPI_INT,
+	              owned.data(), recv_counts.data(), recv_displs.data(), MPI_INT, comm);
+
+	DistributedCSRHostData ret;
+	ret.global_nodes = num_nodes;
+	ret.first_node = part.first(rank);
+	ret.num_nodes = part.count(rank);
+
+	ret.csr.offsets = std::vector<size_t>(ret.num_nodes + 1, 0);
+	for (size_t i = 0; i < owned.size(); i += 2) ret.csr.offsets[owned[i] - ret.first_node + 1]++;
+	for (size_t i = 1; i < ret.csr.offsets.size(); i++) ret.csr.offsets[i] += ret.csr.offsets[i - 1];
+
+	ret.csr.edges = std::vector<nodeid_t>(owned.size() / 2);
+	std::vector<size_t> fill(ret.csr.offsets.begin(), ret.csr.offsets.end() - 1);
+	for (size_t i = 0; i < owned.size(); i += 2) ret.csr.edges[fill[owned[i] - ret.first_node]++] = owned[i + 1];
+
+	ret.parents = std::vector<nodeid_t>(ret.num_nodes, -1);
+	return ret;
+}
+
+typedef struct {
+	int level;
+	size_t frontier_size;  // global number of vertices expanded in the level
+	bool dense;            // whether this rank sent bitmaps rather than (vertex, parent) pairs
+	double compute_time;   // expansion kernel + update of the owned vertices, in us
+	double comm_time;      // all-to-all exchange of the discovered vertices, in us
+	size_t bytes_sent;
+} level_report_t;
+
+/**
+ * @brief Level-synchronous BFS on a graph distributed by vertex ranges.
+ *
+ * Each level every rank expands its part of the frontier on its device: the neighbors are
+ * de-duplicated through a global bitmap and collected as (vertex, parent) candidates. The bitmap is
+ * kept across the levels, since a vertex sent once is visited by its owner by the next level, so a
+ * remote vertex is sent at most once per rank. The candidates
+ * are then sent to the owner of each vertex with an all-to-all: a destination gets either the
+ * pairs (sparse) or a bitmap of its range followed by the parents of the set bits (dense), whichever
+ * is smaller. The owners keep the first parent of every new vertex, which forms the next frontier.
+ */
+class DistributedBFS {
+public:
+	DistributedBFS(DistributedCSRHostData &data, MPI_Comm comm = MPI_COMM_WORLD) :
+		data(data), comm(comm),
+		queue(s::default_selector_v, s::property_list{s::property::queue::enable_profiling{}}),
+		pool(queue)
+	{
+		MPI_Comm_rank(comm, &rank);
+		MPI_Comm_size(comm, &num_ranks);
+		part = vertex_partition_t{data.global_nodes, num_ranks};
+	}
+
+	MemoryPool &get_pool() { return pool; }
+
+	/**
+	 * @brief Runs the BFS from the given global source. The parents of the owned vertices are written in data.parents.
+	 * @return The per-level report of this rank.
+	 * @throws std::out_of_range if the source is not a vertex of the graph, on every rank alike
+	 */
+	std::vector<level_report_t> run(nodeid_t source) {
+		if (source < 0 || (size_t)source >= data.global_nodes) {
+			throw std::out_of_range("DistributedBFS: source " + std::to_string(source) + " out of [0, " + std::to_string(data.global_nodes) + ")");
+		}
+		const size_t n_local = data.num_nodes;
+		const size_t num_words = data.global_nodes / DMASK_SIZE + 1;
+		const size_t num_local_edges = data.csr.edges.size();
+
+		ScratchBuffer<size_t> offsets{pool, n_local + 1};
+		ScratchBuffer<nodeid_t> edges{pool, std::max<size_t>(1, num_local_edges)};
+		ScratchBuffer<int> visited{pool, std::max<size_t>(1, n_local)};
+		ScratchBuffer<nodeid_t> frontier{pool, std::max<size_t>(1, n_local)};
+		ScratchBuffer<dmask_t> seen{pool, num_words};
+		ScratchBuffer<nodeid_t> candidates{pool, 2 * std::max<size_t>(1, num_local_edges)};
+		ScratchBuffer<unsigned> num_candidates{pool, 1, s::usm::alloc::shared};
+
+		queue.copy(data.csr.offsets.data(), offsets.get(), n_local + 1);
+		if (num_local_edges) queue.copy(data.csr.edges.data(), edges.get(), num_local_edges);
+		queue.fill(visited.get(), 0, std::max<size_t>(1, n_local));
+		queue.memset(seen.get(), 0, num_words * sizeof(dmask_t));
+		queue.wait_and_throw();
+
+		std::fill(data.parents.begin(), data.parents.end(), -1);
+		std::vector<nodeid_t> next;
+		if (part.owner(source) == rank) {
+			data.parents[source - data.first_node] = source;
+			next.push_back(source);
+			queue.fill(visited.get() + (source - data.first_node), 1, 1);
+			queue.copy(next.data(), frontier.get(), 1);
+			queue.wait_and_throw();
+		}
+
+		std::vector<level_report_t> reports;
+		std::vector<nodeid_t> host_candidates;
+		unsigned long long global_frontier = 1;
+		for (int level = 0; global_frontier > 0; level++) {
+			level_report_t report{level, global_frontier, false, 0, 0, 0};
+
+			// expand the local frontier
+			double t0 = MPI_Wtime();
+			*num_candidates.get() = 0;
+
+			if (!next.empty()) {
+				expand(next.size(), offsets.get(), edges.get(), visited.get(), frontier.get(), seen.get(), candidates.get(), num_candidates.get()).wait_and_throw();
+			}
+			unsigned k = *num_candidates.get();
+			host_candidates.resize(2 * k);
+			if (k) queue.copy(candidates.get(), host_candidates.data(), 2 * k).wait_and_throw();
+			double t1 = MPI_Wtime();
+
+			// exchange the candidates with their owners
+			std::vector<uint32_t> recv;
+			report.bytes_sent = exchange(host_candidates, k, recv, report.dense);
+			double t2 = MPI_Wtime();
+
+			// keep the first parent of every newly reached owned vertex, they form the next frontier
+			next.clear();
+			apply(recv, next);
+			if (!next.empty()) {
+				int *visited_ptr = visited.get();
+				nodeid_t *frontier_ptr = frontier.get();
+				nodeid_t first_node = data.first_node;
+				queue.copy(next.data(), frontier_ptr, next.size()).wait();
+				queue.parallel_for(s::range<1>{next.size()}, [=](s::id<1> idx) {
+					visited_ptr[frontier_ptr[idx[0]] - first_node] = 1;
+				}).wait_and_throw();
+			}
+			double t3 = MPI_Wtime();
+
+			unsigned long long local_next = next.size();
+			MPI_Allreduce(&local_next, &global_frontier, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+			double t4 = MPI_Wtime();
+
+			report.compute_time = ((t1 - t0) + (t3 - t2)) * 1e6;
+			report.comm_time = ((t2 - t1) + (t4 - t3)) * 1e6;
+			reports.push_back(report);
+		}
+		return reports;
+	}
+
+	/**
+	 * @brief Gathers the parents of all the vertices on the root rank.
+	 */
+	std::vector<nodeid_t> gather_parents(int root = 0) {
+		std::vector<int> counts(num_ranks), displs(num_ranks);
+		for (int r = 0; r < num_ranks; r++) {
+			counts[r] = part.count(r);
+			displs[r] = part.first(r);
+		}
+		std::vector<nodeid_t> all(rank == root ? data.global_nodes : 0);
+		MPI_Gatherv(data.parents.data(), data.num_nodes, MPI_INT, all.data(), counts.data(), displs.data(), MPI_INT, root, comm);
+		return all;
+	}
+
+	int get_rank() const { return rank; }
+	int get_num_ranks() const { return num_ranks; }
+
+private:
+	DistributedCSRHostData &data;
+	MPI_Comm comm;
+	int rank, num_ranks;
+	vertex_partition_t part;
+	s::queue queue;
+	MemoryPool pool;
+
+	s::event expand(size_t frontier_size, const size_t *offsets, const nodeid_t *edges, const int *visited,
+	                const nodeid_t *frontier, dmask_t *seen, nodeid_t *candidates, unsigned *num_candidates) {
+		nodeid_t first_node = data.first_node;
+		nodeid_t last_node = data.first_node + data.num_nodes;
+		return queue.parallel_for(s::range<1>{frontier_size}, [=](s::id<1> idx) {
+			s::atomic_ref<unsigned, s::memory_order::relaxed, s::memory_scope::device> count_ar{*num_candidates};
+			nodeid_t node = frontier[idx[0]];
+			nodeid_t row = node - first_node;
+			for (size_t i = offsets[row]; i < offsets[row + 1]; i++) {
+				nodeid_t neighbor = edges[i];
+				if (neighbor >= first_node && neighbor < last_node && visited[neighbor - first_node]) continue;
+
+				dmask_t bit = dmask_t(1) << (neighbor % DMASK_SIZE);
+				s::atomic_ref<dmask_t, s::memory_order::relaxed, s::memory_scope::device> seen_ar{seen[neighbor / DMASK_SIZE]};
+				if (!(seen_ar.fetch_or(bit) & bit)) {
+					unsigned pos = count_ar.fetch_add(1);
+					candidates[2 * pos] = neighbor;
+					candidates[2 * pos + 1] = node;
+				}
+			}
+		});
+	}
+
+	// message layout per destination: [dense flag, count, payload...]
+	size_t exchange(const std::vector<nodeid_t> &cand, unsigned k, std::vector<uint32_t> &recv, bool &any_dense) {
+		std::vector<std::vector<std::pair<nodeid_t, nodeid_t>>> buckets(num_ranks);
+		for (unsigned i = 0; i < k; i++) {
+			buckets[part.owner(cand[2 * i])].push_back({cand[2 * i], cand[2 * i + 1]});
+		}
+
+		std::vector<uint32_t> send;
+		std::vector<int> send_counts(num_ranks), send_displs(num_ranks);
+		any_dense = false;
+		for (int r = 0; r < num_ranks; r++) {
+			auto &b = buckets[r];
+			size_t range_words = part.count(r) / DMASK_SIZE + 1;
+			bool dense = range_words < b.size(); // bitmap + parents is smaller than the pairs
+			send_displs[r] = send.size();
+			send.push_back(dense);
+			send.push_back(b.size());
+			if (dense) {
+				any_dense = true;
+				std::sort(b.begin(), b.end());
+				size_t base = send.size();
+				send.resize(base + range_words, 0);
+				for (auto &p : b) {
+					nodeid_t local = p.first - part.first(r);
+					send[base + local / DMASK_SIZE] |= dmask_t(1) << (local % DMASK_SIZE);
+				}
+				for (auto &p : b) send.push_back(p.second);
+			} else {
+				for (auto &p : b) {
+					send.push_back(p.first);
+					send.push_back(p.second);
+				}
+			}
+			send_counts[r] = send.size() - send_displs[r];
+		}
+
+		std::vector<int> recv_counts(num_ranks), recv_displs(num_ranks);
+		MPI_Alltoall(send_counts.data(), 1, MPI_INT, recv_counts.data(), 1, MPI_INT, comm);
+		int total = 0;
+		for (int r = 0; r < num_ranks; r++) {
+			recv_displs[r] = total;
+			total += recv_counts[r];
+		}
+		recv.resize(total);
+		MPI_Alltoallv(send.data(), send_counts.data(), send_displs.data(), MPI_UINT32_T,
+		              recv.data(), recv_counts.data(), recv_displs.data(), MPI_UINT32_T, comm);
+
+		return (send.size() - send_counts[rank]) * sizeof(uint32_t);
+	}
+
+	void apply(const std::vector<uint32_t> &recv, std::vector<nodeid_t> &next) {
+		size_t range_words = data.num_nodes / DMASK_SIZE + 1;
+		auto visit = [&](nodeid_t v, nodeid_t parent) {
+			auto &p = data.parents[v - data.first_node];
+			if (p == -1) {
+				p = parent;
+				next.push_back(v);
+			}
+		};
+
+		for (size_t pos = 0; pos < recv.size();) {
+			bool dense = recv[pos];
+			size_t count = recv[pos + 1];
+			pos += 2;
+			if (dense) {
+				size_t parents_pos = pos + range_words;
+				for (size_t w = 0; w < range_words; w++) {
+					for (dmask_t bits = recv[pos + w]; bits; bits &= bits - 1) {
+						nodeid_t local = w * DMASK_SIZE + __builtin_ctz(bits);
+						visit(data.first_node + local, recv[parents_pos++]);
+					}
+				}
+				pos += range_words + count;
+			} else {
+				for (size_t i = 0; i < count; i++) {
+					visit(recv[pos + 2 * i], recv[pos + 2 * i + 1]);
+				}
+				pos += 2 * count;
+			}
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,260 @@
+/**
+ * @file dynamic_bfs.hpp
+ * @brief BFS tree of a single source kept up to date under batches of edge insertions and deletions.
+ */
+#ifndef __DYNAMIC_BFS_HPP__
+#define __DYNAMIC_BFS_HPP__
+
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "host_data.hpp"
+#include "dynamic_graph.hpp"
+#include "benchmark.hpp"
+#include "impl/mul_bfs.hpp"
+
+typedef struct {
+	size_t inserted;       // edges actually added
+	size_t deleted;        // edges actually removed
+	size_t orphaned;       // vertices that lost their tree path because of a deletion
+	size_t updated;        // vertices whose parent or level changed
+	size_t scanned_edges;  // edges visited by the repair
+	float time;            // us, structural update + repair
+} dynamic_update_stats_t;
+
+/**
+ * @brief Keeps the parents and levels of a BFS from one source across graph updates.
+ *
+ * The first traversal runs on the device with the given operator. Afterwards update() applies a
+ * batch of edge changes to a DynamicCSR (and its transpose) in place and repairs only the part of
+ * the tree they affect:
+ * - a deleted tree edge orphans the subtree below it; the orphans are re-attached level by level
+ *   starting from their in-neighbors that kept a valid path;
+ * - an inserted edge that shortens the distance of its head propagates the decrease to its out-neighbors.
+ * The cost depends on the size of the affected subtrees, not on the size of the graph.
+ */
+class DynamicGraphBFS {
+public:
+	DynamicGraphBFS(const CSRHostData &graph, std::shared_ptr<MultiBFSOperator> op, float slack = 0.25f) :
+		num_nodes(graph.num_nodes),
+		out(graph.csr, graph.num_nodes, slack),
+		in(transposeCSR(graph.csr, graph.num_nodes), graph.num_nodes, slack),
+		batch(1),
+		bfs(batch, op),
+		mark(graph.num_nodes, 0) {}
+
+	/**
+	 * @brief Builds the kernels before the first run, see MultipleGraphBFS::warmup.
+	 * @return The startup time in us
+	 */
+	float warmup() { return bfs.warmup(); }
+
+	/**
+	 * @brief Runs a full traversal from the source on the device and resets the session on it.
+	 * @throws std::out_of_range if the source is not a node of the graph
+	 */
+	bench_time_t run(nodeid_t source) {
+		check_node(source);
+		this->source = source;
+		batch[0].num_nodes = num_nodes;
+		batch[0].csr = out.compact();
+		batch[0].parents = std::vector<nodeid_t>(num_nodes, -1);
+		auto time = bfs.run({source});
+		parents = batch[0].parents;
+		build_levels();
+		return time;
+	}
+
+	/**
+	 * @brief Applies a batch of edge updates and repairs the BFS tree.
+	 * @param insertions The edges to add.
+	 * @param deletions The edges to remove.
+	 * @throws std::logic_error if run() was never called, std::out_of_range if an endpoint is not a node
+	 * of the graph; the graph is left untouched in both cases
+	 */
+	dynamic_update_stats_t update(const std::vector<edge_t> &insertions, const std::vector<edge_t> &deletions) {
+		if (parents.empty()) {
+			throw std::logic_error("DynamicGraphBFS: update() needs a tree, call run() first");
+		}
+		for (auto &e : deletions) {
+			check_node(e.first);
+			check_node(e.second);
+		}
+		for (auto &e : insertions) {
+			check_node(e.first);
+			check_node(e.second);
+		}
+		auto start = std::chrono::high_resolution_clock::now();
+		dynamic_update_stats_t stats{0, 0, 0, 0, 0, 0};
+
+		std::vector<nodeid_t> orphans;
+		for (auto &e : deletions) {
+			if (!out.remove(e.first, e.second)) continue;
+			in.remove(e.second, e.first);
+			stats.deleted++;
+			if (parents[e.second] == e.first && e.second != source) orphans.push_back(e.second);
+		}
+		for (auto &e : insertions) {
+			if (!out.insert(e.first, e.second)) continue;
+			in.insert(e.second, e.first);
+			stats.inserted++;
+		}
+
+		std::vector<nodeid_t> reattached;
+		repair_deletions(orphans, reattached, stats);
+		repair_insertions(insertions, reattached, stats);
+
+		stats.time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+		return stats;
+	}
+
+	const std::vector<nodeid_t> &get_parents() const { return parents; }
+	const std::vector<int> &get_levels() const { return levels; }
+
+	/**
+	 * @brief The current graph as a plain CSR.
+	 */
+	CSRHostData snapshot() const {
+		CSRHostData ret;
+		ret.num_nodes = num_nodes;
+		ret.csr = out.compact();
+		ret.parents = parents;
+		return ret;
+	}
+
+private:
+	size_t num_nodes;
+	nodeid_t source = 0;
+	DynamicCSR out, in;
+	std::vector<CSRHostData> batch;
+	MultipleGraphBFS<true> bfs;
+	std::vector<nodeid_t> parents;
+	std::vector<int> levels;
+	std::vector<char> mark; // 1: orphaned, 2: re-attached; cleared after every repair
+
+	void check_node(nodeid_t v) const {
+		if (v < 0 || static_cast<size_t>(v) >= num_nodes) {
+			throw std::out_of_range("DynamicGraphBFS: node " + std::to_string(v) + " out of the " + std::to_string(num_nodes) + " nodes of the graph");
+		}
+	}
+
+	void build_levels() {
+		levels.assign(num_nodes, -1);
+		levels[source] = 0;
+		std::vector<nodeid_t> chain;
+		for (nodeid_t v = 0; v < num_nodes; v++) {
+			nodeid_t u = v;
+			while (levels[u] == -1 && parents[u] != -1) {
+				chain.push_back(u);
+				u = parents[u];
+			}
+			int level = levels[u];
+			while (!chain.empty()) {
+				level = (level == -1) ? -1 : level + 1;
+				levels[chain.back()] = level;
+				chain.pop_back();
+			}
+		}
+	}
+
+	void repair_deletions(const std::vector<nodeid_t> &orphans, std::vector<nodeid_t> &reattached, dynamic_update_stats_t &stats) {
+		if (orphans.empty()) return;
+
+		// collect the orphaned subtrees: children are out-neighbors that point back as parent
+		std::vector<nodeid_t> affected;
+		for (nodeid_t v : orphans) {
+			if (!mark[v]) {
+				mark[v] = 1;
+				affected.push_back(v);
+			}
+		}
+		for (size_t i = 0; i < affected.size(); i++) {
+			nodeid_t u = affected[i];
+			for (nodeid_t w : out.neighbors(u)) {
+				stats.scanned_edges++;
+				if (!mark[w] && parents[w] == u) {
+					mark[w] = 1;
+					affected.push_back(w);
+				}
+			}
+		}
+		stats.orphaned = affected.size();
+
+		// best level reachable from an in-neighbor that kept its path
+		std::vector<int> old_levels(affected.size());
+		std::vector<std::vector<nodeid_t>> buckets;
+		for (size_t i = 0; i < affected.size(); i++) {
+			nodeid_t v = affected[i];
+			old_levels[i] = levels[v];
+			levels[v] = -1;
+			parents[v] = -1;
+			for (nodeid_t p : in.neighbors(v)) {
+				stats.scanned_edges++;
+				if (mark[p] || levels[p] == -1) continue;
+				if (levels[v] == -1 || levels[p] + 1 < levels[v]) {
+					levels[v] = levels[p] + 1;
+					parents[v] = p;
+				}
+			}
+			if (levels[v] != -1) {
+				if (buckets.size() <= levels[v]) buckets.resize(levels[v] + 1);
+				buckets[levels[v]].push_back(v);
+			}
+		}
+
+		// settle the affected vertices in level order, relaxing only inside the affected set
+		for (size_t l = 0; l < buckets.size(); l++) {
+			for (size_t i = 0; i < buckets[l].size(); i++) {
+				nodeid_t u = buckets[l][i];
+				if (levels[u] != l || mark[u] == 2) continue;
+				mark[u] = 2;
+				reattached.push_back(u);
+				for (nodeid_t w : out.neighbors(u)) {
+					stats.scanned_edges++;
+					if (mark[w] != 1) continue;
+					if (levels[w] == -1 || levels[w] > l + 1) {
+						levels[w] = l + 1;
+						parents[w] = u;
+						if (buckets.size() <= l + 1) buckets.resize(l + 2);
+						buckets[l + 1].push_back(w);
+					}
+				}
+			}
+		}
+
+		for (size_t i = 0; i < affected.size(); i++) {
+			if (levels[affected[i]] != old_levels[i]) stats.updated++;
+			mark[affected[i]] = 0;
+		}
+	}
+
+	void repair_insertions(const std::vector<edge_t> &insertions, const std::vector<nodeid_t> &reattached, dynamic_update_stats_t &stats) {
+		// re-attached vertices may have come back through an inserted edge shorter than before, so their
+		// out-neighbors outside the orphaned subtrees are checked as well
+		std::vector<nodeid_t> queue(reattached);
+		auto relax = [&](nodeid_t u, nodeid_t v) {
+			if (levels[u] == -1) return;
+			if (levels[v] == -1 || levels[u] + 1 < levels[v]) {
+				levels[v] = levels[u] + 1;
+				parents[v] = u;
+				queue.push_back(v);
+				stats.updated++;
+			}
+		};
+
+		for (auto &e : insertions) relax(e.first, e.second);
+
+		// levels only decrease, so a FIFO converges like a BFS from the shortened vertices
+		for (size_t i = 0; i < queue.size(); i++) {
+			nodeid_t u = queue[i];
+			for (nodeid_t w : out.neighbors(u)) {
+				stats.scanned_edges++;
+				relax(u, w);
+			}
+		}
+	}
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define __MUL_BFS_HPP__
 
 #include <sycl/sycl.hpp>
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <vector>
@@ -9,19 +10,28 @@
 #include <chrono>
 #include <array>
 #include <memory>
+#include <iterator>
+#include <type_traits>
 #include "kernel_sizes.hpp"
 #include "host_data.hpp"
 #include "sycl_data.hpp"
+#include "memory_pool.hpp"
 #include "types.hpp"
 #include "benchmark.hpp"
+#include "impl/bfs_summary.hpp"
+#include "impl/result_cache.hpp"
 
 namespace s = sycl;
 
+/**
+ * Operators only submit their kernels: the results are valid once the events they push have completed.
+ */
 class MultiBFSOperator {
 public:
 	/**
    * @brief Run the BFS algorithm on the given graph using Compressed data representation
    * @param queue The queue to use for the execution
+   * @param pool The memory pool to draw the scratch buffers from
    * @param data The Compressed Graph data representation of the graph to process
    * @param sources The sources to use for the BFS
    * @param events The events vector to fill with the events generated by the execution
@@ -29,6 +39,7 @@ public:
   */
 	virtual void operator() (
 		s::queue& queue, 
+		MemoryPool& pool, 
 		SYCL_CompressedGraphData& data, 
 		const std::vector<nodeid_t> &sources, 
 		std::vector<s::event>& events, 
@@ -36,6 +47,7 @@ public:
 	/**
    * @brief Run the BFS algorithm on the given graph using Vectorized data representation
    * @param queue The queue to use for the execution
+   * @param pool The memory pool to draw the scratch buffers from
    * @param data The V vectorized Graph data representation of the graph to process
    * @param sources The sources to use for the BFS
    * @param events The events vector to fill with the events generated by the execution
@@ -43,70 +55,491 @@ public:
   */
 	virtual void operator() (
 		s::queue& queue, 
+		MemoryPool& pool, 
 		SYCL_VectorizedGraphData& data, 
 		const std::vector<nodeid_t> &sources, 
 		std::vector<s::event>& events, 
 		const size_t wg_size = DEFAULT_WORK_GROUP_SIZE) = 0;
+
+	/**
+   * @brief Whether the operator labels every node (forest mode) instead of only the ones reachable from the sources
+  */
+	bool forest_mode() const { return forest; }
+
+	/**
+   * @brief Restricts the traversal to the nodes whose label is in mask: the others are never reached
+   * and never expanded. The sources are always reached. Needs graphs read with their labels.
+  */
+	virtual void set_label_mask(label_mask_t mask) { label_mask = mask; }
+
+	label_mask_t get_label_mask() const { return label_mask; }
+
+	/**
+   * @brief Whether the traversal is restricted to a set of labels
+  */
+	bool constrained() const { return label_mask != ALL_LABELS; }
+
+	/**
+   * @brief Device scratch memory the operator allocates for a graph of a batch, on top of the buffers of the batch
+  */
+	virtual size_t scratch_bytes(const CSRHostData& g) const { return sizeof(nodeid_t); }
+
+protected:
+	// in forest mode, once the traversal from the source is over each work-group seeds the next
+	// unreached node of its graph and continues, until every node has a parent and a component id
+	bool forest = false;
+	label_mask_t label_mask = ALL_LABELS;
+
+	/**
+   * @brief Throws if the operator cannot run its label mask on the given batch
+   * @param name The name of the operator, for the message
+  */
+	void check_label_mask(const SYCL_CompressedGraphData& data, const char* name) const {
+		if (!constrained()) return;
+		if (forest) {
+			throw s::exception(s::make_error_code(s::errc::feature_not_supported), std::string(name) + ": label masks are not supported in forest mode");
+		}
+		if (!data.has_labels()) {
+			throw s::exception(s::make_error_code(s::errc::invalid), std::string(name) + ": the label mask needs graphs read with their labels");
+		}
+	}
+
+	/**
+   * @brief Throws if the operator is constrained, for the engines that do not support label masks
+  */
+	void check_unconstrained(const char* name) const {
+		if (constrained()) {
+			throw s::exception(s::make_error_code(s::errc::feature_not_supported), std::string(name) + ": label masks are not supported by this representation or engine");
+		}
+	}
+};
+
+/**
+ * @brief Source of tuned configurations for a batch of graphs.
+ *
+ * MultipleGraphBFS asks it at construction for the operator and work-group size to use on its
+ * batch and device, so that a configuration measured once is reused on later runs.
+*/
+class BFSTuner {
+public:
+	virtual ~BFSTuner() = default;
+
+	/**
+   * @brief Looks up the configuration tuned for the class of the given batch
+   * @param data The batch of graphs
+   * @param device The device the batch will run on
+   * @param compressed Whether the batch uses the compressed representation
+   * @param forest Whether the operator must run in forest mode
+   * @param op Set to the tuned operator on success
+   * @param wg_size Set to the tuned work-group size on success
+   * @return false if nothing was tuned for this class
+  */
+	virtual bool lookup(
+		const std::vector<CSRHostData>& data, 
+		const s::device& device, 
+		bool compressed, 
+		bool forest, 
+		std::shared_ptr<MultiBFSOperator>& op, 
+		size_t& wg_size) = 0;
+
+	/**
+   * @brief Names the configuration lookup() returns for the same arguments, for reports
+   * @param op Set to the operator registry variant on success
+   * @param sg_size Set to its sub-group size on success
+   * @return false if nothing was tuned for this class, or if the tuner does not name its operators
+  */
+	virtual bool describe(
+		const std::vector<CSRHostData>& data, 
+		const s::device& device, 
+		bool compressed, 
+		bool forest, 
+		std::string& op, 
+		size_t& sg_size) { return false; }
 };
 
 template<bool compressed_representation = false>
 class MultipleGraphBFS {
 public:
+	typedef std::conditional_t<compressed_representation, SYCL_CompressedGraphData, SYCL_VectorizedGraphData> sycl_data_t;
+
 	MultipleGraphBFS(std::vector<CSRHostData>& data, std::shared_ptr<MultiBFSOperator> op) : 
-		data(data), op(op) {}
+		data(data), op(op),
+		queue(s::gpu_selector_v, s::property_list{s::property::queue::enable_profiling{}}),
+		pool(queue) {}
 
-	bench_time_t run(const std::vector<nodeid_t> &sources, const size_t wg_size = DEFAULT_WORK_GROUP_SIZE, bool write_back = true) {
-			// s queue definition
-		s::queue queue (s::gpu_selector_v, 
-						s::property_list{s::property::queue::enable_profiling{}});
+	MultipleGraphBFS(std::vector<CSRHostData>& data, std::shared_ptr<MultiBFSOperator> op, const s::device& device) : 
+		data(data), op(op),
+		queue(device, s::property_list{s::property::queue::enable_profiling{}}),
+		pool(queue) {}
 
+	/**
+	 * @brief Submits to an existing queue, shared with other sessions. The queue must have profiling enabled
+	*/
+	MultipleGraphBFS(std::vector<CSRHostData>& data, std::shared_ptr<MultiBFSOperator> op, const s::queue& queue) : 
+		data(data), op(op),
+		queue(queue),
+		pool(this->queue) {}
 
-		std::vector<s::event> events;
+	/**
+	 * @brief Uses the operator and work-group size tuned for this batch, or the fallback operator if the tuner has none
+	*/
+	MultipleGraphBFS(std::vector<CSRHostData>& data, BFSTuner& tuner, std::shared_ptr<MultiBFSOperator> fallback) : 
+		data(data), op(fallback),
+		queue(s::gpu_selector_v, s::property_list{s::property::queue::enable_profiling{}}),
+		pool(queue) 
+	{
+		tuner.lookup(data, queue.get_device(), compressed_representation, fallback->forest_mode(), op, tuned_wg_size);
+	}
+
+	/**
+	 * @brief The scratch memory pool shared by every run of this instance
+	*/
+	MemoryPool& get_pool() { return pool; }
 
-		std::chrono::system_clock::time_point start_glob, end_glob;
+	/**
+	 * @brief Restricts the traversals to the nodes whose label is in mask, see MultiBFSOperator::set_label_mask
+	*/
+	void set_label_mask(label_mask_t mask) { op->set_label_mask(mask); }
 
-		if constexpr (compressed_representation) {
-			CompressedHostData compressed_data(data);
-			SYCL_CompressedGraphData sycl_data(compressed_data);
-			init_data(queue, sources, sycl_data);
-			start_glob = std::chrono::high_resolution_clock::now();
-			(*op)(queue, sycl_data, sources, events, wg_size);
-			end_glob = std::chrono::high_resolution_clock::now();
-			if (write_back) sycl_data.write_back();
-		} else {
-			SYCL_VectorizedGraphData sycl_data{data};
-			init_data(queue, sources, sycl_data);
-			start_glob = std::chrono::high_resolution_clock::now();
-			(*op)(queue, sycl_data, sources, events, wg_size);
-			end_glob = std::chrono::high_resolution_clock::now();
-			if (write_back) sycl_data.write_back();
+	label_mask_t get_label_mask() const { return op->get_label_mask(); }
+
+	/**
+	 * @brief Answers run(sources) from a result cache, see BFSResultCache
+	 *
+	 * The graphs whose (content, source, label mask) is cached get their parents from it and skip the
+	 * device, the others run as a smaller batch and their parents are stored. Only the runs that write
+	 * the parents back outside forest mode use the cache, since it holds no components. The cache must
+	 * outlive this instance, nullptr detaches it.
+	*/
+	void set_result_cache(BFSResultCache* cache) { result_cache = cache; }
+
+	/**
+	 * @brief The queue the runs are submitted to, e.g. to upload graphs for run(device_data, ...)
+	*/
+	s::queue& get_queue() { return queue; }
+
+	/**
+	 * @brief The work-group size used when run() is not given one
+	*/
+	size_t get_work_group_size() const { return tuned_wg_size; }
+
+	/**
+	 * @brief A traversal in flight, returned by submit()
+	 *
+	 * It owns the device copy of the batch until get() is called. Destroying it without calling
+	 * get() waits for the kernels.
+	*/
+	class Submission {
+	public:
+		Submission() = default;
+		Submission(Submission&&) = default;
+		Submission& operator=(Submission&&) = default;
+
+		// a submission on resident data owns no buffer whose destructor would block, so it waits here
+		~Submission() {
+			if (!collected) s::event::wait(events);
 		}
 
-		long duration = 0;
-		for (s::event& e : events) {
-			auto start = e.get_profiling_info<s::info::event_profiling::command_start>();
-			auto end = e.get_profiling_info<s::info::event_profiling::command_end>();
-			duration += (end - start);
+		/**
+		 * @brief Whether every kernel of the traversal has completed, without blocking
+		*/
+		bool ready() const {
+			for (auto& e : events) {
+				if (e.get_info<s::info::event::command_execution_status>() != s::info::event_command_status::complete) return false;
+			}
+			return true;
 		}
 
+		/**
+		 * @brief The events of the traversal, to chain further work on the queue
+		*/
+		const std::vector<s::event>& get_events() const { return events; }
 
-		return bench_time_t {
-			.kernel_time = static_cast<float>(duration) / 1000,
-			.total_time = static_cast<float>(std::chrono::duration_cast<std::chrono::microseconds>(end_glob - start_glob).count()),
-			.to_microsec = 1.0f
-		};
+		/**
+		 * @brief Waits for the traversal, copies the parents back to the host graphs and returns its times, transfers and device memory
+		*/
+		bench_time_t get() {
+			if (collected) return time;
+			s::event::wait_and_throw(events);
+			auto end_glob = std::chrono::high_resolution_clock::now();
+			if (write_back) device_data->write_back(*queue);
+			// the pool peak also counts the scratch memory of the submissions in flight alongside this one
+			size_t device_bytes = device_data->device_bytes() + pool->stats(s::usm::alloc::device).high_water;
+			transfer_stats_t upload = profile_transfers(device_data->upload_events, device_data->upload_bytes);
+			transfer_stats_t download = write_back ? profile_transfers(device_data->download_events, device_data->download_bytes) : transfer_stats_t{};
+			device_data = nullptr;
+			sycl_data.reset();
+			compressed_data.reset();
+
+			long duration = 0;
+			for (s::event& e : events) {
+				auto start = e.get_profiling_info<s::info::event_profiling::command_start>();
+				auto end = e.get_profiling_info<s::info::event_profiling::command_end>();
+				duration += (end - start);
+			}
+			time = bench_time_t {
+				.kernel_time = static_cast<float>(duration) / 1000,
+				.total_time = static_cast<float>(std::chrono::duration_cast<std::chrono::microseconds>(end_glob - start_glob).count()),
+				.to_microsec = 1.0f,
+				.upload = upload,
+				.download = download,
+				.device_bytes = device_bytes
+			};
+			collected = true;
+			return time;
+		}
+
+	private:
+		friend class MultipleGraphBFS;
+
+		std::vector<nodeid_t> sources; // read by the asynchronous uploads
+		std::unique_ptr<CompressedHostData> compressed_data;
+		std::unique_ptr<sycl_data_t> sycl_data; // the device copy of the batch, unless it was already resident
+		sycl_data_t *device_data = nullptr;
+		s::queue *queue = nullptr;
+		MemoryPool *pool = nullptr;
+		std::vector<s::event> events;
+		std::chrono::high_resolution_clock::time_point start_glob;
+		bool write_back = true;
+		bool collected = false;
+		bench_time_t time;
+	};
+
+	/**
+	 * @brief Caps the device memory a batch may take, by default the global memory of the device
+	*/
+	void set_memory_budget(size_t bytes) { memory_budget = bytes; }
+
+	size_t get_memory_budget() const {
+		return memory_budget > 0 ? memory_budget : queue.get_device().get_info<s::info::device::global_mem_size>();
+	}
+
+	/**
+	 * @brief Device bytes a batch needs, estimated before it is uploaded: the buffers of its graphs and the scratch memory of the operator
+	*/
+	size_t footprint(const std::vector<CSRHostData>& batch) const {
+		size_t bytes = 0;
+		for (auto& g : batch) bytes += graph_footprint(g);
+		return bytes;
+	}
+
+	/**
+	 * @brief Splits a batch in consecutive parts that each fit the memory budget and the largest allocation of the device
+	 * @return The index of the first graph of each part, followed by the size of the batch
+	 * @throws s::exception (memory_allocation) if a graph does not fit on its own
+	*/
+	std::vector<size_t> partition(const std::vector<CSRHostData>& batch) const {
+		const size_t budget = get_memory_budget();
+		const size_t max_alloc = queue.get_device().get_info<s::info::device::max_mem_alloc_size>();
+		std::vector<size_t> cuts{0};
+		size_t bytes = 0, largest = 0;
+		for (size_t i = 0; i < batch.size(); i++) {
+			size_t g_bytes = graph_footprint(batch[i]);
+			size_t g_largest = std::max((batch[i].num_nodes + 1) * sizeof(size_t), batch[i].csr.edges.size() * sizeof(nodeid_t));
+			if (g_bytes > budget || g_largest > max_alloc) {
+				throw s::exception(s::make_error_code(s::errc::memory_allocation), "MultipleGraphBFS: graph " + std::to_string(i) + " needs " + std::to_string(g_bytes) + " bytes of device memory, the budget is " + std::to_string(budget));
+			}
+			// the compressed graphs share one buffer per array, the sum bounds the largest of them
+			size_t next_largest = compressed_representation ? largest + g_largest : std::max(largest, g_largest);
+			if (i > cuts.back() && (bytes + g_bytes > budget || next_largest > max_alloc)) {
+				cuts.push_back(i);
+				bytes = 0;
+				next_largest = g_largest;
+			}
+			bytes += g_bytes;
+			largest = next_largest;
+		}
+		cuts.push_back(batch.size());
+		return cuts;
+	}
+
+	/**
+	 * @brief Runs the BFS of every graph of the batch
+	 *
+	 * A batch larger than the memory budget runs as consecutive parts, see partition(); the times,
+	 * transfers and device memory returned are those of the whole batch.
+	 * @param sources The source of each graph
+	 * @param wg_size The size of the workgroups, 0 to use the tuned one (DEFAULT_WORK_GROUP_SIZE if untuned)
+	 * @param write_back Whether to copy the parents back to the host graphs
+	*/
+	bench_time_t run(const std::vector<nodeid_t> &sources, size_t wg_size = 0, bool write_back = true) {
+		wg_size = wg_size == 0 ? tuned_wg_size : wg_size;
+		if (result_cache != nullptr && write_back && !op->forest_mode()) return run_cached(sources, wg_size);
+		return run_parts(data, sources, wg_size, write_back);
+	}
+
+	/**
+	 * @brief Runs the BFS of every graph of the batch and computes the requested summaries on the device
+	 *
+	 * Only the summaries and paths are copied back, the full parents only if options.download_parents.
+	 * The batch must fit the memory budget.
+	 * @param options The summaries to compute
+	 * @param result Filled with the summary of each graph and the path to each target
+	*/
+	bench_time_t run(const std::vector<nodeid_t> &sources, const bfs_query_options_t &options, bfs_query_result_t &result, size_t wg_size = 0) {
+		wg_size = wg_size == 0 ? tuned_wg_size : wg_size;
+		auto sub = launch(data, sources, wg_size, options.download_parents, true);
+		summarize_parents(queue, pool, *sub.device_data, sub.get_events(), options, result, wg_size);
+		return sub.get();
+	}
+
+	/**
+	 * @brief Runs the BFS on graphs already on the device, which must live until the run is over
+	 * @param device_data The device copy of the graphs, e.g. built while they were streamed in
+	*/
+	bench_time_t run(sycl_data_t &device_data, const std::vector<nodeid_t> &sources, size_t wg_size = 0, bool write_back = true) {
+		Submission sub;
+		sub.device_data = &device_data;
+		return launch(sub, sources, wg_size == 0 ? tuned_wg_size : wg_size, write_back, true).get();
+	}
+
+	/**
+	 * @brief Starts the BFS of every graph of the batch and returns without waiting for the device
+	 *
+	 * Several submissions can be in flight on the queue of this instance; the results of each are
+	 * collected with Submission::get(). A batch that does not fit the memory budget is rejected
+	 * before it is uploaded.
+	 * @param sources The source of each graph
+	 * @param wg_size The size of the workgroups, 0 to use the tuned one
+	 * @param write_back Whether get() copies the parents back to the host graphs
+	*/
+	Submission submit(const std::vector<nodeid_t> &sources, size_t wg_size = 0, bool write_back = true) {
+		return submit(data, sources, wg_size, write_back);
+	}
+
+	/**
+	 * @brief Same as submit(sources), on another batch. The batch must not change until the submission is collected
+	*/
+	Submission submit(std::vector<CSRHostData>& batch, const std::vector<nodeid_t> &sources, size_t wg_size = 0, bool write_back = true) {
+		return launch(batch, sources, wg_size == 0 ? tuned_wg_size : wg_size, write_back, false);
+	}
+
+	/**
+	 * @brief Gets the kernels of the operator ready before the first run, so that run() does not pay for their JIT compilation
+	 * @param wg_size The work-group size the runs will use, 0 to use the tuned one
+	 * @return The startup time in us
+	*/
+	float warmup(size_t wg_size = 0) {
+		auto start = std::chrono::high_resolution_clock::now();
+#ifdef SYCL_BFS_AOT
+		// the device images were compiled at build time, this only loads them in the context
+		s::get_kernel_bundle<s::bundle_state::executable>(queue.get_context(), {queue.get_device()});
+#endif
+		// a one-node graph goes through the same launches as a real batch and leaves the built kernels in the runtime cache
+		std::vector<CSRHostData> probe(1);
+		probe[0].num_nodes = 1;
+		probe[0].csr.offsets = {0, 1};
+		probe[0].csr.edges = {0};
+		probe[0].parents = {-1};
+		if (op->constrained()) {
+			// a constrained operator needs labelled graphs, the probe node gets the lowest label of the mask
+			label_mask_t mask = op->get_label_mask();
+			label_t label = 0;
+			while (label < static_cast<label_t>(sizeof(label_mask_t) * 8) - 1 && !((mask >> label) & 1)) label++;
+			probe[0].labels = {label};
+		}
+		launch(probe, {0}, wg_size == 0 ? tuned_wg_size : wg_size, false, true).get();
+		auto end = std::chrono::high_resolution_clock::now();
+		return static_cast<float>(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
 	}
 
 private:
 	std::vector<CSRHostData>& data;
 	std::shared_ptr<MultiBFSOperator> op;
+	s::queue queue;
+	MemoryPool pool;
+	size_t tuned_wg_size = DEFAULT_WORK_GROUP_SIZE;
+	size_t memory_budget = 0; // 0 for the global memory of the device
+	BFSResultCache* result_cache = nullptr;
+
+	bench_time_t run_parts(std::vector<CSRHostData>& batch, const std::vector<nodeid_t> &sources, size_t wg_size, bool write_back) {
+		auto cuts = partition(batch);
+		if (cuts.size() <= 2) return launch(batch, sources, wg_size, write_back, true).get();
+
+		// the graphs are moved out of the batch and back, so the parts are not copied
+		bench_time_t time{0, 0, 1.0f};
+		for (size_t p = 0; p + 1 < cuts.size(); p++) {
+			std::vector<CSRHostData> part(std::make_move_iterator(batch.begin() + cuts[p]), std::make_move_iterator(batch.begin() + cuts[p + 1]));
+			std::vector<nodeid_t> part_sources(sources.begin() + cuts[p], sources.begin() + cuts[p + 1]);
+			bench_time_t part_time;
+			try {
+				part_time = launch(part, part_sources, wg_size, write_back, true).get();
+			} catch (...) {
+				std::move(part.begin(), part.end(), batch.begin() + cuts[p]);
+				throw;
+			}
+			std::move(part.begin(), part.end(), batch.begin() + cuts[p]);
+			accumulate(time, part_time);
+		}
+		return time;
+	}
+
+	bench_time_t run_cached(const std::vector<nodeid_t> &sources, size_t wg_size) {
+		std::vector<size_t> misses;
+		std::vector<bfs_cache_key_t> keys;
+		for (size_t i = 0; i < data.size(); i++) {
+			bfs_cache_key_t key{graph_key(data[i]), sources[i], false, op->get_label_mask()};
+			if (result_cache->get(key, data[i].parents)) continue;
+			misses.push_back(i);
+			keys.push_back(key);
+		}
+		bench_time_t time{0, 0, 1.0f};
+		if (misses.empty()) return time;
 
-	void init_data(s::queue& q, const std::vector<nodeid_t> &sources, SYCL_CompressedGraphData& data) {
-		data.init(q, sources).wait_and_throw();
+		// the missed graphs are moved out of the batch and back, as the parts of run_parts()
+		std::vector<CSRHostData> batch;
+		std::vector<nodeid_t> batch_sources;
+		for (auto i : misses) {
+			batch.push_back(std::move(data[i]));
+			batch_sources.push_back(sources[i]);
+		}
+		auto restore = [&]() {
+			for (size_t k = 0; k < misses.size(); k++) data[misses[k]] = std::move(batch[k]);
+		};
+		try {
+			time = run_parts(batch, batch_sources, wg_size, true);
+		} catch (...) {
+			restore();
+			throw;
+		}
+		restore();
+		for (size_t k = 0; k < misses.size(); k++) result_cache->put(keys[k], data[misses[k]].parents);
+		return time;
 	}
 
-	void init_data(s::queue& q, const std::vector<nodeid_t> &sources, SYCL_VectorizedGraphData& data) {
-		data.init(q, sources).wait_and_throw();
+	size_t graph_footprint(const CSRHostData& g) const {
+		return sycl_data_t::footprint(g, op->forest_mode()) + op->scratch_bytes(g);
+	}
+
+	Submission launch(std::vector<CSRHostData>& batch, const std::vector<nodeid_t> &sources, const size_t wg_size, bool write_back, bool synchronous) {
+		if (partition(batch).size() > 2) {
+			throw s::exception(s::make_error_code(s::errc::memory_allocation), "MultipleGraphBFS: the batch needs " + std::to_string(footprint(batch)) + " bytes of device memory, the budget is " + std::to_string(get_memory_budget()));
+		}
+		Submission sub;
+		if constexpr (compressed_representation) {
+			sub.compressed_data = std::make_unique<CompressedHostData>(batch);
+			sub.sycl_data = std::make_unique<SYCL_CompressedGraphData>(*sub.compressed_data, op->forest_mode());
+		} else {
+			sub.sycl_data = std::make_unique<SYCL_VectorizedGraphData>(batch);
+		}
+		sub.device_data = sub.sycl_data.get();
+		sub.device_data->upload(queue);
+		return launch(sub, sources, wg_size, write_back, synchronous);
+	}
+
+	Submission launch(Submission& sub, const std::vector<nodeid_t> &sources, const size_t wg_size, bool write_back, bool synchronous) {
+		sub.sources = sources;
+		sub.write_back = write_back;
+		sub.queue = &queue;
+		sub.pool = &pool;
+		pool.reset_high_water(s::usm::alloc::device);
+
+		// a blocking run keeps the initialization out of the measured time
+		auto init_e = sub.device_data->init(queue, sub.sources);
+		if (synchronous) init_e.wait_and_throw();
+		sub.start_glob = std::chrono::high_resolution_clock::now();
+		(*op)(queue, pool, *sub.device_data, sub.sources, sub.events, wg_size);
+		return std::move(sub);
 	}
 };
 
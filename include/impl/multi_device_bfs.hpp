@@ -0,0 +1,226 @@
+#ifndef __MULTI_DEVICE_BFS_HPP__
+#define __MULTI_DEVICE_BFS_HPP__
+
+#include <sycl/sycl.hpp>
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+#include "host_data.hpp"
+#include "benchmark.hpp"
+#include "impl/mul_bfs.hpp"
+
+namespace s = sycl;
+
+/**
+ * @brief Returns the devices to spread a batch over.
+ *
+ * All the GPUs are returned if there is any (unless use_cpu is set), otherwise the CPU devices.
+ * CPU devices are split into one sub-device per NUMA domain when the runtime supports it, so that
+ * each socket gets its own queue and works on its local memory.
+ *
+ * @param use_cpu If true, the CPU devices are selected even when a GPU is available.
+ * @param split_numa If true, CPU devices are partitioned by NUMA affinity domain.
+ */
+std::vector<s::device> get_bfs_devices(bool use_cpu = false, bool split_numa = true) {
+	std::vector<s::device> devices;
+	if (!use_cpu) {
+		for (auto &d : s::device::get_devices()) {
+			if (d.is_gpu()) devices.push_back(d);
+		}
+		if (!devices.empty()) return devices;
+	}
+
+	for (auto &d : s::device::get_devices()) {
+		if (!d.is_cpu()) continue;
+		if (split_numa) {
+			try {
+				auto sub_devices = d.create_sub_devices<s::info::partition_property::partition_by_affinity_domain>(s::info::partition_affinity_domain::numa);
+				if (sub_devices.size() > 1) {
+					devices.insert(devices.end(), sub_devices.begin(), sub_devices.end());
+					continue;
+				}
+			} catch (s::exception &e) {
+				// partitioning not supported by this device
+			}
+		}
+		devices.push_back(d);
+	}
+	return devices;
+}
+
+typedef struct {
+	std::string name;
+	size_t num_graphs;
+	size_t estimated_work; // nodes + edges of the graphs assigned to the device
+	bench_time_t time;
+	float utilization;     // busy time of the device over the time of the slowest device
+} device_report_t;
+
+typedef struct {
+	bench_time_t time;
+	std::vector<device_report_t> devices;
+} multi_device_report_t;
+
+/**
+ * @brief Runs a batch of graphs over several devices.
+ *
+ * The batch is partitioned once at construction with a greedy longest-processing-time assignment
+ * on the estimated edge work (nodes + edges) of each graph, weighted by the compute units of the
+ * devices. Every device gets its own MultipleGraphBFS (queue and memory pool), the partitions run
+ * concurrently and the parents end up in the caller's graphs as with a single device.
+ *
+ * @tparam compressed_representation Whether to use the compressed graph representation on each device.
+ */
+template<bool compressed_representation = true>
+class MultiDeviceGraphBFS {
+public:
+	MultiDeviceGraphBFS(std::vector<CSRHostData>& data, std::shared_ptr<MultiBFSOperator> op, const std::vector<s::device>& devices) :
+		data(data), devices(devices), parts(devices.size()), assignment(devices.size()), work(devices.size(), 0)
+	{
+		if (devices.empty()) {
+			throw s::exception(s::make_error_code(s::errc::invalid), "MultiDeviceGraphBFS: no device selected");
+		}
+		partition();
+		for (size_t d = 0; d < devices.size(); d++) {
+			runners.push_back(std::make_unique<MultipleGraphBFS<compressed_representation>>(parts[d], op, devices[d]));
+		}
+	}
+
+	/**
+	 * @brief Runs the BFS of every graph from the given sources.
+	 * @param sources The source of each graph of the batch.
+	 * @param wg_size The size of the work-groups.
+	 */
+	multi_device_report_t run(const std::vector<nodeid_t> &sources, const size_t wg_size = DEFAULT_WORK_GROUP_SIZE) {
+		const size_t num_devices = devices.size();
+		std::vector<std::vector<nodeid_t>> part_sources(num_devices);
+		std::vector<bench_time_t> times(num_devices);
+		std::vector<std::exception_ptr> errors(num_devices);
+
+		// lend the graphs to the partitions, they are moved back once the run is over
+		for (size_t d = 0; d < num_devices; d++) {
+			parts[d].clear();
+			for (size_t g : assignment[d]) {
+				parts[d].push_back(std::move(data[g]));
+				part_sources[d].push_back(sources[g]);
+			}
+		}
+
+		auto start_glob = std::chrono::high_resolution_clock::now();
+		std::vector<std::thread> workers;
+		for (size_t d = 0; d < num_devices; d++) {
+			if (assignment[d].empty()) continue;
+			workers.emplace_back([&, d]() {
+				try {
+					times[d] = runners[d]->run(part_sources[d], wg_size);
+				} catch (...) {
+					errors[d] = std::current_exception();
+				}
+			});
+		}
+		for (auto &w : workers) w.join();
+		auto end_glob = std::chrono::high_resolution_clock::now();
+
+		for (size_t d = 0; d < num_devices; d++) {
+			for (size_t i = 0; i < assignment[d].size(); i++) {
+				data[assignment[d][i]] = std::move(parts[d][i]);
+			}
+		}
+		for (auto &e : errors) {
+			if (e) std::rethrow_exception(e);
+		}
+
+		multi_device_report_t report;
+		float slowest = 0, kernel_time = 0;
+		for (size_t d = 0; d < num_devices; d++) {
+			if (assignment[d].empty()) times[d] = bench_time_t{0, 0, 1.0f};
+			slowest = std::max(slowest, times[d].total_time);
+			kernel_time = std::max(kernel_time, times[d].kernel_time);
+		}
+		for (size_t d = 0; d < num_devices; d++) {
+			report.devices.push_back(device_report_t{
+				.name = devices[d].get_info<s::info::device::name>(),
+				.num_graphs = assignment[d].size(),
+				.estimated_work = work[d],
+				.time = times[d],
+				.utilization = slowest > 0 ? times[d].total_time / slowest : 0.0f
+			});
+		}
+		report.time = bench_time_t {
+			.kernel_time = kernel_time,
+			.total_time = static_cast<float>(std::chrono::duration_cast<std::chrono::microseconds>(end_glob - start_glob).count()),
+			.to_microsec = 1.0f
+		};
+		return report;
+	}
+
+	/**
+	 * @brief Gets the kernels ready on every device at once, see MultipleGraphBFS::warmup.
+	 * @return The startup time in us
+	 */
+	float warmup(const size_t wg_size = DEFAULT_WORK_GROUP_SIZE) {
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<std::exception_ptr> errors(devices.size());
+		std::vector<std::thread> workers;
+		for (size_t d = 0; d < devices.size(); d++) {
+			workers.emplace_back([&, d]() {
+				try {
+					runners[d]->warmup(wg_size);
+				} catch (...) {
+					errors[d] = std::current_exception();
+				}
+			});
+		}
+		for (auto &w : workers) w.join();
+		for (auto &e : errors) {
+			if (e) std::rethrow_exception(e);
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		return static_cast<float>(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+	}
+
+	const std::vector<std::vector<size_t>>& get_assignment() const { return assignment; }
+
+private:
+	std::vector<CSRHostData>& data;
+	std::vector<s::device> devices;
+	std::vector<std::vector<CSRHostData>> parts;
+	std::vector<std::vector<size_t>> assignment; // graph indices assigned to each device
+	std::vector<size_t> work;
+	std::vector<std::unique_ptr<MultipleGraphBFS<compressed_representation>>> runners;
+
+	void partition() {
+		std::vector<size_t> order(data.size());
+		std::iota(order.begin(), order.end(), 0);
+		auto graph_work = [&](size_t g) { return data[g].num_nodes + data[g].csr.edges.size(); };
+		std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return graph_work(a) > graph_work(b); });
+
+		std::vector<double> capacity(devices.size());
+		for (size_t d = 0; d < devices.size(); d++) {
+			capacity[d] = std::max(1u, devices[d].get_info<s::info::device::max_compute_units>());
+		}
+
+		// the heaviest graph goes to the device that would finish first with it
+		for (size_t g : order) {
+			size_t best = 0;
+			double best_load = -1;
+			for (size_t d = 0; d < devices.size(); d++) {
+				double load = (work[d] + graph_work(g)) / capacity[d];
+				if (best_load < 0 || load < best_load) {
+					best = d;
+					best_load = load;
+				}
+			}
+			assignment[best].push_back(g);
+			work[best] += graph_work(g);
+		}
+		for (auto &a : assignment) std::sort(a.begin(), a.end());
+	}
+};
+
+#endif
@@ -0,0 +1,149 @@
+/**
+ * @file operator_registry.hpp
+ * @brief Every multi-graph operator variant instantiated at compile time, looked up by name at runtime.
+ */
+#ifndef __OPERATOR_REGISTRY_HPP__
+#define __OPERATOR_REGISTRY_HPP__
+
+#include <sycl/sycl.hpp>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "impl/mul_bfs.hpp"
+#include "impl/bfs_operators/bottomup_op.hpp"
+#include "impl/bfs_operators/frontier_op.hpp"
+#include "impl/bfs_operators/matrix_op.hpp"
+#include "impl/bfs_operators/spmv_op.hpp"
+
+namespace s = sycl;
+
+// builds an operator in forest mode or not, heavy_degree is used by the bottom-up operators only (0: their default)
+typedef std::function<std::shared_ptr<MultiBFSOperator>(bool forest, size_t heavy_degree)> operator_factory_t;
+
+typedef struct {
+	std::string name;    // "bottomup", "bottomup_sg" (hubs scanned by sub-groups), "matrix" (bit matrices, bottom-up for the graphs that do not fit), "frontier" or "spmv", with a "_w64" suffix for 64-bit frontier words
+	size_t sg_size;
+	size_t mask_bits;    // width of the bottom-up frontier words, 0 for the operators without them
+	bool vectorized;     // whether it runs on the vectorized representation, every variant runs on the compressed one
+	bool forest_compressed; // whether it has a forest mode on the compressed representation
+	bool forest_vectorized; // whether it has a forest mode on the vectorized representation
+	operator_factory_t make;
+} operator_variant_t;
+
+#ifdef SUPPORTS_SG_8
+typedef std::index_sequence<8, 16, 32> registered_sg_sizes_t;
+#else
+typedef std::index_sequence<16, 32> registered_sg_sizes_t;
+#endif
+typedef std::index_sequence<32, 64> registered_mask_bits_t;
+
+namespace registry_detail {
+
+template <size_t sg_size, size_t mask_bits>
+void add_bitset_variants(std::vector<operator_variant_t> &variants) {
+	typedef BottomUpMBFSOperator<sg_size, mask_bits> bottomup_t;
+	const std::string suffix = mask_bits == 32 ? "" : "_w" + std::to_string(mask_bits);
+
+	variants.push_back({"bottomup" + suffix, sg_size, mask_bits, true, true, false, [](bool forest, size_t heavy_degree) -> std::shared_ptr<MultiBFSOperator> {
+		return std::make_shared<bottomup_t>(forest, heavy_degree);
+	}});
+	variants.push_back({"bottomup_sg" + suffix, sg_size, mask_bits, true, true, false, [](bool forest, size_t heavy_degree) -> std::shared_ptr<MultiBFSOperator> {
+		return std::make_shared<bottomup_t>(forest, heavy_degree > 0 ? heavy_degree : bottomup_t::DEFAULT_HEAVY_DEGREE);
+	}});
+	variants.push_back({"matrix" + suffix, sg_size, mask_bits, true, true, false, [](bool forest, size_t heavy_degree) -> std::shared_ptr<MultiBFSOperator> {
+		return std::make_shared<MatrixMBFSOperator<sg_size>>(std::make_shared<bottomup_t>(forest, heavy_degree));
+	}});
+}
+
+template <size_t sg_size, size_t... mask_bits>
+void add_sg_variants(std::vector<operator_variant_t> &variants, std::index_sequence<mask_bits...>) {
+	(add_bitset_variants<sg_size, mask_bits>(variants), ...);
+	variants.push_back({"frontier", sg_size, 0, true, true, false, [](bool forest, size_t) -> std::shared_ptr<MultiBFSOperator> {
+		return std::make_shared<FrontierMBFSOperator<sg_size>>(forest);
+	}});
+	variants.push_back({"spmv", sg_size, 0, false, false, false, [](bool, size_t) -> std::shared_ptr<MultiBFSOperator> {
+		return std::make_shared<SpMVMBFSOperator<sg_size>>();
+	}});
+}
+
+template <size_t... sg_sizes>
+std::vector<operator_variant_t> build_variants(std::index_sequence<sg_sizes...>) {
+	std::vector<operator_variant_t> variants;
+	(add_sg_variants<sg_sizes>(variants, registered_mask_bits_t{}), ...);
+	return variants;
+}
+
+} // namespace registry_detail
+
+/**
+ * @brief Every operator variant built into the binary: operator x sub-group size x frontier word width.
+ *
+ * The cross product is instantiated at compile time, so the tuner and the benchmark pick any of
+ * them by name without rebuilding. Sub-group size 8 is only built with SUPPORTS_SG_8.
+ */
+inline const std::vector<operator_variant_t> &operator_variants() {
+	static const std::vector<operator_variant_t> variants = registry_detail::build_variants(registered_sg_sizes_t{});
+	return variants;
+}
+
+/**
+ * @brief Whether a variant has a forest mode on a representation; the vectorized kernels have none.
+ */
+inline bool has_forest_mode(const operator_variant_t &v, bool compressed) {
+	return compressed ? v.forest_compressed : v.forest_vectorized;
+}
+
+/**
+ * @brief Finds a variant by name and sub-group size.
+ * @return nullptr if the binary does not have it.
+ */
+inline const operator_variant_t *find_operator_variant(const std::string &name, size_t sg_size) {
+	for (auto &v : operator_variants()) {
+		if (v.name == name && v.sg_size == sg_size) return &v;
+	}
+	return nullptr;
+}
+
+/**
+ * @brief The variants that can run on a device with a representation and mode.
+ *
+ * The variants whose sub-group size is not in the sub_group_sizes of the device are left out.
+ */
+inline std::vector<const operator_variant_t *> device_variants(const s::device &device, bool compressed, bool forest) {
+	auto sg_sizes = device.get_info<s::info::device::sub_group_sizes>();
+	std::vector<const operator_variant_t *> ret;
+	for (auto &v : operator_variants()) {
+		if (std::find(sg_sizes.begin(), sg_sizes.end(), v.sg_size) == sg_sizes.end()) continue;
+		if ((!compressed && !v.vectorized) || (forest && !has_forest_mode(v, compressed))) continue;
+		ret.push_back(&v);
+	}
+	return ret;
+}
+
+/**
+ * @brief The distinct variant names, in registration order.
+ */
+inline std::vector<std::string> operator_names() {
+	std::vector<std::string> names;
+	for (auto &v : operator_variants()) {
+		if (std::find(names.begin(), names.end(), v.name) == names.end()) names.push_back(v.name);
+	}
+	return names;
+}
+
+/**
+ * @brief Builds the multi-graph operator with the given name and sub-group size.
+ * @param heavy_degree See BottomUpMBFSOperator, 0 keeps the default of the variant.
+ */
+inline std::shared_ptr<MultiBFSOperator> make_mbfs_operator(const std::string &op, size_t sg_size, bool forest = false, size_t heavy_degree = 0) {
+	const operator_variant_t *v = find_operator_variant(op, sg_size);
+	if (v == nullptr || (forest && !v->forest_compressed && !v->forest_vectorized)) {
+		throw s::exception(s::make_error_code(s::errc::invalid), "make_mbfs_operator: unknown operator " + op + "<" + std::to_string(sg_size) + ">" + (forest ? " in forest mode" : ""));
+	}
+	return v->make(forest, heavy_degree);
+}
+
+#endif
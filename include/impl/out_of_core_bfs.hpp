@@ -0,0 +1,343 @@
+/**
+ * @file out_of_core_bfs.hpp
+ * @brief BFS on a graph of a dataset pack too large for the device, streamed in vertex-range segments.
+ */
+#ifndef __OUT_OF_CORE_BFS_HPP__
+#define __OUT_OF_CORE_BFS_HPP__
+
+#include <sycl/sycl.hpp>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include "types.hpp"
+#include "kernel_sizes.hpp"
+#include "memory_pool.hpp"
+#include "graph_pack.hpp"
+
+namespace s = sycl;
+
+typedef struct {
+	size_t first_node;   // local ids, last_node excluded
+	size_t last_node;
+	uint64_t first_edge; // indices in the edges of the pack, last_edge excluded
+	uint64_t last_edge;
+} ooc_segment_t;
+
+typedef struct {
+	bool bottom_up;
+	size_t frontier;  // vertices in the frontier the level expanded
+	size_t segments;  // segments streamed to the device
+	size_t bytes;     // bytes streamed to the device
+	float io_time;    // us the loader spent reading the mapped file
+	float time;       // us, wall time of the level
+} ooc_level_stats_t;
+
+/**
+ * @brief Runs a BFS on a graph of a memory-mapped dataset pack without ever holding its CSR in host
+ * or device memory.
+ *
+ * The graph is cut in segments of consecutive vertices whose offsets and edges take at most
+ * segment_bytes (a single vertex with a larger adjacency gets a segment of its own). Only the
+ * per-vertex state lives on the device: the parents and two frontier bitmaps. Each level streams
+ * the segments it needs through NUM_SLOTS device slots:
+ * - top-down, the segments that hold frontier vertices;
+ * - bottom-up, the segments that still hold unvisited vertices (the graph must be undirected).
+ * The level runs in the direction that streams fewer bytes, and bottom-up on a tie once the frontier
+ * is large. A loader thread copies the next segment from the mapping into pinned memory while the
+ * current one is copied to the device and expanded, so the page faults of the file overlap with the
+ * kernels.
+ */
+class OutOfCoreBFS
+{
+public:
+	static constexpr size_t DEFAULT_SEGMENT_BYTES = 64 << 20;
+	static constexpr size_t NUM_SLOTS = 2;
+	static constexpr size_t ALPHA = 14; // bottom-up on a tie when the frontier is more than 1/ALPHA of the unvisited vertices
+
+	/**
+	 * @param pack The mapped pack, must outlive the object.
+	 * @param graph The graph of the pack to traverse.
+	 * @param queue The queue the copies and the kernels are submitted to.
+	 * @param segment_bytes The bytes of offsets and edges of a segment, a device slot takes about as much.
+	 */
+	OutOfCoreBFS(const MappedGraphPack &pack, size_t graph, s::queue &queue, size_t segment_bytes = DEFAULT_SEGMENT_BYTES) :
+		queue(queue), pool(queue)
+	{
+		if (graph >= pack.num_graphs()) {
+			throw s::exception(s::make_error_code(s::errc::invalid), "OutOfCoreBFS: no graph " + std::to_string(graph) + " in the pack");
+		}
+		num_nodes = pack.num_nodes(graph);
+		offsets = pack.node_offsets(graph);
+		edges = pack.edges_data();
+		num_masks = num_nodes / MASK_BITS + 1;
+
+		size_t max_nodes = 1;
+		uint64_t max_edges = 1;
+		for (size_t u = 0; u < num_nodes;) {
+			ooc_segment_t seg{u, u + 1, offsets[u], offsets[u + 1]};
+			while (seg.last_node < num_nodes && segment_size(seg.last_node + 1 - seg.first_node, offsets[seg.last_node + 1] - seg.first_edge) <= segment_bytes) {
+				seg.last_edge = offsets[++seg.last_node];
+			}
+			max_nodes = std::max(max_nodes, seg.last_node - seg.first_node);
+			max_edges = std::max(max_edges, seg.last_edge - seg.first_edge);
+			segments.push_back(seg);
+			u = seg.last_node;
+		}
+
+		parents_dev = std::make_unique<ScratchBuffer<nodeid_t>>(pool, std::max<size_t>(1, num_nodes));
+		frontier_dev = std::make_unique<ScratchBuffer<mask_t>>(pool, num_masks);
+		next_dev = std::make_unique<ScratchBuffer<mask_t>>(pool, num_masks);
+		bounds_dev = std::make_unique<ScratchBuffer<size_t>>(pool, segments.size() + 1);
+		counts_dev = std::make_unique<ScratchBuffer<size_t>>(pool, std::max<size_t>(1, 2 * segments.size()));
+		for (size_t k = 0; k < NUM_SLOTS; k++) {
+			slot_offsets[k] = std::make_unique<ScratchBuffer<uint64_t>>(pool, max_nodes + 1);
+			slot_edges[k] = std::make_unique<ScratchBuffer<nodeid_t>>(pool, max_edges);
+			staging_offsets[k] = std::make_unique<ScratchBuffer<uint64_t>>(pool, max_nodes + 1, s::usm::alloc::host);
+			staging_edges[k] = std::make_unique<ScratchBuffer<nodeid_t>>(pool, max_edges, s::usm::alloc::host);
+		}
+
+		std::vector<size_t> bounds;
+		for (auto &seg : segments) bounds.push_back(seg.first_node);
+		bounds.push_back(num_nodes);
+		queue.copy(bounds.data(), bounds_dev->get(), bounds.size()).wait();
+	}
+
+	const std::vector<ooc_segment_t> &get_segments() const { return segments; }
+
+	/**
+	 * @brief The device memory the traversal holds, per-vertex state and slots.
+	 */
+	size_t device_bytes() const { return pool.stats(s::usm::alloc::device).bytes_reserved; }
+
+	/**
+	 * @brief Runs a BFS from source, the parents stay on the device until get_parents() is called.
+	 * @return The stats of every level.
+	 */
+	std::vector<ooc_level_stats_t> run(nodeid_t source, size_t wg_size = DEFAULT_WORK_GROUP_SIZE)
+	{
+		if (source < 0 || static_cast<size_t>(source) >= num_nodes) {
+			throw s::exception(s::make_error_code(s::errc::invalid), "OutOfCoreBFS: source " + std::to_string(source) + " out of range");
+		}
+		nodeid_t *parents = parents_dev->get();
+		mask_t *frontier = frontier_dev->get();
+		mask_t *next = next_dev->get();
+		s::event::wait_and_throw({
+			queue.fill(parents, static_cast<nodeid_t>(-1), num_nodes),
+			queue.fill(frontier, static_cast<mask_t>(0), num_masks),
+			queue.fill(next, static_cast<mask_t>(0), num_masks)
+		});
+		queue.single_task([=]() {
+			parents[source] = source;
+			frontier[source / MASK_BITS] = static_cast<mask_t>(1) << (source % MASK_BITS);
+		}).wait_and_throw();
+
+		std::vector<ooc_level_stats_t> levels;
+		while (true) {
+			auto start = std::chrono::high_resolution_clock::now();
+			count_segments(frontier, wg_size);
+			size_t frontier_size = 0, unvisited = 0;
+			uint64_t top_down_bytes = 0, bottom_up_bytes = 0;
+			for (size_t k = 0; k < segments.size(); k++) {
+				frontier_size += counts[2 * k];
+				unvisited += counts[2 * k + 1];
+				if (counts[2 * k] > 0) top_down_bytes += segment_bytes_of(k);
+				if (counts[2 * k + 1] > 0) bottom_up_bytes += segment_bytes_of(k);
+			}
+			if (frontier_size == 0 || unvisited == 0) break;
+
+			ooc_level_stats_t level{false, frontier_size, 0, 0, 0, 0};
+			level.bottom_up = bottom_up_bytes < top_down_bytes || (bottom_up_bytes == top_down_bytes && frontier_size * ALPHA >= unvisited);
+			std::vector<size_t> active;
+			for (size_t k = 0; k < segments.size(); k++) {
+				if (counts[2 * k + (level.bottom_up ? 1 : 0)] > 0) active.push_back(k);
+			}
+			stream_level(active, level.bottom_up, frontier, next, wg_size, level);
+
+			std::swap(frontier, next);
+			queue.fill(next, static_cast<mask_t>(0), num_masks).wait_and_throw();
+			level.time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+			levels.push_back(level);
+		}
+		return levels;
+	}
+
+	/**
+	 * @brief Downloads the parents of the last run.
+	 */
+	std::vector<nodeid_t> get_parents()
+	{
+		std::vector<nodeid_t> ret(num_nodes);
+		queue.copy(parents_dev->get(), ret.data(), num_nodes).wait_and_throw();
+		return ret;
+	}
+
+private:
+	typedef uint32_t mask_t;
+	static constexpr size_t MASK_BITS = 32;
+
+	s::queue &queue;
+	MemoryPool pool;
+	size_t num_nodes;
+	size_t num_masks;
+	const uint64_t *offsets; // mapped
+	const nodeid_t *edges;   // mapped
+	std::vector<ooc_segment_t> segments;
+	std::vector<size_t> counts; // per segment: frontier vertices, unvisited vertices
+
+	std::unique_ptr<ScratchBuffer<nodeid_t>> parents_dev;
+	std::unique_ptr<ScratchBuffer<mask_t>> frontier_dev, next_dev;
+	std::unique_ptr<ScratchBuffer<size_t>> bounds_dev, counts_dev;
+	std::array<std::unique_ptr<ScratchBuffer<uint64_t>>, NUM_SLOTS> slot_offsets, staging_offsets;
+	std::array<std::unique_ptr<ScratchBuffer<nodeid_t>>, NUM_SLOTS> slot_edges, staging_edges;
+
+	static size_t segment_size(size_t nodes, uint64_t num_edges) { return (nodes + 1) * sizeof(uint64_t) + num_edges * sizeof(nodeid_t); }
+
+	size_t segment_bytes_of(size_t k) const { return segment_size(segments[k].last_node - segments[k].first_node, segments[k].last_edge - segments[k].first_edge); }
+
+	/**
+	 * @brief Counts the frontier and the unvisited vertices of every segment, one work-group per segment.
+	 */
+	void count_segments(const mask_t *frontier, size_t wg_size)
+	{
+		const nodeid_t *parents = parents_dev->get();
+		const size_t *bounds = bounds_dev->get();
+		size_t *counts_ptr = counts_dev->get();
+		queue.parallel_for(s::nd_range<1>{s::range<1>{wg_size * segments.size()}, s::range<1>{wg_size}}, [=](s::nd_item<1> item) {
+			auto seg = item.get_group_linear_id();
+			size_t in_frontier = 0, not_visited = 0;
+			for (size_t v = bounds[seg] + item.get_local_id(0); v < bounds[seg + 1]; v += item.get_local_range(0)) {
+				in_frontier += (frontier[v / MASK_BITS] >> (v % MASK_BITS)) & 1;
+				not_visited += parents[v] == -1;
+			}
+			in_frontier = s::reduce_over_group(item.get_group(), in_frontier, s::plus<size_t>());
+			not_visited = s::reduce_over_group(item.get_group(), not_visited, s::plus<size_t>());
+			if (item.get_local_id(0) == 0) {
+				counts_ptr[2 * seg] = in_frontier;
+				counts_ptr[2 * seg + 1] = not_visited;
+			}
+		}).wait_and_throw();
+		counts.resize(2 * segments.size());
+		queue.copy(counts_ptr, counts.data(), counts.size()).wait_and_throw();
+	}
+
+	/**
+	 * @brief Copies a segment from the mapping to the staging memory of a slot.
+	 * @return The time it took in us, page faults included.
+	 */
+	float load(const ooc_segment_t &seg, size_t slot)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		std::memcpy(staging_offsets[slot]->get(), offsets + seg.first_node, (seg.last_node - seg.first_node + 1) * sizeof(uint64_t));
+		std::memcpy(staging_edges[slot]->get(), edges + seg.first_edge, (seg.last_edge - seg.first_edge) * sizeof(nodeid_t));
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	/**
+	 * @brief Streams the active segments of a level through the slots and expands each of them.
+	 *
+	 * Segment j uses slot j % NUM_SLOTS. Its load starts once the copy of segment j - NUM_SLOTS out of
+	 * the staging memory is done, and its copy to the device waits for the kernel of segment
+	 * j - NUM_SLOTS, so a load, a copy and a kernel can be in flight at the same time.
+	 */
+	void stream_level(const std::vector<size_t> &active, bool bottom_up, const mask_t *frontier, mask_t *next, size_t wg_size, ooc_level_stats_t &level)
+	{
+		std::array<std::future<float>, NUM_SLOTS> loads;
+		std::array<std::vector<s::event>, NUM_SLOTS> copies;
+		std::array<s::event, NUM_SLOTS> kernels;
+		std::array<bool, NUM_SLOTS> used{};
+
+		auto start_load = [&](size_t j) {
+			size_t slot = j % NUM_SLOTS;
+			s::event::wait_and_throw(copies[slot]);
+			ooc_segment_t seg = segments[active[j]];
+			loads[slot] = std::async(std::launch::async, [this, seg, slot]() { return load(seg, slot); });
+		};
+
+		if (!active.empty()) start_load(0);
+		for (size_t j = 0; j < active.size(); j++) {
+			size_t slot = j % NUM_SLOTS;
+			const ooc_segment_t &seg = segments[active[j]];
+			level.io_time += loads[slot].get();
+
+			size_t nodes = seg.last_node - seg.first_node;
+			size_t num_edges = seg.last_edge - seg.first_edge;
+			std::vector<s::event> deps;
+			if (used[slot]) deps.push_back(kernels[slot]);
+			copies[slot] = {
+				queue.submit([&](s::handler &cgh) {
+					cgh.depends_on(deps);
+					cgh.memcpy(slot_offsets[slot]->get(), staging_offsets[slot]->get(), (nodes + 1) * sizeof(uint64_t));
+				}),
+				queue.submit([&](s::handler &cgh) {
+					cgh.depends_on(deps);
+					cgh.memcpy(slot_edges[slot]->get(), staging_edges[slot]->get(), num_edges * sizeof(nodeid_t));
+				})
+			};
+			kernels[slot] = expand(seg, slot, bottom_up, frontier, next, copies[slot], wg_size);
+			used[slot] = true;
+			level.segments++;
+			level.bytes += segment_size(nodes, num_edges);
+
+			if (j + 1 < active.size()) start_load(j + 1);
+		}
+		for (size_t k = 0; k < NUM_SLOTS; k++) {
+			if (used[k]) kernels[k].wait_and_throw();
+		}
+	}
+
+	/**
+	 * @brief Expands the vertices of the segment in a slot, one work-item per vertex.
+	 */
+	s::event expand(const ooc_segment_t &seg, size_t slot, bool bottom_up, const mask_t *frontier, mask_t *next, const std::vector<s::event> &deps, size_t wg_size)
+	{
+		const uint64_t *seg_offsets = slot_offsets[slot]->get();
+		const nodeid_t *seg_edges = slot_edges[slot]->get();
+		nodeid_t *parents = parents_dev->get();
+		size_t first = seg.first_node;
+		size_t nodes = seg.last_node - seg.first_node;
+		uint64_t base = seg.first_edge;
+		size_t global = (nodes + wg_size - 1) / wg_size * wg_size;
+
+		return queue.submit([&](s::handler &cgh) {
+			cgh.depends_on(deps);
+			cgh.parallel_for(s::nd_range<1>{s::range<1>{global}, s::range<1>{wg_size}}, [=](s::nd_item<1> item) {
+				size_t i = item.get_global_id(0);
+				if (i >= nodes) return;
+				nodeid_t u = first + i;
+				auto mark = [&](nodeid_t v) {
+					s::atomic_ref<mask_t, s::memory_order::relaxed, s::memory_scope::device, s::access::address_space::global_space> next_ref(next[v / MASK_BITS]);
+					next_ref |= static_cast<mask_t>(1) << (v % MASK_BITS);
+				};
+
+				if (bottom_up) {
+					if (parents[u] != -1) return;
+					for (uint64_t k = seg_offsets[i] - base; k < seg_offsets[i + 1] - base; k++) {
+						nodeid_t v = seg_edges[k];
+						if ((frontier[v / MASK_BITS] >> (v % MASK_BITS)) & 1) {
+							parents[u] = v;
+							mark(u);
+							break;
+						}
+					}
+				} else {
+					if (!((frontier[u / MASK_BITS] >> (u % MASK_BITS)) & 1)) return;
+					for (uint64_t k = seg_offsets[i] - base; k < seg_offsets[i + 1] - base; k++) {
+						nodeid_t v = seg_edges[k];
+						if (parents[v] != -1) continue;
+						s::atomic_ref<nodeid_t, s::memory_order::relaxed, s::memory_scope::device, s::access::address_space::global_space> parent_ref(parents[v]);
+						nodeid_t expected = -1;
+						if (parent_ref.compare_exchange_strong(expected, u)) mark(v);
+					}
+				}
+			});
+		});
+	}
+};
+
+#endif
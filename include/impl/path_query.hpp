@@ -0,0 +1,255 @@
+/**
+ * @file path_query.hpp
+ * @brief Batched point-to-point shortest path queries answered with bidirectional BFS.
+ */
+#ifndef __PATH_QUERY_HPP__
+#define __PATH_QUERY_HPP__
+
+#include <sycl/sycl.hpp>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include "host_data.hpp"
+#include "dynamic_graph.hpp"
+#include "sycl_data.hpp"
+#include "memory_pool.hpp"
+#include "kernel_sizes.hpp"
+#include "benchmark.hpp"
+
+namespace s = sycl;
+
+typedef struct {
+	size_t graph;
+	nodeid_t source;
+	nodeid_t target;
+} path_query_t;
+
+typedef struct {
+	int distance;               // number of hops, -1 if the target is not reachable
+	std::vector<nodeid_t> path; // source, ..., target
+} path_result_t;
+
+/**
+ * @brief Answers (graph, source, target) queries with a bidirectional BFS per work-group.
+ *
+ * Each work-group runs one query: a forward search from the source over the out-edges and a
+ * backward search from the target over the in-edges (a transposed copy of every graph is built
+ * once at construction). At each step the smaller frontier is expanded by a full level; the
+ * search stops at the end of the first level where the two sides meet, taking the meeting
+ * node with the smallest total distance, and the path is rebuilt on the device from both sides
+ * parents. Only the paths are copied back.
+ */
+class PathQueryBFS {
+public:
+	PathQueryBFS(std::vector<CSRHostData> &data) :
+		data(data),
+		reversed(reverse(data)),
+		fwd_host(data),
+		bwd_host(reversed),
+		fwd(fwd_host),
+		bwd(bwd_host),
+		queue(s::gpu_selector_v, s::property_list{s::property::queue::enable_profiling{}}),
+		pool(queue) {}
+
+	MemoryPool &get_pool() { return pool; }
+
+	/**
+	 * @brief Runs a batch of queries.
+	 * @param queries The queries to answer, any number per graph.
+	 * @param results Filled with the result of each query.
+	 * @param wg_size The size of the work-groups.
+	 */
+	bench_time_t run(const std::vector<path_query_t> &queries, std::vector<path_result_t> &results, const size_t wg_size = DEFAULT_WORK_GROUP_SIZE) {
+		const size_t num_queries = queries.size();
+		results.assign(num_queries, path_result_t{-1, {}});
+		if (num_queries == 0) return bench_time_t{0, 0, 1.0f};
+
+		// every query gets its own slice of the scratch arrays, sized by the nodes of its graph
+		std::vector<int> query_info(4 * num_queries);
+		size_t total = 0;
+		for (size_t q = 0; q < num_queries; q++) {
+			if (queries[q].graph >= data.size() ||
+			    queries[q].source < 0 || queries[q].source >= data[queries[q].graph].num_nodes ||
+			    queries[q].target < 0 || queries[q].target >= data[queries[q].graph].num_nodes) {
+				throw s::exception(s::make_error_code(s::errc::invalid), "PathQueryBFS: query out of range");
+			}
+			query_info[4 * q] = queries[q].graph;
+			query_info[4 * q + 1] = queries[q].source;
+			query_info[4 * q + 2] = queries[q].target;
+			query_info[4 * q + 3] = total;
+			total += fwd_host.nodes_count[queries[q].graph];
+		}
+
+		auto start_glob = std::chrono::high_resolution_clock::now();
+
+		ScratchBuffer<int> info{pool, query_info.size()};
+		ScratchBuffer<nodeid_t> fwd_parents{pool, total}, bwd_parents{pool, total};
+		ScratchBuffer<int> fwd_dist{pool, total}, bwd_dist{pool, total};
+		ScratchBuffer<nodeid_t> fwd_queue{pool, 2 * total}, bwd_queue{pool, 2 * total};
+		ScratchBuffer<int> path_len{pool, num_queries};
+
+		std::vector<s::event> deps;
+		deps.push_back(queue.copy(query_info.data(), info.get(), query_info.size()));
+		deps.push_back(queue.memset(fwd_parents.get(), 0xFF, total * sizeof(nodeid_t)));
+		deps.push_back(queue.memset(bwd_parents.get(), 0xFF, total * sizeof(nodeid_t)));
+
+		auto e = queue.submit([&](s::handler &cgh) {
+			cgh.depends_on(deps);
+			s::accessor f_offsets{fwd.edges_offsets, cgh, s::read_only};
+			s::accessor f_edges{fwd.edges, cgh, s::read_only};
+			s::accessor b_offsets{bwd.edges_offsets, cgh, s::read_only};
+			s::accessor b_edges{bwd.edges, cgh, s::read_only};
+			s::accessor nodes_offsets_acc{fwd.nodes_offsets, cgh, s::read_only};
+			s::accessor nodes_count_acc{fwd.nodes_count, cgh, s::read_only};
+
+			s::local_accessor<int, 1> state{s::range<1>{7}, cgh}; // fsize, bsize, nsize, fparity, bparity, flevel, blevel
+			s::local_accessor<uint64_t, 1> best{s::range<1>{1}, cgh};
+
+			const int *info_ptr = info.get();
+			nodeid_t *fp_ptr = fwd_parents.get(), *bp_ptr = bwd_parents.get();
+			int *fd_ptr = fwd_dist.get(), *bd_ptr = bwd_dist.get();
+			nodeid_t *fq_ptr = fwd_queue.get(), *bq_ptr = bwd_queue.get();
+			int *len_ptr = path_len.get();
+
+			cgh.parallel_for(s::nd_range<1>{s::range<1>{num_queries * wg_size}, s::range<1>{wg_size}}, [=](s::nd_item<1> item) {
+				const uint64_t NO_MEET = ~uint64_t(0);
+				auto q = item.get_group_linear_id();
+				auto loc_id = item.get_local_id(0);
+				auto local_size = item.get_local_range(0);
+
+				auto graph = info_ptr[4 * q];
+				nodeid_t source = info_ptr[4 * q + 1], target = info_ptr[4 * q + 2];
+				size_t base = info_ptr[4 * q + 3];
+				size_t node_offset = nodes_offsets_acc[graph];
+				size_t n = nodes_count_acc[graph];
+
+				nodeid_t *fp = fp_ptr + base, *bp = bp_ptr + base;
+				int *fd = fd_ptr + base, *bd = bd_ptr + base;
+				nodeid_t *fq = fq_ptr + 2 * base, *bq = bq_ptr + 2 * base;
+
+				s::atomic_ref<int, s::memory_order::relaxed, s::memory_scope::work_group, s::access::address_space::local_space> nsize_ar{state[2]};
+				s::atomic_ref<uint64_t, s::memory_order::relaxed, s::memory_scope::work_group, s::access::address_space::local_space> best_ar{best[0]};
+
+				if (loc_id == 0) {
+					fp[source] = source; fd[source] = 0; fq[0] = source;
+					bp[target] = target; bd[target] = 0; bq[0] = target;
+					state[0] = state[1] = 1;
+					state[3] = state[4] = state[5] = state[6] = 0;
+					best[0] = (source == target) ? (uint64_t)source : NO_MEET;
+				}
+				item.barrier(s::access::fence_space::global_and_local);
+
+				while (best[0] == NO_MEET && state[0] > 0 && state[1] > 0) {
+					// expand the smaller frontier by one full level
+					bool forward = state[0] <= state[1];
+					int size = forward ? state[0] : state[1];
+					int parity = forward ? state[3] : state[4];
+					int level = forward ? state[5] : state[6];
+					nodeid_t *cur = (forward ? fq : bq) + parity * n;
+					nodeid_t *next = (forward ? fq : bq) + (1 - parity) * n;
+					nodeid_t *my_p = forward ? fp : bp, *other_p = forward ? bp : fp;
+					int *my_d = forward ? fd : bd, *other_d = forward ? bd : fd;
+
+					item.barrier(s::access::fence_space::local_space);
+					if (loc_id == 0) state[2] = 0;
+					item.barrier(s::access::fence_space::local_space);
+
+					for (int i = loc_id; i < size; i += local_size) {
+						nodeid_t u = cur[i];
+						size_t begin = forward ? f_offsets[node_offset + u] : b_offsets[node_offset + u];
+						size_t end = forward ? f_offsets[node_offset + u + 1] : b_offsets[node_offset + u + 1];
+						for (size_t k = begin; k < end; k++) {
+							nodeid_t v = forward ? f_edges[k] : b_edges[k];
+							s::atomic_ref<nodeid_t, s::memory_order::relaxed, s::memory_scope::work_group> p_ar{my_p[v]};
+							nodeid_t expected = -1;
+							if (my_p[v] == -1 && p_ar.compare_exchange_strong(expected, u)) {
+								my_d[v] = level + 1;
+								next[nsize_ar.fetch_add(1)] = v;
+								if (other_p[v] != -1) {
+									best_ar.fetch_min((uint64_t)(level + 1 + other_d[v]) << 32 | (uint32_t)v);
+								}
+							}
+						}
+					}
+					item.barrier(s::access::fence_space::global_and_local);
+
+					if (loc_id == 0) {
+						if (forward) {
+							state[0] = state[2];
+							state[3] = 1 - state[3];
+							state[5]++;
+						} else {
+							state[1] = state[2];
+							state[4] = 1 - state[4];
+							state[6]++;
+						}
+					}
+					item.barrier(s::access::fence_space::local_space);
+				}
+
+				// rebuild the path source -> meet -> target in the first queue slice
+				if (loc_id == 0) {
+					if (best[0] == NO_MEET) {
+						len_ptr[q] = 0;
+					} else {
+						nodeid_t meet = best[0] & 0xFFFFFFFF;
+						int distance = best[0] >> 32;
+						nodeid_t *path = fq;
+						int pos = fd[meet];
+						for (nodeid_t v = meet; ; v = fp[v]) {
+							path[pos--] = v;
+							if (v == source) break;
+						}
+						pos = fd[meet];
+						for (nodeid_t v = meet; v != target; ) {
+							v = bp[v];
+							path[++pos] = v;
+						}
+						len_ptr[q] = distance + 1;
+					}
+				}
+			});
+		});
+		e.wait_and_throw();
+		auto end_glob = std::chrono::high_resolution_clock::now();
+
+		// download only the paths
+		std::vector<int> lengths(num_queries);
+		queue.copy(path_len.get(), lengths.data(), num_queries).wait_and_throw();
+		std::vector<s::event> copies;
+		for (size_t q = 0; q < num_queries; q++) {
+			if (lengths[q] == 0) continue;
+			results[q].distance = lengths[q] - 1;
+			results[q].path.resize(lengths[q]);
+			copies.push_back(queue.copy(fwd_queue.get() + 2 * query_info[4 * q + 3], results[q].path.data(), lengths[q]));
+		}
+		s::event::wait_and_throw(copies);
+
+		auto start = e.get_profiling_info<s::info::event_profiling::command_start>();
+		auto end = e.get_profiling_info<s::info::event_profiling::command_end>();
+		return bench_time_t {
+			.kernel_time = static_cast<float>(end - start) / 1000,
+			.total_time = static_cast<float>(std::chrono::duration_cast<std::chrono::microseconds>(end_glob - start_glob).count()),
+			.to_microsec = 1.0f
+		};
+	}
+
+private:
+	std::vector<CSRHostData> &data;
+	std::vector<CSRHostData> reversed;
+	CompressedHostData fwd_host, bwd_host;
+	SYCL_CompressedGraphData fwd, bwd;
+	s::queue queue;
+	MemoryPool pool;
+
+	static std::vector<CSRHostData> reverse(const std::vector<CSRHostData> &data) {
+		std::vector<CSRHostData> ret(data.size());
+		for (size_t i = 0; i < data.size(); i++) {
+			ret[i].num_nodes = data[i].num_nodes;
+			ret[i].csr = transposeCSR(data[i].csr, data[i].num_nodes);
+		}
+		return ret;
+	}
+};
+
+#endif
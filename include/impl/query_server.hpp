@@ -0,0 +1,506 @@
+/**
+ * @file query_server.hpp
+ * @brief Long-running BFS server that groups the queries arriving close in time into one launch.
+ */
+#ifndef __QUERY_SERVER_HPP__
+#define __QUERY_SERVER_HPP__
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "host_data.hpp"
+#include "impl/mul_bfs.hpp"
+#include "impl/result_cache.hpp"
+
+typedef struct {
+	size_t graph;
+	nodeid_t source;
+	nodeid_t target; // -1 to get the parents and distances of every node
+} bfs_query_t;
+
+typedef struct {
+	size_t queries;                     // queries answered
+	size_t batches;                     // launches
+	float throughput;                   // queries per second since the server started
+	std::vector<size_t> latency_histogram; // [i]: queries answered in [2^i, 2^(i+1)) us, from arrival to reply
+	cache_stats_t cache;                // all zero when the result cache is disabled
+} server_stats_t;
+
+/**
+ * @brief Distance of every node from the root of its BFS tree, -1 if it was not reached.
+ */
+std::vector<int> parents_to_distances(const std::vector<nodeid_t> &parents) {
+	std::vector<int> distances(parents.size(), -2); // -2: not computed yet
+	std::vector<nodeid_t> chain;
+	for (nodeid_t v = 0; v < parents.size(); v++) {
+		nodeid_t u = v;
+		while (distances[u] == -2 && parents[u] != -1 && parents[u] != u) {
+			chain.push_back(u);
+			u = parents[u];
+		}
+		if (distances[u] == -2) distances[u] = parents[u] == u ? 0 : -1;
+		int d = distances[u];
+		while (!chain.empty()) {
+			d = d == -1 ? -1 : d + 1;
+			distances[chain.back()] = d;
+			chain.pop_back();
+		}
+	}
+	return distances;
+}
+
+/**
+ * @brief Answers BFS queries on a set of graphs loaded once.
+ *
+ * Queries are "<graph> <source> [<target>]" lines, read from a stream or from the connections of a
+ * Unix domain socket. A dispatcher thread waits up to the deadline after the first pending query,
+ * or until max_batch queries are pending, and runs all of them as one multi-graph launch on the
+ * same queue, so graph loading, queue creation and JIT are paid once for the server lifetime.
+ * With a result cache the queries whose (graph, source) was answered recently skip the device, and
+ * the queries of a batch that share a (graph, source) run it once.
+ *
+ * The graphs are uploaded once and stay resident: a launch only uploads the offsets of the graphs
+ * it queries, and a graph queried from several sources in one batch runs in consecutive launches
+ * since the queries share its parents slice. The operator must read the graphs from the device
+ * buffers only (e.g. bottom-up or frontier), since the host side of a launch holds no CSR.
+ *
+ * Replies, one line per query:
+ * - "bfs <graph> <source> <n> parents <p_0..p_n-1> distances <d_0..d_n-1>"
+ * - "path <graph> <source> <target> <distance> <source..target>" (distance -1 and no path if unreachable)
+ * - "error <message>"
+ * The commands "info" and "stats" reply with the graph sizes and the server statistics.
+ */
+class BFSQueryServer {
+public:
+	/**
+	 * @param cache_bytes The memory budget of the result cache, 0 disables it.
+	 * @param compress_cache Whether the cached parents are stored compressed.
+	 */
+	BFSQueryServer(std::vector<CSRHostData> &graphs, std::shared_ptr<MultiBFSOperator> op, size_t deadline_us = 1000, size_t max_batch = 64, size_t cache_bytes = 0, bool compress_cache = false) :
+		graphs(graphs), bfs(graphs, op), forest(op->forest_mode()), deadline_us(deadline_us), max_batch(max_batch), histogram(32, 0)
+	{
+		upload_graphs();
+		if (cache_bytes > 0) {
+			cache = std::make_unique<BFSResultCache>(cache_bytes, compress_cache);
+			for (auto &g : graphs) keys.push_back(graph_key(g));
+		}
+	}
+
+	~BFSQueryServer() { stop(); }
+
+	/**
+	 * @brief Builds the kernels before the first query, see MultipleGraphBFS::warmup.
+	 * @param wg_size The work-group size of every launch of the server, 0 for the default
+	 * @return The startup time in us
+	 */
+	float warmup(size_t wg_size = 0) {
+		this->wg_size = wg_size;
+		return bfs.warmup(wg_size);
+	}
+
+	/**
+	 * @brief Starts the dispatcher thread.
+	 */
+	void start() {
+		running = true;
+		dispatcher = std::thread([this]() { dispatch(); });
+		start_time = std::chrono::high_resolution_clock::now();
+	}
+
+	/**
+	 * @brief Answers the pending queries and stops the dispatcher thread.
+	 */
+	void stop() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			running = false;
+		}
+		cv.notify_all();
+		if (dispatcher.joinable()) dispatcher.join();
+	}
+
+	/**
+	 * @brief Replaces graph i, the cached results of its previous content are dropped.
+	 *
+	 * The graphs are uploaded again before the next launch.
+	 * @throws std::out_of_range if there is no graph i
+	 */
+	void update_graph(size_t i, const CSRHostData &graph) {
+		std::lock_guard<std::mutex> lock(graphs_mutex);
+		if (i >= graphs.size()) {
+			throw std::out_of_range("BFSQueryServer: no graph " + std::to_string(i) + ", the server holds " + std::to_string(graphs.size()));
+		}
+		graphs[i] = graph;
+		stale = true;
+		if (cache) {
+			cache->invalidate(keys[i]);
+			keys[i] = graph_key(graphs[i]);
+		}
+	}
+
+	/**
+	 * @brief Queues a query, reply is called from the dispatcher thread once it is answered.
+	 */
+	void enqueue(const bfs_query_t &query, std::function<void(const std::string &)> reply) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			pending.push_back(pending_query_t{query, std::move(reply), std::chrono::high_resolution_clock::now()});
+		}
+		cv.notify_all();
+	}
+
+	/**
+	 * @brief Handles one line of the protocol.
+	 * @return false if the line asks to close the connection ("quit")
+	 */
+	bool handle_line(const std::string &line, std::function<void(const std::string &)> reply) {
+		std::istringstream in(line);
+		std::string cmd;
+		if (!(in >> cmd)) return true;
+		if (cmd == "quit") return false;
+		if (cmd == "info") {
+			std::lock_guard<std::mutex> lock(graphs_mutex);
+			std::ostringstream out;
+			out << "info " << graphs.size();
+			for (auto &g : graphs) out << " " << g.num_nodes;
+			reply(out.str());
+			return true;
+		}
+		if (cmd == "stats") {
+			auto st = stats();
+			std::ostringstream out;
+			out << "stats queries " << st.queries << " batches " << st.batches << " throughput " << st.throughput << " histogram";
+			for (size_t i = 0; i < st.latency_histogram.size(); i++) {
+				if (st.latency_histogram[i] > 0) out << " " << (1ul << i) << ":" << st.latency_histogram[i];
+			}
+			if (cache) {
+				out << " cache hits " << st.cache.hits << " misses " << st.cache.misses << " hit_rate " << st.cache.hit_rate
+				    << " entries " << st.cache.entries << " bytes " << st.cache.bytes;
+			}
+			reply(out.str());
+			return true;
+		}
+
+		bfs_query_t query{0, 0, -1};
+		try {
+			query.graph = std::stoul(cmd);
+		} catch (std::exception &e) {
+			reply("error unknown command " + cmd);
+			return true;
+		}
+		if (!(in >> query.source)) {
+			reply("error missing source");
+			return true;
+		}
+		if (!(in >> query.target)) query.target = -1;
+		std::unique_lock<std::mutex> graphs_lock(graphs_mutex);
+		if (query.graph >= graphs.size() || query.source < 0 || query.source >= graphs[query.graph].num_nodes ||
+		    query.target < -1 || query.target >= (nodeid_t)graphs[query.graph].num_nodes) {
+			reply("error query out of range");
+			return true;
+		}
+		graphs_lock.unlock();
+		enqueue(query, std::move(reply));
+		return true;
+	}
+
+	/**
+	 * @brief Serves the line protocol on a stream (e.g. stdin/stdout) until end of input or "quit".
+	 */
+	void serve_stream(std::istream &in, std::ostream &out) {
+		std::mutex out_mutex;
+		auto reply = [&](const std::string &s) {
+			std::lock_guard<std::mutex> lock(out_mutex);
+			out << s << std::endl;
+		};
+		std::string line;
+		while (std::getline(in, line) && handle_line(line, reply)) {}
+		stop(); // the replies still pending write to out_mutex, answer them before it goes away
+	}
+
+	/**
+	 * @brief Serves the line protocol on a Unix domain socket, one thread per connection, until a client sends "shutdown".
+	 */
+	void serve_socket(const std::string &path) {
+		int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		sockaddr_un addr{};
+		addr.sun_family = AF_UNIX;
+		if (listen_fd < 0 || path.size() >= sizeof(addr.sun_path)) {
+			throw std::runtime_error("BFSQueryServer: cannot create socket " + path);
+		}
+		std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+		unlink(path.c_str());
+		if (bind(listen_fd, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_fd, 64) < 0) {
+			close(listen_fd);
+			throw std::runtime_error("BFSQueryServer: cannot listen on " + path + ": " + std::strerror(errno));
+		}
+
+		std::vector<std::thread> clients;
+		// kept open until every client thread is joined, so their descriptors are not reused meanwhile
+		std::vector<std::shared_ptr<connection_t>> connections;
+		std::atomic<bool> shutdown_requested{false};
+		while (!shutdown_requested) {
+			int fd = accept(listen_fd, nullptr, nullptr);
+			if (fd < 0) break;
+			auto conn = std::make_shared<connection_t>(fd);
+			connections.push_back(conn);
+			clients.emplace_back([this, conn, listen_fd, &shutdown_requested]() {
+				auto reply = [conn](const std::string &s) { conn->send_line(s); };
+				std::string line;
+				while (conn->read_line(line)) {
+					if (line == "shutdown") {
+						shutdown_requested = true;
+						::shutdown(listen_fd, SHUT_RDWR); // wakes up accept()
+						break;
+					}
+					if (!handle_line(line, reply)) break;
+				}
+			});
+		}
+		// the other clients may be blocked in recv(), waiting for lines that will never come
+		for (auto &conn : connections) ::shutdown(conn->fd, SHUT_RDWR);
+		for (auto &c : clients) c.join();
+		close(listen_fd);
+		unlink(path.c_str());
+		stop();
+	}
+
+	server_stats_t stats() const {
+		std::lock_guard<std::mutex> lock(stats_mutex);
+		float elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start_time).count() / 1e6f;
+		return server_stats_t{answered, batches, elapsed > 0 ? answered / elapsed : 0, histogram, cache ? cache->stats() : cache_stats_t{}};
+	}
+
+private:
+	typedef struct {
+		bfs_query_t query;
+		std::function<void(const std::string &)> reply;
+		std::chrono::high_resolution_clock::time_point arrival;
+	} pending_query_t;
+
+	// a client connection; replies come from the dispatcher thread, so writes are serialized
+	struct connection_t {
+		int fd;
+		std::mutex write_mutex;
+		std::string buffer;
+
+		connection_t(int fd) : fd(fd) {}
+		~connection_t() { close(fd); }
+
+		bool read_line(std::string &line) {
+			size_t pos;
+			while ((pos = buffer.find('\n')) == std::string::npos) {
+				char chunk[4096];
+				ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+				if (n <= 0) return false;
+				buffer.append(chunk, n);
+			}
+			line = buffer.substr(0, pos);
+			buffer.erase(0, pos + 1);
+			return true;
+		}
+
+		void send_line(const std::string &s) {
+			std::lock_guard<std::mutex> lock(write_mutex);
+			std::string msg = s + "\n";
+			for (size_t sent = 0; sent < msg.size();) {
+				ssize_t n = send(fd, msg.data() + sent, msg.size() - sent, MSG_NOSIGNAL);
+				if (n <= 0) return; // the client went away
+				sent += n;
+			}
+		}
+	};
+
+	std::vector<CSRHostData> &graphs;
+	std::mutex graphs_mutex;
+	std::unique_ptr<CompressedHostData> arena;         // host copy of the graphs backing the resident buffers
+	std::unique_ptr<SYCL_CompressedGraphData> resident; // every graph, uploaded once
+	bool stale = false;                                 // a graph was replaced since the last upload
+	MultipleGraphBFS<true> bfs;
+	bool forest;
+	size_t wg_size = 0;
+	std::unique_ptr<BFSResultCache> cache;
+	std::vector<graph_key_t> keys; // graph_key of each graph, kept only with the cache
+	size_t deadline_us, max_batch;
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::deque<pending_query_t> pending;
+	bool running = false;
+	std::thread dispatcher;
+
+	mutable std::mutex stats_mutex;
+	size_t answered = 0, batches = 0;
+	std::vector<size_t> histogram;
+	std::chrono::high_resolution_clock::time_point start_time;
+
+	// called with graphs_mutex held, or before the server starts
+	void upload_graphs() {
+		resident.reset();
+		arena = std::make_unique<CompressedHostData>(graphs);
+		resident = std::make_unique<SYCL_CompressedGraphData>(*arena, forest);
+		resident->upload(bfs.get_queue());
+		s::event::wait_and_throw(resident->upload_events);
+		stale = false;
+	}
+
+	/**
+	 * @brief Runs the given (graph, source) pairs on the resident graphs, at most one source per graph a launch
+	 * @return The parents of each pair
+	 */
+	std::vector<std::vector<nodeid_t>> run_resident(const std::vector<size_t> &run_graphs, const std::vector<nodeid_t> &run_sources) {
+		std::vector<std::vector<nodeid_t>> parents(run_graphs.size());
+		std::vector<bool> done(run_graphs.size(), false);
+		s::queue &queue = bfs.get_queue();
+		for (size_t remaining = run_graphs.size(); remaining > 0;) {
+			std::vector<size_t> launch, launch_graphs;
+			std::vector<nodeid_t> launch_sources;
+			for (size_t k = 0; k < run_graphs.size(); k++) {
+				if (done[k] || std::find(launch_graphs.begin(), launch_graphs.end(), run_graphs[k]) != launch_graphs.end()) continue;
+				launch.push_back(k);
+				launch_graphs.push_back(run_graphs[k]);
+				launch_sources.push_back(run_sources[k]);
+				done[k] = true;
+			}
+			remaining -= launch.size();
+
+			CompressedHostData view(*arena, launch_graphs);
+			SYCL_CompressedGraphData data(view, *resident);
+			data.upload(queue);
+			bfs.run(data, launch_sources, wg_size, false);
+
+			// only the slices of the launched graphs come back
+			std::vector<s::event> copies;
+			for (size_t j = 0; j < launch.size(); j++) {
+				auto &dst = parents[launch[j]];
+				dst.resize(view.nodes_count[j]);
+				copies.push_back(queue.submit([&](s::handler &h) {
+					s::accessor acc{data.parents, h, s::range<1>{dst.size()}, s::id<1>{view.nodes_offsets[j]}, s::read_only};
+					h.copy(acc, dst.data());
+				}));
+			}
+			s::event::wait_and_throw(copies);
+		}
+		return parents;
+	}
+
+	void dispatch() {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			cv.wait(lock, [&]() { return !pending.empty() || !running; });
+			if (pending.empty()) return;
+
+			// give the queries arriving shortly after the first one a chance to share its launch
+			auto deadline = pending.front().arrival + std::chrono::microseconds(deadline_us);
+			cv.wait_until(lock, deadline, [&]() { return pending.size() >= max_batch || !running; });
+
+			std::vector<pending_query_t> group;
+			while (!pending.empty() && group.size() < max_batch) {
+				group.push_back(std::move(pending.front()));
+				pending.pop_front();
+			}
+			lock.unlock();
+			answer(group);
+			lock.lock();
+		}
+	}
+
+	void answer(std::vector<pending_query_t> &group) {
+		std::vector<std::string> replies(group.size());
+		std::vector<std::vector<nodeid_t>> cached(group.size());
+		std::vector<int> slot(group.size(), -1); // launch slot of each query, -1 if it hit the cache
+		std::vector<bfs_cache_key_t> run_keys;
+		std::vector<size_t> run_graphs; // one per distinct (graph, source) with the cache
+		std::vector<nodeid_t> sources;
+		std::vector<std::vector<nodeid_t>> results;
+		// held through the launch, so update_graph() does not replace the resident graphs under it
+		std::unique_lock<std::mutex> graphs_lock(graphs_mutex);
+		for (size_t i = 0; i < group.size(); i++) {
+			auto &q = group[i].query;
+			if (cache) {
+				bfs_cache_key_t key{keys[q.graph], q.source, forest, bfs.get_label_mask()};
+				if (cache->get(key, cached[i])) continue;
+				auto dup = std::find_if(run_keys.begin(), run_keys.end(), [&](const bfs_cache_key_t &k) { return k.graph == key.graph && k.source == key.source; });
+				if (dup != run_keys.end()) {
+					slot[i] = dup - run_keys.begin();
+					continue;
+				}
+				run_keys.push_back(key);
+			}
+			slot[i] = run_graphs.size();
+			run_graphs.push_back(q.graph);
+			sources.push_back(q.source);
+		}
+
+		try {
+			if (!run_graphs.empty()) {
+				if (stale) upload_graphs();
+				results = run_resident(run_graphs, sources);
+			}
+			graphs_lock.unlock();
+			if (cache) {
+				for (size_t k = 0; k < run_keys.size(); k++) cache->put(run_keys[k], results[k]);
+			}
+			for (size_t i = 0; i < group.size(); i++) {
+				replies[i] = format_reply(group[i].query, slot[i] < 0 ? cached[i] : results[slot[i]]);
+			}
+		} catch (std::exception &e) {
+			for (auto &r : replies) r = std::string("error ") + e.what();
+		}
+		if (graphs_lock.owns_lock()) graphs_lock.unlock();
+
+		bool launched = !run_graphs.empty();
+		auto now = std::chrono::high_resolution_clock::now();
+		{
+			std::lock_guard<std::mutex> lock(stats_mutex);
+			if (launched) batches++;
+			for (auto &p : group) {
+				size_t us = std::chrono::duration_cast<std::chrono::microseconds>(now - p.arrival).count();
+				size_t bucket = 0;
+				while ((2ul << bucket) <= us && bucket + 1 < histogram.size()) bucket++;
+				histogram[bucket]++;
+				answered++;
+			}
+		}
+		for (size_t i = 0; i < group.size(); i++) group[i].reply(replies[i]);
+	}
+
+	static std::string format_reply(const bfs_query_t &q, const std::vector<nodeid_t> &parents) {
+		std::ostringstream out;
+		if (q.target >= 0) {
+			std::vector<nodeid_t> path;
+			if (parents[q.target] != -1) {
+				for (nodeid_t v = q.target; ; v = parents[v]) {
+					path.push_back(v);
+					if (v == q.source) break;
+				}
+			}
+			out << "path " << q.graph << " " << q.source << " " << q.target << " " << (int)path.size() - 1;
+			for (auto it = path.rbegin(); it != path.rend(); it++) out << " " << *it;
+			return out.str();
+		}
+		out << "bfs " << q.graph << " " << q.source << " " << parents.size() << " parents";
+		for (auto p : parents) out << " " << p;
+		out << " distances";
+		for (auto d : parents_to_distances(parents)) out << " " << d;
+		return out.str();
+	}
+};
+
+#endif
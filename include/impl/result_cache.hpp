@@ -0,0 +1,229 @@
+/**
+ * @file result_cache.hpp
+ * @brief LRU cache of BFS parent arrays keyed by graph content, source and mode.
+ */
+#ifndef __RESULT_CACHE_HPP__
+#define __RESULT_CACHE_HPP__
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "host_data.hpp"
+
+/**
+ * @brief Identifies the content of a graph by its sizes and two independent hashes of it.
+ */
+typedef struct {
+	size_t num_nodes;
+	size_t num_edges;
+	uint64_t hash;  // FNV-1a of the node count, offsets and edges
+	uint64_t check; // splitmix64 chain over the same values, a hit needs both hashes to collide
+} graph_key_t;
+
+inline bool operator==(const graph_key_t &a, const graph_key_t &b) {
+	return a.num_nodes == b.num_nodes && a.num_edges == b.num_edges && a.hash == b.hash && a.check == b.check;
+}
+
+/**
+ * @brief Computes the key of the content of a graph (node count, offsets and edges).
+ */
+graph_key_t graph_key(const CSRHostData &graph) {
+	uint64_t h = 14695981039346656037ull, c = graph.num_nodes;
+	auto mix = [&h](const void *data, size_t bytes) {
+		const unsigned char *p = static_cast<const unsigned char *>(data);
+		for (size_t i = 0; i < bytes; i++) {
+			h ^= p[i];
+			h *= 1099511628211ull;
+		}
+	};
+	auto chain = [&c](uint64_t x) {
+		uint64_t z = c + x + 0x9e3779b97f4a7c15ull;
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		c = z ^ (z >> 31);
+	};
+	mix(&graph.num_nodes, sizeof(graph.num_nodes));
+	mix(graph.csr.offsets.data(), graph.csr.offsets.size() * sizeof(size_t));
+	mix(graph.csr.edges.data(), graph.csr.edges.size() * sizeof(nodeid_t));
+	for (auto o : graph.csr.offsets) chain(o);
+	for (auto e : graph.csr.edges) chain(static_cast<uint64_t>(e));
+	return graph_key_t{graph.num_nodes, graph.csr.edges.size(), h, c};
+}
+
+typedef struct {
+	graph_key_t graph;
+	nodeid_t source;
+	bool forest;
+	label_mask_t label_mask; // the labels the traversal was restricted to
+} bfs_cache_key_t;
+
+typedef struct {
+	size_t hits;
+	size_t misses;
+	size_t evictions;
+	size_t entries;
+	size_t bytes;    // payload and bookkeeping of the cached entries
+	float hit_rate;
+} cache_stats_t;
+
+/**
+ * @brief Keeps the parents of recent BFS runs within a memory budget, evicting the least recently used.
+ *
+ * Keys identify the graph content, so a graph that changes gets new keys and can never hit a stale
+ * entry; invalidate() frees the entries of the old content right away instead of letting them age
+ * out. Every field of a key is stored and compared on a hit, the hashes only pick the bucket. With compression the parents are stored as zigzag varints of parents[v] - v, which is a few
+ * bytes per node on graphs whose neighbors have close ids. All the methods are thread safe.
+ */
+class BFSResultCache {
+public:
+	/**
+	 * @param budget_bytes The memory the cached entries may take.
+	 * @param compress Whether the parents are stored varint-encoded.
+	 */
+	BFSResultCache(size_t budget_bytes, bool compress = false) : budget(budget_bytes), compress(compress) {}
+
+	/**
+	 * @brief Looks up the parents of a run and marks the entry as the most recently used.
+	 * @return false on a miss, parents is left untouched.
+	 */
+	bool get(const bfs_cache_key_t &key, std::vector<nodeid_t> &parents) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = index.find(key);
+		if (it == index.end()) {
+			misses++;
+			return false;
+		}
+		hits++;
+		entries.splice(entries.begin(), entries, it->second);
+		auto &e = *it->second;
+		if (compress) {
+			decode(e.data, e.num_nodes, parents);
+		} else {
+			parents.resize(e.num_nodes);
+			std::copy(e.data.begin(), e.data.end(), reinterpret_cast<unsigned char *>(parents.data()));
+		}
+		return true;
+	}
+
+	/**
+	 * @brief Stores the parents of a run, evicting the least recently used entries to fit the budget.
+	 */
+	void put(const bfs_cache_key_t &key, const std::vector<nodeid_t> &parents) {
+		entry_t e{key, parents.size(), {}};
+		if (compress) {
+			encode(parents, e.data);
+		} else {
+			auto p = reinterpret_cast<const unsigned char *>(parents.data());
+			e.data.assign(p, p + parents.size() * sizeof(nodeid_t));
+		}
+		size_t size = entry_size(e);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = index.find(key);
+		if (it != index.end()) erase(it->second);
+		if (size > budget) return;
+		while (bytes + size > budget) {
+			erase(std::prev(entries.end()));
+			evictions++;
+		}
+		entries.push_front(std::move(e));
+		index[key] = entries.begin();
+		bytes += size;
+	}
+
+	/**
+	 * @brief Drops every entry of a graph content.
+	 */
+	void invalidate(const graph_key_t &graph) {
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto it = entries.begin(); it != entries.end();) {
+			auto next = std::next(it);
+			if (it->key.graph == graph) erase(it);
+			it = next;
+		}
+	}
+
+	void clear() {
+		std::lock_guard<std::mutex> lock(mutex);
+		entries.clear();
+		index.clear();
+		bytes = 0;
+	}
+
+	cache_stats_t stats() const {
+		std::lock_guard<std::mutex> lock(mutex);
+		size_t lookups = hits + misses;
+		return cache_stats_t{hits, misses, evictions, entries.size(), bytes, lookups > 0 ? static_cast<float>(hits) / lookups : 0};
+	}
+
+private:
+	typedef struct {
+		bfs_cache_key_t key;
+		size_t num_nodes;
+		std::vector<unsigned char> data;
+	} entry_t;
+
+	struct key_hash_t {
+		size_t operator()(const bfs_cache_key_t &k) const {
+			return k.graph.hash ^ (static_cast<uint64_t>(k.source) * 0x9e3779b97f4a7c15ull) ^ k.label_mask ^ k.forest;
+		}
+	};
+	struct key_equal_t {
+		bool operator()(const bfs_cache_key_t &a, const bfs_cache_key_t &b) const {
+			return a.graph == b.graph && a.source == b.source && a.forest == b.forest && a.label_mask == b.label_mask;
+		}
+	};
+
+	size_t budget;
+	bool compress;
+	mutable std::mutex mutex;
+	std::list<entry_t> entries; // most recently used first
+	std::unordered_map<bfs_cache_key_t, std::list<entry_t>::iterator, key_hash_t, key_equal_t> index;
+	size_t bytes = 0, hits = 0, misses = 0, evictions = 0;
+
+	static size_t entry_size(const entry_t &e) {
+		// the list node and the index slot are counted too, so many tiny entries still respect the budget
+		return e.data.size() + sizeof(entry_t) + 4 * sizeof(void *);
+	}
+
+	void erase(std::list<entry_t>::iterator it) {
+		bytes -= entry_size(*it);
+		index.erase(it->key);
+		entries.erase(it);
+	}
+
+	static void encode(const std::vector<nodeid_t> &parents, std::vector<unsigned char> &out) {
+		out.reserve(parents.size() * 2);
+		for (size_t v = 0; v < parents.size(); v++) {
+			int64_t delta = static_cast<int64_t>(parents[v]) - static_cast<int64_t>(v);
+			uint64_t z = (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63);
+			while (z >= 0x80) {
+				out.push_back(static_cast<unsigned char>(z) | 0x80);
+				z >>= 7;
+			}
+			out.push_back(static_cast<unsigned char>(z));
+		}
+		out.shrink_to_fit();
+	}
+
+	static void decode(const std::vector<unsigned char> &in, size_t num_nodes, std::vector<nodeid_t> &parents) {
+		parents.resize(num_nodes);
+		size_t pos = 0;
+		for (size_t v = 0; v < num_nodes; v++) {
+			uint64_t z = 0;
+			for (int shift = 0; ; shift += 7) {
+				unsigned char b = in[pos++];
+				z |= static_cast<uint64_t>(b & 0x7f) << shift;
+				if (!(b & 0x80)) break;
+			}
+			int64_t delta = static_cast<int64_t>(z >> 1) ^ -static_cast<int64_t>(z & 1);
+			parents[v] = static_cast<nodeid_t>(static_cast<int64_t>(v) + delta);
+		}
+	}
+};
+
+#endif
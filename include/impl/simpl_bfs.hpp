@@ -11,6 +11,7 @@
 #include "host_data.hpp"
 #include "kernel_sizes.hpp"
 #include "sycl_data.hpp"
+#include "memory_pool.hpp"
 #include "benchmark.hpp"
 
 namespace s = sycl;
@@ -20,7 +21,7 @@ namespace s = sycl;
 class SingleBFSOperator
 {
 public:
-	virtual void operator()(sycl::queue &queue, SYCL_SimpleGraphData &data, std::vector<sycl::event> &events) = 0;
+	virtual void operator()(sycl::queue &queue, MemoryPool &pool, SYCL_SimpleGraphData &data, std::vector<sycl::event> &events) = 0;
 };
 
 class SingleBFS
@@ -28,21 +29,24 @@ class SingleBFS
 private:
 	CSRHostData &data;
 	std::shared_ptr<SingleBFSOperator> op;
+	sycl::queue queue;
+	MemoryPool pool;
 
 public:
-	SingleBFS(CSRHostData &data, std::shared_ptr<SingleBFSOperator> op) : data(data), op(op) {}
+	SingleBFS(CSRHostData &data, std::shared_ptr<SingleBFSOperator> op) : 
+		data(data), op(op),
+		queue(sycl::gpu_selector_v, sycl::property_list{sycl::property::queue::enable_profiling{}}),
+		pool(queue) {}
 
-	bench_time_t run(nodeid_t source = 0) {
-		// SYCL queue definition
-		sycl::queue queue(sycl::gpu_selector_v,
-											sycl::property_list{sycl::property::queue::enable_profiling{}});
+	MemoryPool &get_pool() { return pool; }
 
+	bench_time_t run(nodeid_t source = 0) {
 		SYCL_SimpleGraphData sycl_data(data);
 		sycl_data.init(queue, source);
 		std::vector<sycl::event> events;
 
 		auto start_glob = std::chrono::high_resolution_clock::now();
-		(*op)(queue, sycl_data, events);
+		(*op)(queue, pool, sycl_data, events);
 		auto end_glob = std::chrono::high_resolution_clock::now();
 
 		long duration = 0;
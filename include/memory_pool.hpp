@@ -0,0 +1,248 @@
+#ifndef __MEMORY_POOL_HPP__
+#define __MEMORY_POOL_HPP__
+
+#include <sycl/sycl.hpp>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+typedef struct {
+	size_t bytes_in_use = 0;   // bytes currently handed out to the operators
+	size_t bytes_reserved = 0; // bytes allocated from the runtime, in use or cached
+	size_t high_water = 0;     // peak of bytes_in_use
+	size_t allocations = 0;    // number of requests served
+	size_t reuses = 0;         // requests served from a free list
+} pool_stats_t;
+
+/**
+ * @brief USM scratch memory pool bound to a queue.
+ *
+ * Requests are rounded up to power-of-two size classes and released blocks are kept on a free
+ * list per (allocation kind, size class), so repeated BFS invocations on the same queue reuse
+ * the same device, shared and host blocks instead of calling malloc_* / free every run.
+ * Cached blocks are returned to the runtime on release() or when the pool is destroyed.
+ */
+class MemoryPool
+{
+public:
+	static constexpr size_t MIN_CLASS_BYTES = 256;
+	static constexpr size_t NUM_CLASSES = 48;
+
+	MemoryPool(sycl::queue &queue) : queue(queue) {}
+	MemoryPool(const MemoryPool &) = delete;
+	MemoryPool &operator=(const MemoryPool &) = delete;
+
+	~MemoryPool() { release(); }
+
+	/**
+	 * @brief Gets a block of at least count elements of type T.
+	 * @param count The number of elements.
+	 * @param kind The USM allocation kind (device, shared or host).
+	 */
+	template <typename T>
+	T *allocate(size_t count, sycl::usm::alloc kind = sycl::usm::alloc::device)
+	{
+		size_t cls = size_class(count * sizeof(T));
+		size_t k = kind_index(kind);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		collect_pending();
+		void *ptr;
+		auto &free_list = free_lists[k][cls];
+		if (!free_list.empty())
+		{
+			ptr = free_list.back();
+			free_list.pop_back();
+			stats_[k].reuses++;
+		}
+		else
+		{
+			ptr = sycl::malloc(class_bytes(cls), queue, kind);
+			if (ptr == nullptr)
+			{
+				throw sycl::exception(sycl::make_error_code(sycl::errc::memory_allocation), "MemoryPool: allocation failed");
+			}
+			stats_[k].bytes_reserved += class_bytes(cls);
+		}
+
+		live[ptr] = block_t{k, cls};
+		stats_[k].allocations++;
+		stats_[k].bytes_in_use += class_bytes(cls);
+		stats_[k].high_water = std::max(stats_[k].high_water, stats_[k].bytes_in_use);
+		return static_cast<T *>(ptr);
+	}
+
+	/**
+	 * @brief Gives a block back to its free list. The caller must make sure no kernel still uses it.
+	 */
+	void deallocate(void *ptr)
+	{
+		if (ptr == nullptr) return;
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = live.find(ptr);
+		if (it == live.end())
+		{
+			throw sycl::exception(sycl::make_error_code(sycl::errc::invalid), "MemoryPool: pointer not owned by the pool");
+		}
+		recycle(it);
+	}
+
+	/**
+	 * @brief Gives a block back once the given event has completed, without waiting for it.
+	 *
+	 * The block stays out of the free lists until a later allocate() sees the event complete.
+	 */
+	void deallocate_after(void *ptr, sycl::event e)
+	{
+		if (ptr == nullptr) return;
+		std::lock_guard<std::mutex> lock(mutex);
+		if (live.find(ptr) == live.end())
+		{
+			throw sycl::exception(sycl::make_error_code(sycl::errc::invalid), "MemoryPool: pointer not owned by the pool");
+		}
+		pending.push_back(std::make_pair(ptr, e));
+	}
+
+	/**
+	 * @brief Frees every cached block, after waiting for the ones released with deallocate_after(). Blocks still in use are left untouched.
+	 */
+	void release()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto &p : pending) p.second.wait();
+		collect_pending();
+		for (size_t k = 0; k < free_lists.size(); k++)
+		{
+			for (size_t cls = 0; cls < NUM_CLASSES; cls++)
+			{
+				for (void *ptr : free_lists[k][cls])
+				{
+					sycl::free(ptr, queue);
+					stats_[k].bytes_reserved -= class_bytes(cls);
+				}
+				free_lists[k][cls].clear();
+			}
+		}
+	}
+
+	pool_stats_t stats(sycl::usm::alloc kind) const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return stats_[kind_index(kind)];
+	}
+
+	/**
+	 * @brief Restarts the high water mark of an allocation kind from the bytes currently in use, e.g. to measure one batch.
+	 */
+	void reset_high_water(sycl::usm::alloc kind)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto &stats = stats_[kind_index(kind)];
+		stats.high_water = stats.bytes_in_use;
+	}
+
+	sycl::queue &get_queue() { return queue; }
+
+private:
+	typedef struct {
+		size_t kind;
+		size_t cls;
+	} block_t;
+
+	void recycle(std::unordered_map<void *, block_t>::iterator it)
+	{
+		auto block = it->second;
+		free_lists[block.kind][block.cls].push_back(it->first);
+		stats_[block.kind].bytes_in_use -= class_bytes(block.cls);
+		live.erase(it);
+	}
+
+	// moves the blocks whose last kernel has completed to their free list
+	void collect_pending()
+	{
+		size_t kept = 0;
+		for (auto &p : pending)
+		{
+			if (p.second.get_info<sycl::info::event::command_execution_status>() == sycl::info::event_command_status::complete)
+			{
+				recycle(live.find(p.first));
+			}
+			else
+			{
+				pending[kept++] = p;
+			}
+		}
+		pending.resize(kept);
+	}
+
+	static size_t size_class(size_t bytes)
+	{
+		size_t cls = 0;
+		while (class_bytes(cls) < bytes) cls++;
+		return cls;
+	}
+
+	static size_t class_bytes(size_t cls) { return MIN_CLASS_BYTES << cls; }
+
+	static size_t kind_index(sycl::usm::alloc kind)
+	{
+		switch (kind)
+		{
+		case sycl::usm::alloc::host: return 0;
+		case sycl::usm::alloc::shared: return 1;
+		default: return 2;
+		}
+	}
+
+	sycl::queue &queue;
+	mutable std::mutex mutex;
+	std::array<std::array<std::vector<void *>, NUM_CLASSES>, 3> free_lists;
+	std::array<pool_stats_t, 3> stats_;
+	std::unordered_map<void *, block_t> live;
+	std::vector<std::pair<void *, sycl::event>> pending;
+};
+
+/**
+ * @brief RAII handle to a pool block, returned to the pool when it goes out of scope.
+ */
+template <typename T>
+class ScratchBuffer
+{
+public:
+	ScratchBuffer(MemoryPool &pool, size_t count, sycl::usm::alloc kind = sycl::usm::alloc::device) :
+		pool(pool), ptr(pool.allocate<T>(count, kind)), count(count) {}
+	ScratchBuffer(const ScratchBuffer &) = delete;
+	ScratchBuffer &operator=(const ScratchBuffer &) = delete;
+
+	~ScratchBuffer()
+	{
+		if (has_release_event) pool.deallocate_after(ptr, release_event);
+		else pool.deallocate(ptr);
+	}
+
+	/**
+	 * @brief Lets the destructor return the block without waiting: the pool reuses it only once e has completed.
+	 */
+	void release_after(sycl::event e)
+	{
+		release_event = e;
+		has_release_event = true;
+	}
+
+	T *get() const { return ptr; }
+	size_t size() const { return count; }
+	T &operator[](size_t i) const { return ptr[i]; }
+
+private:
+	MemoryPool &pool;
+	T *ptr;
+	size_t count;
+	sycl::event release_event;
+	bool has_release_event = false;
+};
+
+#endif
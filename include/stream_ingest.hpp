@@ -0,0 +1,348 @@
+/**
+ * @file stream_ingest.hpp
+ * @brief Builds the CSR of a graph while it is read from a stream, uploading it as it is parsed.
+ */
+#ifndef __STREAM_INGEST_HPP__
+#define __STREAM_INGEST_HPP__
+
+#include <sycl/sycl.hpp>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <istream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "types.hpp"
+#include "host_data.hpp"
+#include "sycl_data.hpp"
+
+typedef struct {
+	size_t num_nodes;
+	size_t num_edges;
+	size_t bytes;      // bytes read after the header
+	bool sorted;       // whether the edges arrived grouped by source, so the upload overlapped the parsing
+	float read_time;   // us, until the last byte was read
+	float total_time;  // us, until the CSR was complete on the host and on the device
+} ingest_stats_t;
+
+/**
+ * Builds the CSR of a graph while it is read from a stream (stdin, a pipe or a file) in the .dat
+ * format: "<num_nodes> <num_edges>" followed by the "<src> <dst>" edges.
+ *
+ * A reader thread cuts the stream in blocks at line boundaries, a set of threads parses the blocks,
+ * and the calling thread places the parsed edges in stream order straight into a one-graph arena.
+ * When the edges arrive grouped by source (as in the .dat files) each placed block finishes a range
+ * of offsets and edges, which is copied to the device right away while the next blocks are parsed.
+ * Once a source arrives out of order the incremental uploads stop: the CSR is built with a counting
+ * sort when the stream is over, after the copies in flight have read the host arrays, and uploaded
+ * whole, so the ranges copied before the switch are uploaded a second time.
+ */
+class StreamingGraphIngest
+{
+public:
+	static constexpr size_t DEFAULT_BLOCK_SIZE = 4 << 20;
+
+	/**
+	 * @param in The stream to read, left at its end.
+	 * @param queue The queue the uploads are submitted to.
+	 * @param block_size The bytes read at a time.
+	 * @param num_threads The parser threads, 0 means hardware concurrency.
+	 */
+	StreamingGraphIngest(std::istream &in, sycl::queue &queue, size_t block_size = DEFAULT_BLOCK_SIZE, size_t num_threads = 0) :
+		in(in), queue(queue), block_size(block_size),
+		num_threads(num_threads > 0 ? num_threads : std::max<size_t>(1, std::thread::hardware_concurrency())) {}
+
+	/**
+	 * Reads the whole stream and returns once the CSR is on the host and on the device.
+	 */
+	ingest_stats_t ingest()
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		size_t num_nodes, num_edges;
+		if (!(in >> num_nodes >> num_edges)) {
+			throw std::runtime_error("StreamingGraphIngest: missing header");
+		}
+		arena = std::make_unique<CompressedHostData>(std::vector<size_t>{num_nodes}, std::vector<size_t>{num_edges});
+		device_offsets = std::make_unique<sycl::buffer<size_t, 1>>(sycl::range{num_nodes + 1});
+		device_edges = std::make_unique<sycl::buffer<nodeid_t, 1>>(sycl::range{std::max<size_t>(1, num_edges)});
+
+		stats = ingest_stats_t{num_nodes, num_edges, 0, true, 0, 0};
+		offsets = arena->compressed_offsets.data();
+		edges = arena->compressed_edges.data();
+		placed = 0;
+		next_node = 0;
+		uploaded_nodes = 0;
+		uploaded_edges = 0;
+		has_carry = false;
+		last_src = 0;
+		srcs.clear();
+		uploads.clear();
+
+		std::thread reader([&]() { read_blocks(); });
+		std::vector<std::thread> parsers;
+		for (size_t t = 0; t < num_threads; t++) parsers.emplace_back([&]() { parse_blocks(); });
+
+		try {
+			for (size_t seq = 0; ; seq++) {
+				std::vector<nodeid_t> tokens;
+				if (!next_parsed(seq, tokens)) break;
+				place(tokens);
+			}
+		} catch (...) {
+			abort_pipeline();
+			reader.join();
+			for (auto &p : parsers) p.join();
+			throw;
+		}
+		reader.join();
+		for (auto &p : parsers) p.join();
+		if (!error.empty()) throw std::runtime_error(error);
+		if (placed != num_edges || has_carry) {
+			throw std::runtime_error("StreamingGraphIngest: expected " + std::to_string(num_edges) + " edges, read " + std::to_string(placed));
+		}
+
+		if (stats.sorted) {
+			while (next_node <= num_nodes) offsets[next_node++] = num_edges;
+			upload(num_nodes + 1, num_edges);
+		} else {
+			build_unsorted();
+			uploaded_nodes = uploaded_edges = 0;
+			upload(num_nodes + 1, num_edges);
+		}
+		sycl::event::wait_and_throw(uploads);
+
+		stats.total_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+		return stats;
+	}
+
+	/**
+	 * The graph as a one-graph arena; its parents are filled by the runs on the device data.
+	 */
+	CompressedHostData &host() { return *arena; }
+
+	/**
+	 * The device copy of the graph, adopting the buffers written during ingest().
+	 */
+	SYCL_CompressedGraphData device(bool with_components = false)
+	{
+		return SYCL_CompressedGraphData(*arena, *device_offsets, *device_edges, with_components);
+	}
+
+private:
+	typedef struct {
+		size_t seq;
+		std::string text;
+	} block_t;
+
+	std::istream &in;
+	sycl::queue &queue;
+	size_t block_size, num_threads;
+
+	std::unique_ptr<CompressedHostData> arena;
+	std::unique_ptr<sycl::buffer<size_t, 1>> device_offsets;
+	std::unique_ptr<sycl::buffer<nodeid_t, 1>> device_edges;
+	std::vector<sycl::event> uploads;
+	ingest_stats_t stats;
+
+	// pipeline state, the queues are bounded so a fast reader does not buffer the whole stream
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::deque<block_t> raw;
+	std::map<size_t, std::vector<nodeid_t>> parsed;
+	size_t total_blocks = SIZE_MAX;
+	bool aborted = false;
+	std::string error;
+
+	// placement state, owned by the calling thread
+	size_t *offsets;
+	nodeid_t *edges;
+	std::vector<nodeid_t> srcs; // sources in stream order, kept only once the stream turns out unsorted
+	size_t placed, next_node, uploaded_nodes, uploaded_edges;
+	nodeid_t carry, last_src;
+	bool has_carry;
+
+	size_t max_in_flight() const { return 2 * num_threads; }
+
+	void read_blocks()
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		std::string rest;
+		size_t seq = 0;
+		while (true) {
+			std::string text = std::move(rest);
+			size_t old_size = text.size();
+			text.resize(old_size + block_size);
+			in.read(&text[old_size], block_size);
+			text.resize(old_size + in.gcount());
+			bool last = in.gcount() == 0 || !in;
+			stats.bytes += in.gcount();
+
+			if (!last) {
+				// the tail after the last separator belongs to the next block
+				size_t cut = text.find_last_of(" \t\r\n");
+				if (cut == std::string::npos) cut = 0;
+				else cut++;
+				rest.assign(text, cut, std::string::npos);
+				text.resize(cut);
+			}
+
+			std::unique_lock<std::mutex> lock(mutex);
+			cv.wait(lock, [&]() { return aborted || raw.size() + parsed.size() < max_in_flight(); });
+			if (aborted) return;
+			raw.push_back(block_t{seq++, std::move(text)});
+			if (last) {
+				total_blocks = seq;
+				stats.read_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+				cv.notify_all();
+				return;
+			}
+			cv.notify_all();
+		}
+	}
+
+	void parse_blocks()
+	{
+		while (true) {
+			block_t block;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				cv.wait(lock, [&]() { return aborted || !raw.empty() || total_blocks != SIZE_MAX; });
+				if (aborted || raw.empty()) return;
+				block = std::move(raw.front());
+				raw.pop_front();
+			}
+
+			std::vector<nodeid_t> tokens;
+			tokens.reserve(block.text.size() / 4);
+			const char *p = block.text.data(), *end = p + block.text.size();
+			bool bad = false;
+			while (p < end) {
+				while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++;
+				if (p == end) break;
+				if (*p < '0' || *p > '9') {
+					bad = true;
+					break;
+				}
+				nodeid_t v = 0;
+				while (p < end && *p >= '0' && *p <= '9') v = v * 10 + (*p++ - '0');
+				tokens.push_back(v);
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (bad && error.empty()) error = "StreamingGraphIngest: unexpected character in block " + std::to_string(block.seq);
+			parsed[block.seq] = std::move(tokens);
+			cv.notify_all();
+		}
+	}
+
+	bool next_parsed(size_t seq, std::vector<nodeid_t> &tokens)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		cv.wait(lock, [&]() { return parsed.count(seq) || seq >= total_blocks; });
+		if (!error.empty()) throw std::runtime_error(error);
+		if (!parsed.count(seq)) return false;
+		tokens = std::move(parsed[seq]);
+		parsed.erase(seq);
+		cv.notify_all();
+		return true;
+	}
+
+	void abort_pipeline()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		aborted = true;
+		cv.notify_all();
+	}
+
+	// appends the edges of a block, in stream order, and uploads the ranges they finished
+	void place(const std::vector<nodeid_t> &tokens)
+	{
+		size_t i = 0;
+		if (has_carry && !tokens.empty()) {
+			place_edge(carry, tokens[0]);
+			has_carry = false;
+			i = 1;
+		}
+		for (; i + 1 < tokens.size(); i += 2) place_edge(tokens[i], tokens[i + 1]);
+		if (i < tokens.size()) {
+			carry = tokens[i];
+			has_carry = true;
+		}
+		// offsets[v] is final for every v < next_node, and the edges never move once placed
+		if (stats.sorted) upload(next_node, placed);
+	}
+
+	void place_edge(nodeid_t src, nodeid_t dst)
+	{
+		if (placed >= stats.num_edges || src >= stats.num_nodes || dst >= stats.num_nodes) {
+			throw std::runtime_error("StreamingGraphIngest: edge " + std::to_string(src) + " " + std::to_string(dst) + " out of the header bounds");
+		}
+		if (stats.sorted && src < last_src) {
+			// from now on the sources are kept for the counting sort
+			stats.sorted = false;
+			srcs.reserve(stats.num_edges);
+			for (size_t v = 0; v + 1 < next_node; v++) {
+				srcs.insert(srcs.end(), offsets[v + 1] - offsets[v], v);
+			}
+			srcs.insert(srcs.end(), placed - srcs.size(), last_src);
+		}
+		if (stats.sorted) {
+			while (next_node <= (size_t)src) offsets[next_node++] = placed;
+			last_src = src;
+		} else {
+			srcs.push_back(src);
+		}
+		edges[placed++] = dst;
+	}
+
+	void build_unsorted()
+	{
+		// the copies submitted while the stream looked sorted read the arrays sorted in place below
+		sycl::event::wait_and_throw(uploads);
+		uploads.clear();
+
+		size_t n = stats.num_nodes, m = stats.num_edges;
+		std::vector<size_t> counts(n + 1, 0);
+		for (size_t e = 0; e < m; e++) counts[srcs[e] + 1]++;
+		for (size_t v = 0; v < n; v++) counts[v + 1] += counts[v];
+		std::copy(counts.begin(), counts.end(), offsets);
+
+		std::vector<nodeid_t> sorted(m);
+		for (size_t e = 0; e < m; e++) sorted[counts[srcs[e]]++] = edges[e];
+		std::copy(sorted.begin(), sorted.end(), edges);
+		srcs.clear();
+		srcs.shrink_to_fit();
+	}
+
+	// copies offsets [uploaded_nodes, nodes) and edges [uploaded_edges, num_edges) to the device
+	void upload(size_t nodes, size_t num_edges)
+	{
+		if (nodes > uploaded_nodes) {
+			size_t first = uploaded_nodes, count = nodes - uploaded_nodes;
+			const size_t *src = offsets + first;
+			uploads.push_back(queue.submit([&](sycl::handler &h) {
+				sycl::accessor acc{*device_offsets, h, sycl::range{count}, sycl::id{first}, sycl::write_only};
+				h.copy(src, acc);
+			}));
+			uploaded_nodes = nodes;
+		}
+		if (num_edges > uploaded_edges) {
+			size_t first = uploaded_edges, count = num_edges - uploaded_edges;
+			const nodeid_t *src = edges + first;
+			uploads.push_back(queue.submit([&](sycl::handler &h) {
+				sycl::accessor acc{*device_edges, h, sycl::range{count}, sycl::id{first}, sycl::write_only};
+				h.copy(src, acc);
+			}));
+			uploaded_edges = num_edges;
+		}
+	}
+};
+
+#endif
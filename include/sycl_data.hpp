@@ -1,17 +1,75 @@
 #include <sycl/sycl.hpp>
+#include <algorithm>
+#include <memory>
 #include <vector>
 #include <string>
 #include "host_data.hpp"
 #include "kernel_sizes.hpp"
 #include "types.hpp"
+#include "benchmark.hpp"
 
 #ifndef __SYCL_DATA_HPP__
 #define __SYCL_DATA_HPP__
 
+/**
+ * Copies the sources into a buffer owned by the graph data. Unlike a temporary buffer, it does not
+ * block init() until the kernel is over; the sources vector must outlive the copy.
+ */
+inline void upload_sources(sycl::queue &q, sycl::buffer<nodeid_t, 1> &sources_buf, const std::vector<nodeid_t> &sources)
+{
+	q.submit([&](sycl::handler &h) {
+		sycl::accessor sources_acc{sources_buf, h, sycl::write_only, sycl::no_init};
+		h.copy(sources.data(), sources_acc);
+	});
+}
+
+/**
+ * Copies a host array into a whole buffer with an explicit command, so the copy has its own profiled event.
+ */
+template <typename T>
+void upload_buffer(sycl::queue &q, sycl::buffer<T, 1> &buf, const T *src, std::vector<sycl::event> &events, size_t &bytes)
+{
+	events.push_back(q.submit([&](sycl::handler &h) {
+		sycl::accessor acc{buf, h, sycl::write_only, sycl::no_init};
+		h.copy(src, acc);
+	}));
+	bytes += buf.byte_size();
+}
+
+/**
+ * Copies a whole buffer into a host array with an explicit command, see upload_buffer.
+ */
+template <typename T>
+void download_buffer(sycl::queue &q, sycl::buffer<T, 1> &buf, T *dst, std::vector<sycl::event> &events, size_t &bytes)
+{
+	events.push_back(q.submit([&](sycl::handler &h) {
+		sycl::accessor acc{buf, h, sycl::read_only};
+		h.copy(acc, dst);
+	}));
+	bytes += buf.byte_size();
+}
+
+/**
+ * Sums the profiled time of completed copies, their queue must have profiling enabled.
+ */
+inline transfer_stats_t profile_transfers(const std::vector<sycl::event> &events, size_t bytes)
+{
+	transfer_stats_t stats;
+	stats.bytes = bytes;
+	stats.copies = events.size();
+	for (auto &e : events)
+	{
+		auto start = e.get_profiling_info<sycl::info::event_profiling::command_start>();
+		auto end = e.get_profiling_info<sycl::info::event_profiling::command_end>();
+		stats.time += static_cast<float>(end - start) / 1000;
+	}
+	return stats;
+}
+
 class SYCL_VectorizedGraphData
 {
 public:
-	SYCL_VectorizedGraphData(std::vector<CSRHostData> &data) : data(data)
+	SYCL_VectorizedGraphData(std::vector<CSRHostData> &data) : data(data), sources_buf(sycl::range{data.size()})
 	{
 
 		for (auto &d : data)
@@ -19,13 +77,54 @@ public:
 			offsets.push_back(sycl::buffer<size_t, 1>{d.csr.offsets.data(), sycl::range{d.csr.offsets.size()}});
 			edges.push_back(sycl::buffer<nodeid_t, 1>{d.csr.edges.data(), sycl::range{d.csr.edges.size()}});
 			parents.push_back(sycl::buffer<nodeid_t, 1>{d.parents.data(), sycl::range{d.parents.size()}});
+			// the graphs are only read on the device, and the parents are copied back by write_back() only
+			offsets.back().set_write_back(false);
+			edges.back().set_write_back(false);
+			parents.back().set_write_back(false);
+		}
+	}
+
+	/**
+	 * Device bytes a graph takes in a batch, estimated before it is uploaded. The vectorized
+	 * representation has no components buffer, so the forest flag of the signature is ignored.
+	 */
+	static size_t footprint(const CSRHostData &g, bool /*with_components*/ = false)
+	{
+		return (g.num_nodes + 1) * sizeof(size_t) + g.csr.edges.size() * sizeof(nodeid_t) + g.num_nodes * sizeof(nodeid_t) + sizeof(nodeid_t);
+	}
+
+	/**
+	 * Copies the graphs to the device with explicit copies, recorded in upload_events, instead of
+	 * leaving them to the first kernel that reads them.
+	 */
+	void upload(sycl::queue &q)
+	{
+		upload_events.clear();
+		upload_bytes = 0;
+		for (int i = 0; i < data.size(); i++)
+		{
+			upload_buffer(q, offsets[i], data[i].csr.offsets.data(), upload_events, upload_bytes);
+			upload_buffer(q, edges[i], data[i].csr.edges.data(), upload_events, upload_bytes);
 		}
 	}
 
+	/**
+	 * Device bytes of the buffers of the batch.
+	 */
+	size_t device_bytes() const
+	{
+		size_t bytes = sources_buf.byte_size();
+		for (int i = 0; i < data.size(); i++)
+		{
+			bytes += offsets[i].byte_size() + edges[i].byte_size() + parents[i].byte_size();
+		}
+		return bytes;
+	}
+
 	sycl::event init(sycl::queue &q, const std::vector<nodeid_t> &sources, size_t wg_size = DEFAULT_WORK_GROUP_SIZE)
 	{
 		size_t num_graphs = data.size();
-		sycl::buffer<nodeid_t, 1> device_source{sources.data(), sycl::range{sources.size()}};
+		upload_sources(q, sources_buf, sources);
 
 		sycl::accessor<size_t, 1, sycl::access::mode::read> offsets_acc[MAX_PARALLEL_GRAPHS];
 		sycl::accessor<nodeid_t, 1, sycl::access::mode::read> edges_acc[MAX_PARALLEL_GRAPHS];
@@ -44,7 +143,7 @@ public:
         n_nodes[i] = data[i].num_nodes;
       } 
 
-			sycl::accessor sources{device_source, cgh, sycl::read_only};
+			sycl::accessor sources{sources_buf, cgh, sycl::read_only};
 
 			cgh.parallel_for(sycl::nd_range<1>{global, local}, [=](sycl::nd_item<1> item) {
 				auto gid = item.get_group_linear_id();
@@ -65,44 +164,116 @@ public:
 		});
 	}
 
-	void write_back()
+	/**
+	 * Copies the parents back to the graphs, the copies are recorded in download_events.
+	 */
+	void write_back(sycl::queue &q)
 	{
+		download_events.clear();
+		download_bytes = 0;
+		// the host vectors back the buffers, so the parents land in staging arrays first
+		std::vector<std::vector<nodeid_t>> staging(data.size());
+		for (int i = 0; i < data.size(); i++)
+		{
+			staging[i].resize(data[i].parents.size());
+			download_buffer(q, parents[i], staging[i].data(), download_events, download_bytes);
+		}
+		sycl::event::wait_and_throw(download_events);
 		for (int i = 0; i < data.size(); i++)
 		{
-			auto &d = data[i];
-			parents[i].set_final_data(d.parents.data());
-			parents[i].set_write_back(true);
+			std::copy(staging[i].begin(), staging[i].end(), data[i].parents.begin());
 		}
 	}
 
 	std::vector<CSRHostData> &data;
+	sycl::buffer<nodeid_t, 1> sources_buf;
 	std::vector<sycl::buffer<size_t, 1>> offsets;
 	std::vector<sycl::buffer<nodeid_t, 1>> edges;
 	std::vector<sycl::buffer<nodeid_t, 1>> parents;
+	std::vector<sycl::event> upload_events, download_events; // of the last upload() and write_back()
+	size_t upload_bytes = 0, download_bytes = 0;
 };
 
 
 class SYCL_CompressedGraphData
 {
 public:
-	SYCL_CompressedGraphData(CompressedHostData &data) : 
+	SYCL_CompressedGraphData(CompressedHostData &data, bool with_components = false) : 
 		host_data(data),
+		with_components(with_components),
+		components(sycl::range{with_components ? data.compressed_parents.size() : 1}),
 		nodes_offsets(sycl::buffer<size_t, 1>(data.nodes_offsets.data(), sycl::range{data.nodes_offsets.size()})),
 		graphs_offests(sycl::buffer<size_t, 1>(data.graphs_offsets.data(), sycl::range{data.graphs_offsets.size()})),
 		nodes_count(sycl::buffer<size_t, 1>(data.nodes_count.data(), sycl::range{data.nodes_count.size()})),
 		edges_offsets(sycl::buffer<size_t, 1>{data.compressed_offsets.data(), sycl::range{data.compressed_offsets.size()}}),
 		edges(sycl::buffer<nodeid_t, 1>{data.compressed_edges.data(), sycl::range{data.compressed_edges.size()}}),
-		parents(sycl::buffer<nodeid_t, 1>{data.compressed_parents.data(), sycl::range{data.compressed_parents.size()}}) {}
+		parents(sycl::buffer<nodeid_t, 1>{data.compressed_parents.data(), sycl::range{data.compressed_parents.size()}}),
+		sources_buf(sycl::range{data.num_graphs}),
+		labels(labels_buffer(data))
+	{
+		// results are scattered explicitly by write_back()
+		labeled = !data.compressed_labels.empty();
+		parents.set_write_back(false);
+		edges_offsets.set_write_back(false);
+		edges.set_write_back(false);
+		disable_metadata_write_back();
+	}
+
+	/**
+	 * Adopts offsets and edges already resident on the device (e.g. uploaded while the graph was being
+	 * parsed), so the CSR arrays of data are not copied again.
+	 */
+	SYCL_CompressedGraphData(CompressedHostData &data, sycl::buffer<size_t, 1> device_offsets, sycl::buffer<nodeid_t, 1> device_edges, bool with_components = false) : 
+		host_data(data),
+		with_components(with_components),
+		components(sycl::range{with_components ? data.compressed_parents.size() : 1}),
+		nodes_offsets(sycl::buffer<size_t, 1>(data.nodes_offsets.data(), sycl::range{data.nodes_offsets.size()})),
+		graphs_offests(sycl::buffer<size_t, 1>(data.graphs_offsets.data(), sycl::range{data.graphs_offsets.size()})),
+		nodes_count(sycl::buffer<size_t, 1>(data.nodes_count.data(), sycl::range{data.nodes_count.size()})),
+		edges_offsets(device_offsets),
+		edges(device_edges),
+		parents(sycl::buffer<nodeid_t, 1>{data.compressed_parents.data(), sycl::range{data.compressed_parents.size()}}),
+		sources_buf(sycl::range{data.num_graphs}),
+		labels(labels_buffer(data)),
+		csr_resident(true)
+	{
+		labeled = !data.compressed_labels.empty();
+		parents.set_write_back(false);
+		disable_metadata_write_back();
+	}
+
+	/**
+	 * Runs some graphs of a resident batch, described by a view of its host data (see
+	 * CompressedHostData(arena, graphs)). The CSR, labels, parents and components buffers are those
+	 * of the resident batch, only the metadata of the view is uploaded.
+	 */
+	SYCL_CompressedGraphData(CompressedHostData &view, SYCL_CompressedGraphData &resident) :
+		host_data(view),
+		with_components(resident.with_components),
+		edges(resident.edges),
+		parents(resident.parents),
+		components(resident.components),
+		graphs_offests(sycl::buffer<size_t, 1>(view.graphs_offsets.data(), sycl::range{view.graphs_offsets.size()})),
+		nodes_offsets(sycl::buffer<size_t, 1>(view.nodes_offsets.data(), sycl::range{view.nodes_offsets.size()})),
+		nodes_count(sycl::buffer<size_t, 1>(view.nodes_count.data(), sycl::range{view.nodes_count.size()})),
+		edges_offsets(resident.edges_offsets),
+		sources_buf(sycl::range{view.num_graphs}),
+		labels(resident.labels),
+		csr_resident(true),
+		labeled(resident.labeled)
+	{
+		disable_metadata_write_back();
+	}
 
 	sycl::event init(sycl::queue &q, const std::vector<nodeid_t> &sources, size_t wg_size = DEFAULT_WORK_GROUP_SIZE)
 	{
-		sycl::buffer<nodeid_t, 1> device_source{sources.data(), sycl::range{sources.size()}};
+		upload_sources(q, sources_buf, sources);
 
 		return q.submit([&](sycl::handler &h) {
 			sycl::range global {host_data.num_graphs * wg_size};
 			sycl::range local {wg_size};
 
-			sycl::accessor sources {device_source, h, sycl::read_only};
+			sycl::accessor sources {sources_buf, h, sycl::read_only};
 			sycl::accessor nodes_acc{nodes_offsets, h, sycl::read_only};
 			sycl::accessor nodes_count_acc{nodes_count, h, sycl::read_only};
 			sycl::accessor parents_acc{parents, h, sycl::write_only, sycl::no_init};
@@ -124,20 +295,130 @@ public:
 		});
 	}
 
-	void write_back()
+	/**
+	 * Copies the parents (and the components in forest mode) back to the graphs, the copies are
+	 * recorded in download_events.
+	 */
+	void write_back(sycl::queue &q)
+	{
+		download_events.clear();
+		download_bytes = 0;
+		std::vector<nodeid_t> parents_host(host_data.compressed_parents.size());
+		std::vector<nodeid_t> components_host(with_components ? host_data.compressed_parents.size() : 0);
+		download_buffer(q, parents, parents_host.data(), download_events, download_bytes);
+		if (with_components)
+		{
+			download_buffer(q, components, components_host.data(), download_events, download_bytes);
+		}
+		sycl::event::wait_and_throw(download_events);
+
+		host_data.write_back(parents_host.data());
+		if (with_components)
+		{
+			host_data.write_back_components(components_host.data());
+		}
+	}
+
+	/**
+	 * Copies the graphs to the device with explicit copies, recorded in upload_events, instead of
+	 * leaving them to the first kernel that reads them. Adopted CSR arrays are already there.
+	 */
+	void upload(sycl::queue &q)
+	{
+		upload_events.clear();
+		upload_bytes = 0;
+		if (!csr_resident)
+		{
+			upload_buffer(q, edges_offsets, host_data.compressed_offsets.data(), upload_events, upload_bytes);
+			upload_buffer(q, edges, host_data.compressed_edges.data(), upload_events, upload_bytes);
+		}
+		upload_buffer(q, nodes_offsets, host_data.nodes_offsets.data(), upload_events, upload_bytes);
+		upload_buffer(q, graphs_offests, host_data.graphs_offsets.data(), upload_events, upload_bytes);
+		upload_buffer(q, nodes_count, host_data.nodes_count.data(), upload_events, upload_bytes);
+		// the labels of a view are those of its resident batch
+		if (!host_data.compressed_labels.empty())
+		{
+			upload_buffer(q, labels, host_data.compressed_labels.data(), upload_events, upload_bytes);
+		}
+	}
+
+	/**
+	 * Builds the transposed graphs (CSC) on the host and uploads them the first time they are asked
+	 * for; they stay on the device with the CSR buffers, so every later run on this data reuses them.
+	 * The upload is recorded in upload_events.
+	 */
+	void ensure_transposed(sycl::queue &q)
 	{
-		auto pacc = parents.get_host_access();
-		for (int i = 0; i < host_data.compressed_parents.size(); i++)
+		if (csc_host) return;
+		csc_host = std::make_unique<CompressedHostData>(host_data.transposed());
+		csc_offsets = std::make_unique<sycl::buffer<size_t, 1>>(sycl::range{csc_host->compressed_offsets.size()});
+		csc_edges = std::make_unique<sycl::buffer<nodeid_t, 1>>(sycl::range{std::max<size_t>(1, csc_host->compressed_edges.size())});
+		upload_buffer(q, *csc_offsets, csc_host->compressed_offsets.data(), upload_events, upload_bytes);
+		if (!csc_host->compressed_edges.empty())
 		{
-			host_data.compressed_parents[i] = pacc[i];
+			upload_buffer(q, *csc_edges, csc_host->compressed_edges.data(), upload_events, upload_bytes);
 		}
+	}
+
+	/**
+	 * Device bytes a graph takes once it is packed in a batch, estimated before it is uploaded.
+	 */
+	static size_t footprint(const CSRHostData &g, bool with_components = false)
+	{
+		size_t n = g.num_nodes;
+		size_t bytes = (n + 1) * sizeof(size_t) + g.csr.edges.size() * sizeof(nodeid_t) + n * sizeof(nodeid_t); // offsets, edges, parents
+		bytes += 3 * sizeof(size_t) + sizeof(nodeid_t); // node offset, edge offset, node count and source
+		if (with_components) bytes += n * sizeof(nodeid_t);
+		if (g.labels.size() == n) bytes += n * sizeof(label_t);
+		return bytes;
+	}
 
-		host_data.write_back();
+	/**
+	 * Device bytes of the buffers of the batch.
+	 */
+	size_t device_bytes() const
+	{
+		size_t bytes = edges.byte_size() + parents.byte_size() + components.byte_size() +
+		       graphs_offests.byte_size() + nodes_offsets.byte_size() + nodes_count.byte_size() + edges_offsets.byte_size() +
+		       sources_buf.byte_size() + labels.byte_size();
+		if (csc_host) bytes += csc_offsets->byte_size() + csc_edges->byte_size();
+		return bytes;
 	}
 
+	/**
+	 * Whether the node labels were uploaded, see CompressedHostData::compressed_labels.
+	 */
+	bool has_labels() const { return labeled; }
+
 	CompressedHostData &host_data;
-	sycl::buffer<nodeid_t, 1> edges, parents;
+	bool with_components;
+	sycl::buffer<nodeid_t, 1> edges, parents, components;
 	sycl::buffer<size_t, 1> graphs_offests, nodes_offsets, nodes_count, edges_offsets;
+	sycl::buffer<nodeid_t, 1> sources_buf;
+	sycl::buffer<label_t, 1> labels; // a placeholder of one element when the graphs carry no labels
+	std::unique_ptr<CompressedHostData> csc_host;          // the transposed graphs once ensure_transposed() ran
+	std::unique_ptr<sycl::buffer<size_t, 1>> csc_offsets;
+	std::unique_ptr<sycl::buffer<nodeid_t, 1>> csc_edges;
+	std::vector<sycl::event> upload_events, download_events; // of the last upload() and write_back()
+	size_t upload_bytes = 0, download_bytes = 0;
+
+private:
+	bool csr_resident = false; // the offsets and edges were adopted from the device
+	bool labeled = false;
+
+	void disable_metadata_write_back()
+	{
+		nodes_offsets.set_write_back(false);
+		graphs_offests.set_write_back(false);
+		nodes_count.set_write_back(false);
+		labels.set_write_back(false);
+	}
+
+	static sycl::buffer<label_t, 1> labels_buffer(CompressedHostData &data)
+	{
+		if (data.compressed_labels.empty()) return sycl::buffer<label_t, 1>{sycl::range{1}};
+		return sycl::buffer<label_t, 1>{data.compressed_labels.data(), sycl::range{data.compressed_labels.size()}};
+	}
 };
 
 class SYCL_SimpleGraphData
@@ -160,6 +441,7 @@ public:
 	}
 
 	sycl::event init(sycl::queue &q, const nodeid_t source) {
+		this->source = source;
 		return q.submit([&](sycl::handler &h) {
 			sycl::accessor parents_acc{parents, h, sycl::write_only, sycl::no_init};
 
@@ -174,6 +456,7 @@ public:
 	}
 
 	size_t num_nodes;
+	nodeid_t source = 0;
 	CSRHostData &host_data;
 	sycl::buffer<nodeid_t, 1> parents, edges;
 	sycl::buffer<size_t, 1> edges_offsets;
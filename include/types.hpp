@@ -6,6 +6,17 @@
 
 typedef int nodeid_t;
 typedef uint8_t adjidx_t;
-typedef unsigned char tile_t;
+typedef uint32_t tile_t; // a word of a bit-packed adjacency matrix
+
+constexpr size_t TILE_SIZE = sizeof(tile_t) * 8;
+
+typedef int label_t;             // node label, as read from the graph files
+typedef uint64_t label_mask_t;   // set of labels: bit l stands for label l
+constexpr label_mask_t ALL_LABELS = ~label_mask_t(0);
+
+// whether a label is in a mask, labels out of [0, 64) never are
+inline bool label_matches(label_mask_t mask, label_t label) {
+	return label >= 0 && label < static_cast<label_t>(sizeof(label_mask_t) * 8) && ((mask >> label) & 1);
+}
 
 #endif
\ No newline at end of file
@@ -5,50 +5,166 @@
 #include <cstddef>
 #include <vector>
 #include <filesystem>
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
+#include <string>
 #include "types.hpp"
 #include "host_data.hpp"
+#include "host_parallel.hpp"
 
-CSRHostData readGraphFromFile(std::string filename, bool labels = false) {
-
-	size_t num_nodes;
-  size_t num_edges;
-
+// open a graph file and read its header, throws if the file cannot be opened or the header is malformed
+std::ifstream openGraphFile(const std::string &filename, size_t &num_nodes, size_t &num_edges) {
 	std::ifstream file(filename);
-	file >> num_nodes;
-  file >> num_edges;
-
-	std::vector<size_t> row_offsets(num_nodes + 1, 0);
-	std::vector<nodeid_t> parents(num_nodes, 0);
-	std::vector<nodeid_t> col_indices(num_edges, 0);
-	std::vector<int> node_labels(num_edges, 0);
+	if (!file) {
+		throw std::runtime_error("readGraph: cannot open " + filename);
+	}
+	if (!(file >> num_nodes >> num_edges)) {
+		throw std::runtime_error("readGraph: " + filename + " has no valid node and edge counts");
+	}
+	return file;
+}
 
+// parse the edge list of an opened graph file into pre-sized offsets (num_nodes + 1, zeroed) and edges (num_edges);
+// with labels the node labels preceding the edges are read into node_labels (num_nodes), or skipped if it is null.
+// Throws on a malformed label or edge and on an endpoint out of [0, num_nodes), before anything is written out of place
+void parseGraphBody(std::ifstream &file, const std::string &filename, size_t num_nodes, size_t num_edges, size_t *row_offsets, nodeid_t *col_indices, bool labels = false, label_t *node_labels = nullptr) {
 	if (labels) {
-		for (int i = 0; i < num_nodes; i++)
+		label_t label;
+		for (size_t i = 0; i < num_nodes; i++)
 		{
-			file >> node_labels[i];
+			if (!(file >> label)) {
+				throw std::runtime_error("readGraph: " + filename + " has a malformed label for node " + std::to_string(i));
+			}
+			if (node_labels != nullptr) node_labels[i] = label;
 		}
 	}
 
-	int src, dst;
-	for (int i = 0; i < num_edges; i++)
+	long long src, dst;
+	for (size_t i = 0; i < num_edges; i++)
 	{
-		file >> src >> dst;
+		if (!(file >> src >> dst)) {
+			throw std::runtime_error("readGraph: " + filename + " has a malformed or missing edge " + std::to_string(i));
+		}
+		if (src < 0 || dst < 0 || static_cast<size_t>(src) >= num_nodes || static_cast<size_t>(dst) >= num_nodes) {
+			throw std::runtime_error("readGraph: " + filename + " has an edge " + std::to_string(src) + " -> " + std::to_string(dst) + " out of its " + std::to_string(num_nodes) + " nodes");
+		}
 		row_offsets[src + 1]++;
-		col_indices[i] = dst;
+		col_indices[i] = static_cast<nodeid_t>(dst);
 	}
-	file.close();
 
-	for (int i = 1; i < row_offsets.size(); i++) {
+	for (size_t i = 1; i < num_nodes + 1; i++) {
 		row_offsets[i] += row_offsets[i - 1];
 	}
+}
+
+CSRHostData readGraphFromFile(std::string filename, bool labels = false) {
+
+	size_t num_nodes;
+  size_t num_edges;
+
+	std::ifstream file = openGraphFile(filename, num_nodes, num_edges);
 
 	CSRHostData ret;
-	ret.csr.offsets = row_offsets;
-	ret.csr.edges = col_indices;
+	ret.csr.offsets = std::vector<size_t>(num_nodes + 1, 0);
+	ret.csr.edges = std::vector<nodeid_t>(num_edges, 0);
 	ret.num_nodes = num_nodes;
-	ret.parents = parents;
+	ret.parents = std::vector<nodeid_t>(num_nodes, 0);
+	if (labels) ret.labels = std::vector<label_t>(num_nodes, 0);
+
+	parseGraphBody(file, filename, num_nodes, num_edges, ret.csr.offsets.data(), ret.csr.edges.data(), labels, labels ? ret.labels.data() : nullptr);
+	file.close();
 
 	return ret;
 }
 
-#endif
\ No newline at end of file
+// read many graph files, one per host thread at a time
+std::vector<CSRHostData> readGraphsFromFiles(const std::vector<std::string> &filenames, bool labels = false) {
+	std::vector<CSRHostData> ret(filenames.size());
+	host_parallel_for(filenames.size(), [&](size_t i) {
+		ret[i] = readGraphFromFile(filenames[i], labels);
+	});
+	return ret;
+}
+
+// read many graph files straight into a packed arena, without building the per-graph CSRs
+CompressedHostData readGraphsIntoArena(const std::vector<std::string> &filenames, bool labels = false) {
+	std::vector<size_t> node_counts(filenames.size()), edge_counts(filenames.size());
+
+	host_parallel_for(filenames.size(), [&](size_t i) {
+		openGraphFile(filenames[i], node_counts[i], edge_counts[i]);
+	});
+
+	CompressedHostData arena(node_counts, edge_counts);
+	if (labels) arena.compressed_labels.resize(arena.compressed_parents.size());
+
+	host_parallel_for(filenames.size(), [&](size_t i) {
+		size_t num_nodes, num_edges;
+		std::ifstream file = openGraphFile(filenames[i], num_nodes, num_edges);
+		if (num_nodes != arena.nodes_count[i] || num_edges != arena.num_edges(i)) {
+			throw std::runtime_error("readGraph: " + filenames[i] + " changed while it was read");
+		}
+
+		// parse into the local offsets, then shift them into the arena slice
+		std::vector<size_t> local_offsets(num_nodes + 1, 0);
+		auto edges = arena.edges_slice(i);
+		parseGraphBody(file, filenames[i], num_nodes, num_edges, local_offsets.data(), edges.begin(), labels, labels ? arena.labels_slice(i).begin() : nullptr);
+
+		auto offsets = arena.offsets_slice(i);
+		for (size_t j = (i == 0) ? 0 : 1; j < offsets.size(); j++) {
+			offsets[j] = arena.graphs_offsets[i] + local_offsets[j];
+		}
+	});
+
+	return arena;
+}
+
+// right-aligns v on width columns, as std::setw does
+inline void appendPadded(std::string &out, long long v, size_t width = 3) {
+	std::string digits = std::to_string(v);
+	if (digits.size() < width) out.append(width - digits.size(), ' ');
+	out += digits;
+}
+
+// print the parents (and components) of every graph, formatted in a buffer flushed in large writes
+void writeResults(std::ostream &out, const std::vector<CSRHostData> &graphs, const std::vector<std::string> &fnames, bool forest = false) {
+	constexpr size_t FLUSH_SIZE = 1 << 20;
+	std::string buffer;
+	buffer.reserve(2 * FLUSH_SIZE);
+	for (size_t i = 0; i < graphs.size(); i++) {
+		buffer += "[!!!] Graph " + std::to_string(i) + ": " + fnames[i] + "\n";
+		for (size_t j = 0; j < graphs[i].num_nodes; j++) {
+			buffer += "- Node: ";
+			appendPadded(buffer, j);
+			buffer += " | Parent: ";
+			appendPadded(buffer, graphs[i].parents[j]);
+			if (forest) {
+				buffer += " | Component: ";
+				appendPadded(buffer, graphs[i].components[j]);
+			}
+			buffer += '\n';
+			if (buffer.size() >= FLUSH_SIZE) {
+				out.write(buffer.data(), buffer.size());
+				buffer.clear();
+			}
+		}
+	}
+	out.write(buffer.data(), buffer.size());
+	out.flush();
+}
+
+// write the parents (and components) of every graph in binary:
+// uint64 num_graphs, uint64 forest, then per graph uint64 num_nodes, nodeid_t parents[num_nodes] (, nodeid_t components[num_nodes])
+void writeResultsBinary(const std::string &filename, const std::vector<CSRHostData> &graphs, bool forest = false) {
+	std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+	uint64_t header[2] = {graphs.size(), forest};
+	out.write(reinterpret_cast<const char *>(header), sizeof(header));
+	for (auto &g : graphs) {
+		uint64_t n = g.num_nodes;
+		out.write(reinterpret_cast<const char *>(&n), sizeof(n));
+		out.write(reinterpret_cast<const char *>(g.parents.data()), n * sizeof(nodeid_t));
+		if (forest) out.write(reinterpret_cast<const char *>(g.components.data()), n * sizeof(nodeid_t));
+	}
+}
+
+#endif
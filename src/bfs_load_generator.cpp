@@ -0,0 +1,167 @@
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// closed-loop client of sycl_bfs_server: every connection sends one query, waits for the reply and sends the next
+
+class LineClient
+{
+public:
+	LineClient(const std::string &path)
+	{
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		sockaddr_un addr{};
+		addr.sun_family = AF_UNIX;
+		std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+		if (fd < 0 || connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0)
+		{
+			throw std::runtime_error("cannot connect to " + path + ": " + std::strerror(errno));
+		}
+	}
+	~LineClient() { close(fd); }
+
+	std::string request(const std::string &line)
+	{
+		std::string msg = line + "\n";
+		for (size_t sent = 0; sent < msg.size();)
+		{
+			ssize_t n = send(fd, msg.data() + sent, msg.size() - sent, MSG_NOSIGNAL);
+			if (n <= 0) throw std::runtime_error("connection closed");
+			sent += n;
+		}
+		size_t pos;
+		while ((pos = buffer.find('\n')) == std::string::npos)
+		{
+			char chunk[4096];
+			ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+			if (n <= 0) throw std::runtime_error("connection closed");
+			buffer.append(chunk, n);
+		}
+		std::string reply = buffer.substr(0, pos);
+		buffer.erase(0, pos + 1);
+		return reply;
+	}
+
+private:
+	int fd;
+	std::string buffer;
+};
+
+int main(int argc, char **argv)
+{
+	std::string path;
+	size_t num_queries = 1000, connections = 4;
+	bool paths = false, shutdown = false;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg(argv[i]);
+		if (arg.find("-n=") == 0) num_queries = std::stoul(arg.substr(3));
+		else if (arg.find("-c=") == 0) connections = std::stoul(arg.substr(3));
+		else if (arg == "-paths") paths = true;
+		else if (arg == "-shutdown") shutdown = true;
+		else if (arg.find("-h") == 0)
+		{
+			std::cout << "Usage: " << argv[0] << " [-n=<queries>] [-c=<connections>] [-paths] [-shutdown] <socket_path>" << std::endl;
+			return 0;
+		}
+		else path = arg;
+	}
+	if (path.empty())
+	{
+		std::cout << "[!] No socket given!" << std::endl;
+		return 0;
+	}
+
+	try
+	{
+		// "info <num_graphs> <n_0> ... <n_k>"
+		std::vector<size_t> nodes;
+		{
+			LineClient info(path);
+			std::istringstream in(info.request("info"));
+			std::string tag;
+			size_t num_graphs;
+			in >> tag >> num_graphs;
+			nodes.resize(num_graphs);
+			for (auto &n : nodes) in >> n;
+		}
+		if (nodes.empty())
+		{
+			std::cout << "[!] The server has no graph!" << std::endl;
+			return 0;
+		}
+
+		std::vector<float> latencies;
+		std::mutex latencies_mutex;
+		size_t errors = 0;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<std::thread> workers;
+		for (size_t c = 0; c < connections; c++)
+		{
+			workers.emplace_back([&, c]() {
+				std::mt19937 rng(c);
+				std::vector<float> local;
+				size_t local_errors = 0;
+				try
+				{
+					LineClient client(path);
+					for (size_t q = c; q < num_queries; q += connections)
+					{
+						size_t g = rng() % nodes.size();
+						std::string query = std::to_string(g) + " " + std::to_string(rng() % nodes[g]);
+						if (paths) query += " " + std::to_string(rng() % nodes[g]);
+
+						auto t0 = std::chrono::high_resolution_clock::now();
+						auto reply = client.request(query);
+						auto t1 = std::chrono::high_resolution_clock::now();
+						local.push_back(std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count());
+						if (reply.find("error") == 0) local_errors++;
+					}
+				}
+				catch (std::exception &e)
+				{
+					local_errors++; // the connection dropped, the remaining queries of this worker are lost
+				}
+				std::lock_guard<std::mutex> lock(latencies_mutex);
+				latencies.insert(latencies.end(), local.begin(), local.end());
+				errors += local_errors;
+			});
+		}
+		for (auto &w : workers) w.join();
+		auto end = std::chrono::high_resolution_clock::now();
+
+		float seconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1e6f;
+		std::sort(latencies.begin(), latencies.end());
+		auto percentile = [&](float p) { return latencies.empty() ? 0 : latencies[std::min(latencies.size() - 1, (size_t)(p * latencies.size()))]; };
+
+		std::cout << "- Queries: " << latencies.size() << " | Errors: " << errors << " | Connections: " << connections << std::endl;
+		std::cout << "- Throughput: " << latencies.size() / seconds << " q/s" << std::endl;
+		std::cout << "- Latency p50: " << percentile(0.5f) << " us | p99: " << percentile(0.99f) << " us | max: " << percentile(1.0f) << " us" << std::endl;
+
+		LineClient control(path);
+		std::cout << "- Server " << control.request("stats") << std::endl;
+		if (shutdown)
+		{
+			LineClient stopper(path);
+			try { stopper.request("shutdown"); } catch (std::exception &e) {} // the server closes without replying
+		}
+	}
+	catch (std::exception &e)
+	{
+		std::cout << e.what() << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,51 @@
+#include <sycl/sycl.hpp>
+#include "host_data.hpp"
+#include "utils.hpp"
+#include "arg_parse.hpp"
+#include "kernel_sizes.hpp"
+#include "bfs.hpp"
+
+int main(int argc, char **argv)
+{
+	args_t args;
+	get_mul_graph_args(argc, argv, args);
+
+	if (args.fnames.empty())
+	{
+		std::cout << "[!] No graph to process!" << std::endl;
+		return 0;
+	}
+
+	// in stdin mode stdout carries the replies, so the logs go to stderr
+	std::cerr << "[*] " << args.graphs.size() << " Graphs loaded!" << std::endl;
+
+	try
+	{
+		BFSQueryServer server(args.graphs, std::make_shared<BottomUpMBFSOperator<16>>(), args.deadline_us, args.max_batch, args.cache_mb << 20, args.compress_cache);
+		std::cerr << "- Startup time: " << server.warmup(args.local_size) << " us" << std::endl;
+		server.start();
+
+		if (args.socket_path.empty())
+		{
+			std::cerr << "[*] Reading queries from stdin" << std::endl;
+			server.serve_stream(std::cin, std::cout);
+		}
+		else
+		{
+			std::cerr << "[*] Listening on " << args.socket_path << std::endl;
+			server.serve_socket(args.socket_path);
+		}
+
+		auto stats = server.stats();
+		std::cerr << "- Queries: " << stats.queries << " | Batches: " << stats.batches << " | Throughput: " << stats.throughput << " q/s" << std::endl;
+		if (args.cache_mb > 0)
+		{
+			std::cerr << "- Cache hit rate: " << stats.cache.hit_rate << " | Entries: " << stats.cache.entries << " | Bytes: " << stats.cache.bytes << std::endl;
+		}
+	}
+	catch (sycl::exception e)
+	{
+		std::cout << e.what() << std::endl;
+	}
+	return 0;
+}
@@ -7,9 +7,176 @@
 #include "bfs.hpp"
 #include "benchmark.hpp"
 
+/**
+ * @brief Prints the transfers and the device memory of a run, under its times.
+ */
+void print_transfers(const bench_time_t &time)
+{
+	std::cout << "- Upload: " << time.upload.bytes << " bytes in " << time.upload.time << " us" << std::endl;
+	std::cout << "- Download: " << time.download.bytes << " bytes in " << time.download.time << " us" << std::endl;
+	std::cout << "- Peak device memory: " << time.device_bytes << " bytes" << std::endl;
+}
+
+/**
+ * @brief The sub-group sizes to run an operator at: those of -sg= that the device supports, or every size of the
+ * device it was built for.
+ */
+std::vector<size_t> operator_sg_sizes(const args_t &args, const sycl::device &device, const std::string &op, bool compressed)
+{
+	std::vector<size_t> supported;
+	for (const operator_variant_t *v : device_variants(device, compressed, args.forest)) {
+		if (v->name == op) supported.push_back(v->sg_size);
+	}
+	std::vector<size_t> sg_sizes = args.sg_sizes.empty() ? supported : std::vector<size_t>{};
+	for (size_t sg_size : args.sg_sizes) {
+		if (std::find(supported.begin(), supported.end(), sg_size) != supported.end()) {
+			sg_sizes.push_back(sg_size);
+		} else {
+			std::cout << "[Warning] Skipping sub-group size " << sg_size << ": " << op << " is not available at it on this device!" << std::endl;
+		}
+	}
+	if (sg_sizes.empty()) {
+		std::cout << "[!] Operator " << op << " cannot run on this device with the " << (compressed ? "compressed" : "vectorized") << " representation!" << std::endl;
+	}
+	return sg_sizes;
+}
+
+/**
+ * @brief Runs a batch of dataset packs on the compressed representation straight from its arena, so the
+ * graphs are never unpacked into per-graph CSRs. Only the results are scattered to args.graphs.
+ */
+void run_arena(args_t &args, const std::vector<nodeid_t> &sources)
+{
+	CompressedHostData &arena = *args.arena;
+	bool download = args.print_result || !args.out_file.empty();
+	std::string op = !args.op.empty() ? args.op : "matrix";
+	sycl::device device{sycl::gpu_selector_v};
+	std::vector<size_t> sg_sizes = operator_sg_sizes(args, device, op, true);
+	if (sg_sizes.empty()) return;
+
+	std::cout << "Operator " << op << ":" << std::endl;
+	std::vector<CSRHostData> unpacked; // the batch lives in the arena only
+	for (size_t sg_size : sg_sizes) {
+		MultipleGraphBFS<true> bfs(unpacked, make_mbfs_operator(op, sg_size, args.forest, args.heavy_degree), device);
+		bfs.set_label_mask(args.label_mask);
+		SYCL_CompressedGraphData data(arena, args.forest);
+		if (data.device_bytes() > bfs.get_memory_budget()) {
+			throw sycl::exception(sycl::make_error_code(sycl::errc::memory_allocation), "The packed batch needs " + std::to_string(data.device_bytes()) + " bytes of device memory, split it with -budget=");
+		}
+		std::cout << "SubGroup size " << std::setw(2) << sg_size << ":" << std::endl;
+		std::cout << "- Startup time: " << bfs.warmup(args.local_size) << " us" << std::endl;
+		data.upload(bfs.get_queue());
+		bench_time_t time = bfs.run(data, sources, args.local_size, download);
+		std::cout << "- Kernel time: " << time.kernel_time << " us" << std::endl;
+		std::cout << "- Total time: " << time.total_time << " us" << std::endl;
+		print_transfers(time);
+	}
+
+	if (download) {
+		args.graphs.resize(arena.num_graphs);
+		for (size_t i = 0; i < arena.num_graphs; i++) {
+			auto parents = arena.parents_slice(i);
+			args.graphs[i].num_nodes = arena.nodes_count[i];
+			args.graphs[i].parents.assign(parents.begin(), parents.end());
+			if (args.forest) {
+				args.graphs[i].components.assign(arena.compressed_components.begin() + arena.nodes_offsets[i], arena.compressed_components.begin() + arena.nodes_offsets[i + 1]);
+			}
+		}
+	}
+}
+
+/**
+ * @brief Runs the batch on one representation, with the operator variant picked by -op= at every sub-group size of -sg=
+ * (every size the device supports by default), or with the tuned configuration when a tuner cache is given.
+ */
+template<bool compressed>
+void run_batch(args_t &args, const std::vector<nodeid_t> &sources)
+{
+	if (!compressed && args.graphs.size() > MAX_PARALLEL_GRAPHS) {
+		std::cout << "[Warning] Too many graphs to process in parallel!" << std::endl;
+		std::cout << "[*] Cutting off last " << args.graphs.size() - MAX_PARALLEL_GRAPHS << " graphs" << std::endl;
+		args.graphs.resize(MAX_PARALLEL_GRAPHS);
+		args.fnames.resize(MAX_PARALLEL_GRAPHS);
+	}
+
+	bench_time_t time;
+	// the parents are copied back only when they are printed or dumped
+	bool download = args.print_result || !args.out_file.empty();
+	// the summaries are computed from the timed run, which then downloads the parents only if asked to
+	bool summarize = args.summary || !args.targets.empty();
+	bfs_query_options_t options;
+	options.level_histogram = args.summary;
+	options.targets = args.targets;
+	options.download_parents = download;
+	bfs_query_result_t summaries;
+
+	// bit matrices with a bottom-up fallback on the compressed graphs, 64-bit frontier words on the vectorized ones
+	std::string op = !args.op.empty() ? args.op : compressed ? "matrix" : "bottomup_w64";
+	sycl::device device{sycl::gpu_selector_v};
+
+	if (!args.tune_cache.empty())
+	{
+		// run only the configuration tuned for this class of graphs, tuning it first if the cache misses it
+		AutoTuner tuner(args.tune_cache);
+		tuning_config_t config;
+		bool tuned = tuner.find(args.graphs, device, compressed, args.forest, config);
+		if (!tuned)
+		{
+			std::cout << "[*] No tuned configuration for this graph class, tuning..." << std::endl;
+			tuner.tune(args.graphs, sources, device, args.forest);
+			tuned = tuner.find(args.graphs, device, compressed, args.forest, config);
+		}
+		if (tuned)
+		{
+			std::cout << "Tuned " << config.op << " | SubGroup size " << config.sg_size << " | Work-group size " << config.wg_size << ":" << std::endl;
+		}
+		else
+		{
+			// the sweep found a configuration on the other representation only
+			std::cout << "[!] No configuration of the " << (compressed ? "compressed" : "vectorized") << " representation could be tuned, running " << op << ":" << std::endl;
+		}
+		// the fallback runs at the first sub-group size the device supports for it
+		std::vector<size_t> fallback_sg_sizes = operator_sg_sizes(args, device, op, compressed);
+		if (fallback_sg_sizes.empty()) return;
+		MultipleGraphBFS<compressed> bfs(args.graphs, tuner, make_mbfs_operator(op, fallback_sg_sizes.front(), args.forest, args.heavy_degree));
+		bfs.set_label_mask(args.label_mask);
+		bfs.set_memory_budget(args.device_budget_mb << 20);
+		std::cout << "- Startup time: " << bfs.warmup() << " us" << std::endl;
+		time = summarize ? bfs.run(sources, options, summaries) : bfs.run(sources, 0, download);
+		std::cout << "- Kernel time: " << time.kernel_time << " us" << std::endl;
+		std::cout << "- Total time: " << time.total_time << " us" << std::endl;
+		print_transfers(time);
+	}
+	else
+	{
+		std::vector<size_t> sg_sizes = operator_sg_sizes(args, device, op, compressed);
+		if (sg_sizes.empty()) return;
+
+		std::cout << "Operator " << op << ":" << std::endl;
+		std::unique_ptr<MultipleGraphBFS<compressed>> bfs;
+		for (size_t sg_size : sg_sizes) {
+			bfs = std::make_unique<MultipleGraphBFS<compressed>>(args.graphs, make_mbfs_operator(op, sg_size, args.forest, args.heavy_degree), device);
+			bfs->set_label_mask(args.label_mask);
+			bfs->set_memory_budget(args.device_budget_mb << 20);
+			std::cout << "SubGroup size " << std::setw(2) << sg_size << ":" << std::endl;
+			std::cout << "- Startup time: " << bfs->warmup(args.local_size) << " us" << std::endl;
+			time = summarize ? bfs->run(sources, options, summaries, args.local_size) : bfs->run(sources, args.local_size, download);
+			std::cout << "- Kernel time: " << time.kernel_time << " us" << std::endl;
+			std::cout << "- Total time: " << time.total_time << " us" << std::endl;
+			print_transfers(time);
+		}
+	}
+
+	if (summarize)
+	{
+		write_summaries(std::cout, options, summaries);
+	}
+}
+
 int main(int argc, char **argv)
 {
 	args_t args;
+	args.map_packs = true;
 	get_mul_graph_args(argc, argv, args);
 
 	if (args.fnames.empty())
@@ -18,67 +185,73 @@ int main(int argc, char **argv)
 		return 0;
 	}
 
-	std::cout << "[*] " << args.graphs.size() << " Graphs loaded!" << std::endl;
+	size_t num_graphs = args.arena ? args.arena->num_graphs : args.graphs.size();
+	std::cout << "[*] " << num_graphs << " Graphs loaded!" << std::endl;
 
 	std::vector<nodeid_t> sources;
-	for (int i = 0; i < args.graphs.size(); i++)
+	for (int i = 0; i < num_graphs; i++)
 	{
 		sources.push_back(0);
 	}
 
-	// run BFS
-	try
-	{
 #ifdef SYCL_BFS_COMPRESSED_GRAPH
-#ifdef SUPPORTS_SG_8
-		MultipleGraphBFS<true> bfs8(args.graphs, std::make_shared<BottomUpMBFSOperator<8>>());
-#endif
-		MultipleGraphBFS<true> bfs16(args.graphs, std::make_shared<BottomUpMBFSOperator<16>>());
-		MultipleGraphBFS<true> bfs32(args.graphs, std::make_shared<BottomUpMBFSOperator<32>>());
+	bool compressed = args.repr != "vectorized";
 #else
-#ifdef SUPPORTS_SG_8
-		MultipleGraphBFS<false> bfs8(args.graphs, std::make_shared<BottomUpMBFSOperator<8>>());
-#endif
-		MultipleGraphBFS<false> bfs16(args.graphs, std::make_shared<BottomUpMBFSOperator<16>>());
-		MultipleGraphBFS<false> bfs32(args.graphs, std::make_shared<BottomUpMBFSOperator<32>>());
-
-		if (args.graphs.size() > MAX_PARALLEL_GRAPHS) {
-			std::cout << "[Warning] Too many graphs to process in parallel!" << std::endl;
-			std::cout << "[*] Cutting off last " << args.graphs.size() - MAX_PARALLEL_GRAPHS << " graphs" << std::endl;
-			args.graphs.resize(MAX_PARALLEL_GRAPHS);
-			args.fnames.resize(MAX_PARALLEL_GRAPHS);
-		}
-#endif
-		bench_time_t time;
-
-#ifdef SUPPORTS_SG_8
-		std::cout << "SubGroup size  8:" << std::endl;
-		time = bfs8.run(sources, args.local_size);
-		std::cout << "- Kernel time: " << time.kernel_time << " us" << std::endl;
-		std::cout << "- Total time: " << time.total_time << " us" << std::endl;
+	bool compressed = args.repr == "compressed";
 #endif
+	if (!args.repr.empty() && args.repr != "compressed" && args.repr != "vectorized")
+	{
+		std::cout << "[!] Unknown representation " << args.repr << "!" << std::endl;
+		return 0;
+	}
+	// the packed arena feeds the plain compressed runs, the other ones need the CSR of each graph
+	if (args.arena && (!compressed || args.plan || !args.tune_cache.empty() || args.summary || !args.targets.empty() || args.device_budget_mb > 0))
+	{
+		unpack_arena(args);
+	}
 
-		std::cout << "SubGroup size 16:" << std::endl;
-		time = bfs16.run(sources, args.local_size);
-		std::cout << "- Kernel time: " << time.kernel_time << " us" << std::endl;
-		std::cout << "- Total time: " << time.total_time << " us" << std::endl;
-
-		std::cout << "SubGroup size 32:" << std::endl;
-		time = bfs32.run(sources, args.local_size);
-		std::cout << "- Kernel time: " << time.kernel_time << " us" << std::endl;
-		std::cout << "- Total time: " << time.total_time << " us" << std::endl;
+	// run BFS
+	try
+	{
+		if (args.plan && args.label_mask != ALL_LABELS)
+		{
+			std::cout << "[!] Label masks cannot be used with a planned batch!" << std::endl;
+			return 0;
+		}
+		else if (args.plan)
+		{
+			// buckets of similar graphs, each with its own operator, on the tuned configurations if any
+			std::unique_ptr<AutoTuner> tuner;
+			if (!args.tune_cache.empty()) tuner = std::make_unique<AutoTuner>(args.tune_cache);
+			BatchPlanner planner(args.graphs, args.forest, tuner.get());
+			std::cout << "Planned batch:" << std::endl;
+			std::cout << "- Startup time: " << planner.warmup() << " us" << std::endl;
+			bench_time_t time = planner.run(sources, args.print_result || !args.out_file.empty());
+			planner.print_plan(std::cout);
+			std::cout << "- Kernel time: " << time.kernel_time << " us" << std::endl;
+			std::cout << "- Total time: " << time.total_time << " us" << std::endl;
+			print_transfers(time);
+		}
+		else if (args.arena)
+		{
+			run_arena(args, sources);
+		}
+		else if (compressed)
+		{
+			run_batch<true>(args, sources);
+		}
+		else
+		{
+			run_batch<false>(args, sources);
+		}
 
+		if (!args.out_file.empty())
+		{
+			writeResultsBinary(args.out_file, args.graphs, args.forest);
+		}
 		if (args.print_result)
 		{
-			for (int i = 0; i < args.graphs.size(); i++)
-			{
-				std::cout << "[!!!] Graph " << i << ": " << args.fnames[i] << std::endl;
-				for (nodeid_t j = 0; j < args.graphs[i].num_nodes; j++)
-				{
-					std::cout << "- Node: " << std::setfill(' ') << std::setw(3) << j
-										<< " | Parent: " << std::setfill(' ') << std::setw(3) << args.graphs[i].parents[j] << std::endl;
-				}
-			}
+			writeResults(std::cout, args.graphs, args.fnames, args.forest);
 		}
 	}
 	catch (sycl::exception e)
@@ -86,4 +259,4 @@ int main(int argc, char **argv)
 		std::cout << e.what() << std::endl;
 	}
 	return 0;
-}
\ No newline at end of file
+}
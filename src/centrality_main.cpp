@@ -0,0 +1,50 @@
+#include <sycl/sycl.hpp>
+#include <iomanip>
+#include "host_data.hpp"
+#include "utils.hpp"
+#include "arg_parse.hpp"
+#include "kernel_sizes.hpp"
+#include "bfs.hpp"
+#include "benchmark.hpp"
+
+int main(int argc, char **argv)
+{
+	args_t args;
+	get_mul_graph_args(argc, argv, args);
+
+	if (args.fnames.empty())
+	{
+		std::cout << "[!] No graph to process!" << std::endl;
+		return 0;
+	}
+
+	std::cout << "[*] " << args.graphs.size() << " Graphs loaded!" << std::endl;
+
+	try
+	{
+		CentralityEngine engine(args.graphs);
+		std::vector<centrality_t> results;
+		auto time = engine.run(results, args.sources_per_launch, args.local_size);
+		std::cout << "Centrality, " << args.sources_per_launch << " sources per launch:" << std::endl;
+		std::cout << "- Kernel time: " << time.kernel_time << " us" << std::endl;
+		std::cout << "- Total time: " << time.total_time << " us" << std::endl;
+
+		if (args.print_result)
+		{
+			for (size_t i = 0; i < results.size(); i++)
+			{
+				std::cout << "[!!!] Graph " << args.fnames[i] << '\n';
+				for (size_t v = 0; v < results[i].betweenness.size(); v++)
+				{
+					std::cout << "node " << std::setw(3) << v << ": betweenness " << results[i].betweenness[v] << " | closeness " << results[i].closeness[v] << '\n';
+				}
+			}
+			std::cout.flush();
+		}
+	}
+	catch (sycl::exception e)
+	{
+		std::cout << e.what() << std::endl;
+	}
+	return 0;
+}
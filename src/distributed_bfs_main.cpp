@@ -0,0 +1,118 @@
+#include <mpi.h>
+#include <sycl/sycl.hpp>
+#include <iomanip>
+#include <iostream>
+#include "host_data.hpp"
+#include "utils.hpp"
+#include "kernel_sizes.hpp"
+#include "impl/distributed_bfs.hpp"
+
+int main(int argc, char **argv)
+{
+	MPI_Init(&argc, &argv);
+	int rank, num_ranks;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+
+	if (argc < 2)
+	{
+		if (rank == 0) std::cout << "Usage: mpirun -np <N> " << argv[0] << " <graph_path> [-p] [-s=<source>]" << std::endl;
+		MPI_Finalize();
+		return 1;
+	}
+
+	bool print_result = false;
+	long long source = 0;
+	for (int i = 2; i < argc; i++)
+	{
+		if (std::string(argv[i]) == "-p") print_result = true;
+		else if (std::string(argv[i]).find("-s=") == 0)
+		{
+			std::string value = std::string(argv[i]).substr(3);
+			size_t end = 0;
+			try
+			{
+				source = std::stoll(value, &end);
+			}
+			catch (std::exception &e)
+			{
+				end = 0;
+			}
+			if (end == 0 || end != value.size())
+			{
+				if (rank == 0) std::cout << "[!] -s= takes a vertex id, got \"" << value << "\"" << std::endl;
+				MPI_Finalize();
+				return 1;
+			}
+		}
+	}
+
+	// an error on one rank would leave the others blocked in the next collective, so it takes the job down
+	try
+	{
+		DistributedCSRHostData data = readGraphRangeFromFile(argv[1]);
+		if (rank == 0) std::cout << "[*] Graph loaded on " << num_ranks << " ranks: " << data.global_nodes << " nodes" << std::endl;
+
+		// every rank read the same header, so they all stop here alike
+		if (source < 0 || source >= (long long)data.global_nodes)
+		{
+			if (rank == 0) std::cout << "[!] Source " << source << " is not a vertex of the graph (" << data.global_nodes << " nodes)" << std::endl;
+			MPI_Finalize();
+			return 1;
+		}
+
+		DistributedBFS bfs(data);
+		auto reports = bfs.run(source);
+
+		// the slowest rank sets the time of each level
+		for (auto &r : reports)
+		{
+			double times[2] = {r.compute_time, r.comm_time}, max_times[2];
+			unsigned long long bytes = r.bytes_sent, total_bytes;
+			int dense = r.dense, any_dense;
+			MPI_Reduce(times, max_times, 2, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+			MPI_Reduce(&bytes, &total_bytes, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+			MPI_Reduce(&dense, &any_dense, 1, MPI_INT, MPI_MAX, 0, MPI_COMM_WORLD);
+			if (rank == 0)
+			{
+				std::cout << "Level " << std::setw(3) << r.level
+									<< " | Frontier: " << std::setw(8) << r.frontier_size
+									<< " | Compute: " << std::setw(10) << max_times[0] << " us"
+									<< " | Comm: " << std::setw(10) << max_times[1] << " us"
+									<< " | Sent: " << total_bytes << " B" << (any_dense ? " (bitmap)" : " (sparse)") << std::endl;
+			}
+		}
+
+		auto parents = bfs.gather_parents();
+		if (rank == 0 && print_result)
+		{
+			// formatted in a buffer written in large blocks, as writeResults does
+			constexpr size_t FLUSH_SIZE = 1 << 20;
+			std::string buffer;
+			buffer.reserve(2 * FLUSH_SIZE);
+			for (size_t j = 0; j < parents.size(); j++)
+			{
+				buffer += "- Node: ";
+				appendPadded(buffer, j);
+				buffer += " | Parent: ";
+				appendPadded(buffer, parents[j]);
+				buffer += '\n';
+				if (buffer.size() >= FLUSH_SIZE)
+				{
+					std::cout.write(buffer.data(), buffer.size());
+					buffer.clear();
+				}
+			}
+			std::cout.write(buffer.data(), buffer.size());
+			std::cout.flush();
+		}
+	}
+	catch (std::exception &e)
+	{
+		std::cout << "[!] Rank " << rank << ": " << e.what() << std::endl;
+		MPI_Abort(MPI_COMM_WORLD, 1);
+	}
+
+	MPI_Finalize();
+	return 0;
+}
@@ -0,0 +1,155 @@
+#include <sycl/sycl.hpp>
+#include <iostream>
+#include <random>
+#include <string>
+#include "host_data.hpp"
+#include "utils.hpp"
+#include "arg_parse.hpp"
+#include "kernel_sizes.hpp"
+#include "bfs.hpp"
+
+// applies batches of random edge updates to one graph and checks the repaired tree against a full rerun: "sycl_bfs_dynamic graph.txt -batch=64 -rounds=10"
+
+/**
+ * @brief The level of every node in a BFS tree, -1 for the nodes it does not reach.
+ */
+std::vector<int> tree_levels(const std::vector<nodeid_t> &parents, nodeid_t source)
+{
+	std::vector<int> levels(parents.size(), -1);
+	levels[source] = 0;
+	std::vector<nodeid_t> chain;
+	for (size_t v = 0; v < parents.size(); v++)
+	{
+		nodeid_t u = v;
+		while (levels[u] == -1 && parents[u] != -1 && chain.size() <= parents.size())
+		{
+			chain.push_back(u);
+			u = parents[u];
+		}
+		int level = levels[u];
+		while (!chain.empty())
+		{
+			level = (level == -1) ? -1 : level + 1;
+			levels[chain.back()] = level;
+			chain.pop_back();
+		}
+	}
+	return levels;
+}
+
+int main(int argc, char **argv)
+{
+	std::string path;
+	long long source = 0, batch_size = 64, rounds = 10, seed = 1;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg(argv[i]);
+		if (arg.find("-s=") == 0)
+		{
+			if (!parse_integer(arg.substr(3), source)) arg_error(argv[0], "-s= takes a node id, got \"" + arg.substr(3) + "\"");
+		}
+		else if (arg.find("-batch=") == 0)
+		{
+			if (!parse_integer(arg.substr(7), batch_size) || batch_size < 0) arg_error(argv[0], "-batch= takes a number of edges, got \"" + arg.substr(7) + "\"");
+		}
+		else if (arg.find("-rounds=") == 0)
+		{
+			if (!parse_integer(arg.substr(8), rounds) || rounds < 0) arg_error(argv[0], "-rounds= takes a number of batches, got \"" + arg.substr(8) + "\"");
+		}
+		else if (arg.find("-seed=") == 0)
+		{
+			if (!parse_integer(arg.substr(6), seed)) arg_error(argv[0], "-seed= takes an integer, got \"" + arg.substr(6) + "\"");
+		}
+		else if (arg.find("-h") == 0)
+		{
+			std::cout << "Usage: " << argv[0] << " [-s=<source>] [-batch=<edges>] [-rounds=<batches>] [-seed=<seed>] <graph_file>" << std::endl;
+			return 0;
+		}
+		else path = arg;
+	}
+	if (path.empty())
+	{
+		std::cout << "[!] No graph to process!" << std::endl;
+		return 0;
+	}
+
+	try
+	{
+		CSRHostData graph = readGraphFromFile(path);
+		if (source < 0 || source >= (long long)graph.num_nodes)
+		{
+			std::cout << "[!] Source " << source << " is not a node of the graph (" << graph.num_nodes << " nodes)" << std::endl;
+			return 1;
+		}
+		std::cout << "[*] Graph loaded: " << graph.num_nodes << " nodes, " << graph.csr.edges.size() << " edges" << std::endl;
+
+		DynamicGraphBFS dynamic(graph, std::make_shared<BottomUpMBFSOperator<16>>());
+		std::cout << "- Startup time: " << dynamic.warmup() << " us" << std::endl;
+		bench_time_t first = dynamic.run(source);
+		std::cout << "- First BFS: " << first.total_time << " us" << std::endl;
+
+		// the reference reruns the whole traversal on a snapshot of the updated graph
+		std::vector<CSRHostData> reference(1);
+		MultipleGraphBFS<true> rerun(reference, std::make_shared<BottomUpMBFSOperator<16>>());
+		rerun.warmup();
+
+		std::mt19937_64 rng(seed);
+		std::uniform_int_distribution<nodeid_t> node(0, graph.num_nodes - 1);
+		float update_time = 0, rerun_time = 0;
+		size_t mismatches = 0;
+		for (long long r = 0; r < rounds; r++)
+		{
+			// half of the batch removes existing edges, the other half adds random ones
+			CSRHostData current = dynamic.snapshot();
+			std::vector<edge_t> insertions, deletions;
+			for (long long k = 0; k < batch_size; k++)
+			{
+				nodeid_t u = node(rng);
+				size_t degree = current.csr.offsets[u + 1] - current.csr.offsets[u];
+				if (k % 2 == 0 && degree > 0)
+				{
+					deletions.push_back({u, current.csr.edges[current.csr.offsets[u] + rng() % degree]});
+				}
+				else
+				{
+					insertions.push_back({u, node(rng)});
+				}
+			}
+			dynamic_update_stats_t stats = dynamic.update(insertions, deletions);
+
+			reference[0] = dynamic.snapshot();
+			reference[0].parents.assign(graph.num_nodes, -1);
+			bench_time_t full = rerun.run({static_cast<nodeid_t>(source)});
+
+			// parents may differ between equally short trees, the levels may not
+			std::vector<int> expected = tree_levels(reference[0].parents, source);
+			const std::vector<int> &levels = dynamic.get_levels();
+			const std::vector<nodeid_t> &parents = dynamic.get_parents();
+			size_t wrong = 0;
+			for (size_t v = 0; v < graph.num_nodes; v++)
+			{
+				bool parent_ok = v == (size_t)source || levels[v] == -1 || (parents[v] != -1 && levels[parents[v]] + 1 == levels[v]);
+				if (levels[v] != expected[v] || !parent_ok) wrong++;
+			}
+			mismatches += wrong;
+			update_time += stats.time;
+			rerun_time += full.total_time;
+			std::cout << "- Batch " << r << " | Inserted: " << stats.inserted << " | Deleted: " << stats.deleted << " | Orphaned: " << stats.orphaned
+			          << " | Updated: " << stats.updated << " | Scanned edges: " << stats.scanned_edges << " | Update: " << stats.time << " us | Rerun: " << full.total_time
+			          << " us | Mismatches: " << wrong << std::endl;
+		}
+		std::cout << "- Update time: " << update_time << " us | Rerun time: " << rerun_time << " us" << std::endl;
+		if (mismatches > 0)
+		{
+			std::cout << "[!] " << mismatches << " nodes differ from the full rerun!" << std::endl;
+			return 1;
+		}
+		std::cout << "[*] Every repaired tree matches the full rerun" << std::endl;
+	}
+	catch (std::exception &e)
+	{
+		std::cout << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,61 @@
+#include <sycl/sycl.hpp>
+#include <iomanip>
+#include "host_data.hpp"
+#include "utils.hpp"
+#include "arg_parse.hpp"
+#include "kernel_sizes.hpp"
+#include "bfs.hpp"
+#include "benchmark.hpp"
+
+int main(int argc, char **argv)
+{
+	args_t args;
+	get_mul_graph_args(argc, argv, args);
+
+	if (args.fnames.empty())
+	{
+		std::cout << "[!] No graph to process!" << std::endl;
+		return 0;
+	}
+
+	std::cout << "[*] " << args.graphs.size() << " Graphs loaded!" << std::endl;
+
+	std::vector<nodeid_t> sources(args.graphs.size(), 0);
+
+	// run BFS
+	try
+	{
+		auto devices = get_bfs_devices(args.use_cpu);
+		std::cout << "[*] " << devices.size() << " Devices selected" << std::endl;
+
+		MultiDeviceGraphBFS<true> bfs(args.graphs, std::make_shared<BottomUpMBFSOperator<16>>(args.forest), devices);
+		std::cout << "- Startup time: " << bfs.warmup(args.local_size) << " us" << std::endl;
+		auto report = bfs.run(sources, args.local_size);
+
+		for (int d = 0; d < report.devices.size(); d++)
+		{
+			auto &dev = report.devices[d];
+			std::cout << "Device " << d << " (" << dev.name << "):" << std::endl;
+			std::cout << "- Graphs: " << dev.num_graphs << " | Estimated work: " << dev.estimated_work << std::endl;
+			std::cout << "- Kernel time: " << dev.time.kernel_time << " us" << std::endl;
+			std::cout << "- Total time: " << dev.time.total_time << " us" << std::endl;
+			std::cout << "- Utilization: " << std::fixed << std::setprecision(2) << dev.utilization * 100 << " %" << std::endl;
+		}
+		std::cout << "- Kernel time: " << report.time.kernel_time << " us" << std::endl;
+		std::cout << "- Total time: " << report.time.total_time << " us" << std::endl;
+
+		if (!args.out_file.empty())
+		{
+			writeResultsBinary(args.out_file, args.graphs, args.forest);
+		}
+		if (args.print_result)
+		{
+			writeResults(std::cout, args.graphs, args.fnames, args.forest);
+		}
+	}
+	catch (sycl::exception e)
+	{
+		std::cout << e.what() << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,76 @@
+#include <sycl/sycl.hpp>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "kernel_sizes.hpp"
+#include "graph_pack.hpp"
+#include "impl/out_of_core_bfs.hpp"
+
+// runs a BFS on one graph of a dataset pack (see sycl_bfs_pack) streaming its edges: "sycl_bfs_ooc big.pack -segment=256"
+
+int main(int argc, char **argv)
+{
+	std::string path;
+	size_t graph = 0, segment_mb = OutOfCoreBFS::DEFAULT_SEGMENT_BYTES >> 20, local_size = DEFAULT_WORK_GROUP_SIZE;
+	nodeid_t source = 0;
+	bool print_result = false;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg(argv[i]);
+		if (arg.find("-s=") == 0) source = std::stoi(arg.substr(3));
+		else if (arg.find("-g=") == 0) graph = std::stoul(arg.substr(3));
+		else if (arg.find("-segment=") == 0) segment_mb = std::stoul(arg.substr(9));
+		else if (arg.find("-local=") == 0) local_size = std::stoul(arg.substr(7));
+		else if (arg == "-p") print_result = true;
+		else if (arg.find("-h") == 0)
+		{
+			std::cout << "Usage: " << argv[0] << " [-p] [-g=<graph>] [-s=<source>] [-segment=<MB>] [-local=<local_size>] <dataset_pack>" << std::endl;
+			return 0;
+		}
+		else path = arg;
+	}
+	if (path.empty())
+	{
+		std::cout << "[!] No dataset pack to process!" << std::endl;
+		return 0;
+	}
+
+	try
+	{
+		MappedGraphPack pack(path);
+		s::queue queue{s::gpu_selector_v};
+		OutOfCoreBFS bfs(pack, graph, queue, segment_mb << 20);
+		std::cout << "[*] Graph " << graph << ": " << pack.num_nodes(graph) << " nodes, " << pack.num_edges(graph) << " edges in " << bfs.get_segments().size() << " segments" << std::endl;
+		std::cout << "- Device memory: " << (bfs.device_bytes() >> 20) << " MB" << std::endl;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		auto levels = bfs.run(source, local_size);
+		auto end = std::chrono::high_resolution_clock::now();
+
+		size_t total_bytes = 0;
+		for (size_t l = 0; l < levels.size(); l++)
+		{
+			auto &level = levels[l];
+			total_bytes += level.bytes;
+			std::cout << "- Level " << l << (level.bottom_up ? " bottom-up" : " top-down") << " | Frontier: " << level.frontier << " | Segments: " << level.segments
+			          << " | Streamed: " << (level.bytes >> 10) << " KB | IO time: " << level.io_time << " us | Time: " << level.time << " us" << std::endl;
+		}
+		std::cout << "- Streamed: " << (total_bytes >> 20) << " MB" << std::endl;
+		std::cout << "- Total time: " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us" << std::endl;
+
+		if (print_result)
+		{
+			auto parents = bfs.get_parents();
+			for (size_t i = 0; i < parents.size(); i++)
+			{
+				std::cout << "node " << i << ": " << parents[i] << '\n';
+			}
+			std::cout.flush();
+		}
+	}
+	catch (std::exception &e)
+	{
+		std::cout << e.what() << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,67 @@
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "host_data.hpp"
+#include "utils.hpp"
+#include "graph_pack.hpp"
+
+// packs graph files (or directories of graph files) into a single dataset pack, then times loading it back
+
+int main(int argc, char **argv)
+{
+	if (argc < 3 || std::string(argv[1]).find("-h") == 0)
+	{
+		std::cout << "Usage: " << argv[0] << " <out_pack> <graph files or directories...>" << std::endl;
+		return 0;
+	}
+
+	std::string out(argv[1]);
+	std::vector<std::string> fnames;
+	for (int i = 2; i < argc; i++)
+	{
+		if (std::filesystem::is_directory(argv[i]))
+		{
+			for (const auto &entry : std::filesystem::directory_iterator(argv[i]))
+			{
+				fnames.push_back(entry.path().string());
+			}
+		}
+		else
+		{
+			fnames.push_back(argv[i]);
+		}
+	}
+
+	try
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		CompressedHostData arena = readGraphsIntoArena(fnames);
+		auto parsed = std::chrono::high_resolution_clock::now();
+		writeGraphPack(out, arena);
+		auto written = std::chrono::high_resolution_clock::now();
+
+		MappedGraphPack pack(out);
+		CompressedHostData loaded = pack.to_arena();
+		auto loaded_time = std::chrono::high_resolution_clock::now();
+
+		auto ms = [](auto a, auto b) { return std::chrono::duration_cast<std::chrono::microseconds>(b - a).count() / 1000.0f; };
+		std::cout << "[*] " << arena.num_graphs << " Graphs packed into " << out << std::endl;
+		std::cout << "- Nodes: " << arena.nodes_offsets[arena.num_graphs] << " | Edges: " << arena.graphs_offsets[arena.num_graphs] << std::endl;
+		std::cout << "- Parse time: " << ms(start, parsed) << " ms" << std::endl;
+		std::cout << "- Write time: " << ms(parsed, written) << " ms" << std::endl;
+		std::cout << "- Pack load time: " << ms(written, loaded_time) << " ms" << std::endl;
+		if (loaded.compressed_offsets != arena.compressed_offsets || loaded.compressed_edges != arena.compressed_edges)
+		{
+			std::cout << "[!!!] The pack does not match the parsed graphs" << std::endl;
+			return 1;
+		}
+	}
+	catch (std::exception &e)
+	{
+		std::cout << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,82 @@
+#include <sycl/sycl.hpp>
+#include <iomanip>
+#include "host_data.hpp"
+#include "utils.hpp"
+#include "arg_parse.hpp"
+#include "kernel_sizes.hpp"
+#include "bfs.hpp"
+#include "benchmark.hpp"
+
+int main(int argc, char **argv)
+{
+	args_t args;
+	get_mul_graph_args(argc, argv, args);
+
+	if (args.fnames.empty() || args.queries.empty())
+	{
+		std::cout << "[!] No graph or query to process!" << std::endl;
+		return 0;
+	}
+
+	std::cout << "[*] " << args.graphs.size() << " Graphs loaded!" << std::endl;
+
+	// queries are given as <graph>:<source>:<target>
+	std::vector<path_query_t> queries;
+	for (auto &q : args.queries)
+	{
+		size_t first = q.find(':');
+		size_t second = first == std::string::npos ? std::string::npos : q.find(':', first + 1);
+		long long graph = -1, source = -1, target = -1;
+		if (second == std::string::npos
+			|| !parse_integer(q.substr(0, first), graph)
+			|| !parse_integer(q.substr(first + 1, second - first - 1), source)
+			|| !parse_integer(q.substr(second + 1), target))
+		{
+			arg_error(argv[0], "-q= takes <graph>:<source>:<target>, got \"" + q + "\"");
+		}
+		if (graph < 0 || graph >= (long long)args.graphs.size())
+		{
+			arg_error(argv[0], "-q= names graph " + std::to_string(graph) + ", only " + std::to_string(args.graphs.size()) + " are loaded");
+		}
+		long long num_nodes = args.graphs[graph].num_nodes;
+		if (source < 0 || source >= num_nodes || target < 0 || target >= num_nodes)
+		{
+			arg_error(argv[0], "-q= \"" + q + "\" names a node out of the " + std::to_string(num_nodes) + " nodes of graph " + std::to_string(graph));
+		}
+		queries.push_back(path_query_t{
+			.graph = static_cast<size_t>(graph),
+			.source = static_cast<nodeid_t>(source),
+			.target = static_cast<nodeid_t>(target)
+		});
+	}
+
+	try
+	{
+		PathQueryBFS bfs(args.graphs);
+		std::vector<path_result_t> results;
+		auto time = bfs.run(queries, results, args.local_size);
+		std::cout << "- Kernel time: " << time.kernel_time << " us" << std::endl;
+		std::cout << "- Total time: " << time.total_time << " us" << std::endl;
+
+		for (int i = 0; i < queries.size(); i++)
+		{
+			std::cout << "[!!!] Graph " << queries[i].graph << ": " << queries[i].source << " -> " << queries[i].target;
+			if (results[i].distance < 0)
+			{
+				std::cout << " | Unreachable" << std::endl;
+				continue;
+			}
+			std::cout << " | Distance: " << results[i].distance << " | Path:";
+			for (auto v : results[i].path)
+			{
+				std::cout << " " << v;
+			}
+			std::cout << std::endl;
+		}
+	}
+	catch (sycl::exception e)
+	{
+		std::cout << e.what() << std::endl;
+	}
+	return 0;
+}
@@ -1,4 +1,5 @@
 #include <sycl/sycl.hpp>
+#include <fstream>
 #include <memory>
 #include "host_data.hpp"
 #include "utils.hpp"
@@ -6,6 +7,8 @@
 #include "kernel_sizes.hpp"
 #include "bfs.hpp"
 
+// runs the single-graph frontier BFS on one graph: "sycl_bfs_single graph.txt [out_data] [-s=<source>] [-local=<local_size>] [-runs=<n>]"
+
 int main(int argc, char **argv)
 {
 
@@ -14,33 +17,62 @@ int main(int argc, char **argv)
 		return 1;
 	}
 
-	// data definition
-	CSRHostData data = build_csr_host_data(read_graph_from_file(argv[1]));
-	std::cout << "[*] Graph loaded!" << std::endl;
-	std::cout << "[*] Number of nodes: " << data.num_nodes << std::endl;
-	std::cout << "[*] Offset size: " << data.csr.offsets.size() << std::endl;
-	std::cout << "[*] Edges size: " << data.csr.edges.size() << std::endl;
+	std::string out_file;
+	long long source = 0, local_size = DEFAULT_WORK_GROUP_SIZE, runs = 1;
+	for (int i = 2; i < argc; i++)
+	{
+		std::string arg(argv[i]);
+		if (arg.find("-s=") == 0)
+		{
+			if (!parse_integer(arg.substr(3), source)) arg_error(argv[0], "-s= takes a node id, got \"" + arg.substr(3) + "\"");
+		}
+		else if (arg.find("-local=") == 0)
+		{
+			if (!parse_integer(arg.substr(7), local_size) || local_size <= 0) arg_error(argv[0], "-local= takes a work-group size, got \"" + arg.substr(7) + "\"");
+		}
+		else if (arg.find("-runs=") == 0)
+		{
+			if (!parse_integer(arg.substr(6), runs) || runs <= 0) arg_error(argv[0], "-runs= takes a number of runs, got \"" + arg.substr(6) + "\"");
+		}
+		else out_file = arg;
+	}
 
 	try
 	{
-		// run BFS
-		SingleBFS bfs(data, std::make_shared<FrontierBFSOperator<16>>());
-		auto ret = bfs.run();
-		std::cout << "[*] Kernel time: " << ret.kernel_time << " us" << std::endl;
-		std::cout << "[*] Total time: " << ret.total_time << " us" << std::endl;
+		// data definition
+		CSRHostData data = readGraphFromFile(argv[1]);
+		std::cout << "[*] Graph loaded!" << std::endl;
+		std::cout << "[*] Number of nodes: " << data.num_nodes << std::endl;
+		std::cout << "[*] Offset size: " << data.csr.offsets.size() << std::endl;
+		std::cout << "[*] Edges size: " << data.csr.edges.size() << std::endl;
+		if (source < 0 || source >= (long long)data.num_nodes)
+		{
+			std::cout << "[!] Source " << source << " is not a node of the graph (" << data.num_nodes << " nodes)" << std::endl;
+			return 1;
+		}
 
-		if (argc >= 3)
+		// run BFS, the first run also pays for the kernel compilation
+		SingleBFS bfs(data, std::make_shared<FrontierBFSOperator<16>>(local_size));
+		for (long long r = 0; r < runs; r++)
 		{
-			std::ofstream out(argv[2]);
-			for (nodeid_t i = 0; i < data.parents.size(); i++)
+			auto ret = bfs.run(source);
+			std::cout << "[*] Run " << r << " | Kernel time: " << ret.kernel_time << " us | Total time: " << ret.total_time << " us" << std::endl;
+		}
+
+		if (!out_file.empty())
+		{
+			std::ofstream out(out_file);
+			for (size_t i = 0; i < data.parents.size(); i++)
 			{
-				out << i << " Parent: " << data.parents[i] << std::endl;
+				out << i << " Parent: " << data.parents[i] << '\n';
 			}
 			out.close();
 		}
 	}
-	catch (sycl::exception e)
+	catch (std::exception &e)
 	{
 		std::cout << e.what() << std::endl;
+		return 1;
 	}
-}
\ No newline at end of file
+	return 0;
+}
@@ -0,0 +1,86 @@
+#include <sycl/sycl.hpp>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include "host_data.hpp"
+#include "kernel_sizes.hpp"
+#include "stream_ingest.hpp"
+#include "arg_parse.hpp"
+#include "bfs.hpp"
+
+// reads a graph from stdin (or a file) while uploading it, then runs a BFS on it: "gen_graph | sycl_bfs_stream -s=0"
+
+int main(int argc, char **argv)
+{
+	std::string path;
+	long long source = 0, block_kb = StreamingGraphIngest::DEFAULT_BLOCK_SIZE >> 10, local_size = DEFAULT_WORK_GROUP_SIZE;
+	bool print_result = false;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg(argv[i]);
+		if (arg.find("-s=") == 0)
+		{
+			if (!parse_integer(arg.substr(3), source)) arg_error(argv[0], "-s= takes a node id, got \"" + arg.substr(3) + "\"");
+		}
+		else if (arg.find("-block=") == 0)
+		{
+			if (!parse_integer(arg.substr(7), block_kb) || block_kb <= 0) arg_error(argv[0], "-block= takes a block size in KB, got \"" + arg.substr(7) + "\"");
+		}
+		else if (arg.find("-local=") == 0)
+		{
+			if (!parse_integer(arg.substr(7), local_size) || local_size <= 0) arg_error(argv[0], "-local= takes a work-group size, got \"" + arg.substr(7) + "\"");
+		}
+		else if (arg == "-p") print_result = true;
+		else if (arg.find("-h") == 0)
+		{
+			std::cout << "Usage: " << argv[0] << " [-p] [-s=<source>] [-block=<KB>] [-local=<local_size>] [graph_file, stdin if omitted]" << std::endl;
+			return 0;
+		}
+		else path = arg;
+	}
+
+	std::ios::sync_with_stdio(false);
+	std::ifstream file;
+	if (!path.empty()) file.open(path);
+	std::istream &in = path.empty() ? std::cin : file;
+
+	try
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<CSRHostData> none;
+		MultipleGraphBFS<true> bfs(none, std::make_shared<FrontierMBFSOperator<16>>());
+		StreamingGraphIngest ingest(in, bfs.get_queue(), block_kb << 10);
+		auto stats = ingest.ingest();
+		if (source < 0 || source >= (long long)stats.num_nodes)
+		{
+			std::cout << "[!] Source " << source << " is not a node of the graph (" << stats.num_nodes << " nodes)" << std::endl;
+			return 1;
+		}
+
+		auto device_data = ingest.device();
+		auto time = bfs.run(device_data, {static_cast<nodeid_t>(source)}, local_size);
+		auto end = std::chrono::high_resolution_clock::now();
+
+		std::cout << "[*] Graph streamed: " << stats.num_nodes << " nodes, " << stats.num_edges << " edges, " << stats.bytes << " bytes" << (stats.sorted ? "" : " (unsorted)") << std::endl;
+		std::cout << "- Read time: " << stats.read_time << " us" << std::endl;
+		std::cout << "- Ingest time: " << stats.total_time << " us" << std::endl;
+		std::cout << "- Kernel time: " << time.kernel_time << " us" << std::endl;
+		std::cout << "- Time to first BFS: " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us" << std::endl;
+
+		if (print_result)
+		{
+			auto &parents = ingest.host().compressed_parents;
+			for (size_t i = 0; i < parents.size(); i++)
+			{
+				std::cout << "node " << i << ": " << parents[i] << '\n';
+			}
+			std::cout.flush();
+		}
+	}
+	catch (std::exception &e)
+	{
+		std::cout << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}